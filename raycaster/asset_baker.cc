@@ -0,0 +1,69 @@
+#include <iostream>
+#include <string>
+
+#include "SDL2/include/SDL.h"
+#include "SDL2_image/include/SDL_image.h"
+#include "SDL2_ttf/include/SDL_ttf.h"
+
+#include "asset_loader.h"
+#include "asset_pack.h"
+
+// Build step, converts source assets into a pack the game can map directly.
+//   asset_baker <out.pack> <image.png>... <font.ttf@size>...
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: asset_baker <out.pack> <image.png|font.ttf@size>..." << std::endl;
+        return 1;
+    }
+
+    SDL_Init(0);
+    IMG_Init(IMG_INIT_PNG);
+    TTF_Init();
+
+    AssetPackWriter writer;
+    int result = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t at = arg.rfind('@');
+        if (at != std::string::npos)
+        {
+            std::string path = arg.substr(0, at);
+            int size = std::stoi(arg.substr(at + 1));
+            GlyphAtlas atlas;
+            SourceStamp source;
+            if (!ReadSourceStamp(path, source) || !RasterizeGlyphs(path, size, atlas))
+            {
+                std::cerr << "failed to rasterize " << arg << ": " << SDL_GetError() << std::endl;
+                result = 1;
+                continue;
+            }
+            writer.AddGlyphs(FontAssetName(path, size), atlas, source);
+        }
+        else
+        {
+            Image image;
+            SourceStamp source;
+            if (!ReadSourceStamp(arg, source) || !DecodeImage(arg, image))
+            {
+                std::cerr << "failed to decode " << arg << ": " << SDL_GetError() << std::endl;
+                result = 1;
+                continue;
+            }
+            writer.AddImage(AssetName(arg), image, source);
+        }
+    }
+
+    if (result == 0 && !writer.Write(argv[1]))
+    {
+        std::cerr << "failed to write " << argv[1] << std::endl;
+        result = 1;
+    }
+
+    TTF_Quit();
+    IMG_Quit();
+    SDL_Quit();
+    return result;
+}
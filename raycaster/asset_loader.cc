@@ -0,0 +1,163 @@
+#include "asset_loader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#include "SDL2_image/include/SDL_image.h"
+#include "SDL2_ttf/include/SDL_ttf.h"
+
+std::string AssetName(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+std::string FontAssetName(const std::string& path, int size)
+{
+    return AssetName(path) + "@" + std::to_string(size);
+}
+
+static bool CopySurface(SDL_Surface* source, Image& out)
+{
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(source, SDL_PIXELFORMAT_RGBA8888, 0);
+    if (!converted)
+        return false;
+
+    SDL_LockSurface(converted);
+    out.width = converted->w;
+    out.height = converted->h;
+    out.pitch = converted->w * 4;
+    out.storage.resize(size_t(converted->w) * converted->h);
+    for (int y = 0; y < converted->h; y++)
+    {
+        std::memcpy(out.storage.data() + size_t(y) * converted->w,
+            static_cast<const uint8_t*>(converted->pixels) + y * converted->pitch,
+            out.pitch);
+    }
+    out.pixels = out.storage.data();
+    SDL_UnlockSurface(converted);
+    SDL_FreeSurface(converted);
+    return true;
+}
+
+bool DecodeImage(const std::string& path, Image& out)
+{
+    SDL_Surface* surface = IMG_Load(path.c_str());
+    if (!surface)
+        return false;
+
+    bool ok = CopySurface(surface, out);
+    SDL_FreeSurface(surface);
+    return ok;
+}
+
+bool RasterizeGlyphs(const std::string& path, int size, GlyphAtlas& out)
+{
+    TTF_Font* font = TTF_OpenFont(path.c_str(), size);
+    if (!font)
+        return false;
+
+    // all glyphs go into one row, the atlas is tiny
+    Image glyphImages[GLYPH_COUNT];
+    int atlasWidth = 0;
+    int atlasHeight = 0;
+    for (int i = 0; i < GLYPH_COUNT; i++)
+    {
+        Uint16 ch = static_cast<Uint16>(GLYPH_FIRST + i);
+        int minX, maxX, minY, maxY, advance;
+        TTF_GlyphMetrics(font, ch, &minX, &maxX, &minY, &maxY, &advance);
+        out.glyphs[i].advance = static_cast<int16_t>(advance);
+
+        SDL_Surface* surface = TTF_RenderGlyph_Blended(font, ch, {255, 255, 255, 255});
+        if (surface)
+        {
+            CopySurface(surface, glyphImages[i]);
+            SDL_FreeSurface(surface);
+        }
+        out.glyphs[i].x = static_cast<int16_t>(atlasWidth);
+        out.glyphs[i].y = 0;
+        out.glyphs[i].w = static_cast<int16_t>(glyphImages[i].width);
+        out.glyphs[i].h = static_cast<int16_t>(glyphImages[i].height);
+        atlasWidth += glyphImages[i].width;
+        atlasHeight = std::max(atlasHeight, glyphImages[i].height);
+    }
+    out.lineHeight = TTF_FontHeight(font);
+    TTF_CloseFont(font);
+
+    if (atlasWidth == 0 || atlasHeight == 0)
+        return false;
+
+    Image& atlas = out.image;
+    atlas.width = atlasWidth;
+    atlas.height = atlasHeight;
+    atlas.pitch = atlasWidth * 4;
+    atlas.storage.assign(size_t(atlasWidth) * atlasHeight, 0);
+    for (int i = 0; i < GLYPH_COUNT; i++)
+    {
+        const Image& glyph = glyphImages[i];
+        for (int y = 0; y < glyph.height; y++)
+        {
+            std::memcpy(atlas.storage.data() + size_t(y) * atlasWidth + out.glyphs[i].x,
+                glyph.storage.data() + size_t(y) * glyph.width,
+                glyph.width * 4);
+        }
+    }
+    atlas.pixels = atlas.storage.data();
+    return true;
+}
+
+bool ReadSourceStamp(const std::string& path, SourceStamp& out)
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    uintmax_t size = fs::file_size(path, error);
+    if (error)
+        return false;
+    fs::file_time_type time = fs::last_write_time(path, error);
+    if (error)
+        return false;
+
+    out.size = size;
+    out.time = static_cast<uint64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+// a shipped build may come without the sources, then the pack is all there is
+static bool IsBakedFromSource(const AssetPack& pack, const std::string& name, const std::string& path)
+{
+    const PackEntry* entry = pack.Find(name);
+    if (!entry)
+        return false;
+
+    SourceStamp source;
+    if (!ReadSourceStamp(path, source))
+        return true;
+    return entry->source.size == source.size && entry->source.time == source.time;
+}
+
+bool LoadImageAsset(const AssetPack& pack, const std::string& path, Image& out)
+{
+    std::string name = AssetName(path);
+    if (pack.IsOpen() && IsBakedFromSource(pack, name, path) && pack.GetImage(name, out))
+        return true;
+    return DecodeImage(path, out);
+}
+
+bool LoadGlyphAsset(const AssetPack& pack, const std::string& path, int size, GlyphAtlas& out)
+{
+    std::string name = FontAssetName(path, size);
+    if (pack.IsOpen() && IsBakedFromSource(pack, name, path) && pack.GetGlyphs(name, out))
+        return true;
+    return RasterizeGlyphs(path, size, out);
+}
+
+sdl2::Texture CreateTexture(sdl2::Renderer& renderer, const Image& image, int access)
+{
+    sdl2::Texture texture = sdl2::CreateTexture(renderer,
+        SDL_PIXELFORMAT_RGBA8888, access,
+        image.width, image.height
+    );
+    texture.Update(std::nullopt, image.pixels, image.pitch);
+    return texture;
+}
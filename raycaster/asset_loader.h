@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+#include "SDL2/include/SDL.h"
+#include "SDL2wrapper/include/SDL2wrapper.h"
+
+#include "asset_pack.h"
+
+const char ASSET_PACK_PATH[] = "data/assets.pack";
+
+// asset names inside the pack are the source file names, fonts get "@size"
+std::string AssetName(const std::string& path);
+std::string FontAssetName(const std::string& path, int size);
+
+// Decoders used by the baker and as fallback when the pack is missing.
+// Safe to call from worker threads, they do not touch the renderer.
+bool DecodeImage(const std::string& path, Image& out);
+bool RasterizeGlyphs(const std::string& path, int size, GlyphAtlas& out);
+
+// stamp recorded by the baker, false when the source file is not there
+bool ReadSourceStamp(const std::string& path, SourceStamp& out);
+
+// pack first (zero-copy), decoding the source file when the pack has no entry
+// for it or the source changed since it was baked
+bool LoadImageAsset(const AssetPack& pack, const std::string& path, Image& out);
+bool LoadGlyphAsset(const AssetPack& pack, const std::string& path, int size, GlyphAtlas& out);
+
+// uploads straight from the image memory, no intermediate surface
+sdl2::Texture CreateTexture(sdl2::Renderer& renderer, const Image& image, int access = SDL_TEXTUREACCESS_STATIC);
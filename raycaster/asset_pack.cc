@@ -0,0 +1,290 @@
+#include "asset_pack.h"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+struct GlyphBlobHeader
+{
+    int32_t lineHeight;
+    int32_t count;
+    GlyphMetrics glyphs[GLYPH_COUNT];
+};
+
+uint64_t AlignUp(uint64_t value)
+{
+    return (value + PACK_ALIGNMENT - 1) & ~uint64_t(PACK_ALIGNMENT - 1);
+}
+
+} // namespace
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    HANDLE map = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!map)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(map);
+        CloseHandle(handle);
+        return false;
+    }
+
+    file = handle;
+    mapping = map;
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    data = nullptr;
+    mapping = nullptr;
+    file = nullptr;
+    size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+    int handle = open(path.c_str(), O_RDONLY);
+    if (handle < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(handle, &st) != 0 || st.st_size == 0)
+    {
+        close(handle);
+        return false;
+    }
+
+    void* view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+    if (view == MAP_FAILED)
+    {
+        close(handle);
+        return false;
+    }
+
+    fd = handle;
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data)
+        munmap(const_cast<uint8_t*>(data), size);
+    if (fd >= 0)
+        close(fd);
+    data = nullptr;
+    fd = -1;
+    size = 0;
+}
+
+#endif
+
+bool AssetPack::Open(const std::string& path)
+{
+    entries = nullptr;
+    entryCount = 0;
+    if (!file.Open(path))
+        return false;
+
+    if (file.Size() < sizeof(PackHeader))
+        return false;
+
+    const PackHeader* header = reinterpret_cast<const PackHeader*>(file.Data());
+    if (std::memcmp(header->magic, PACK_MAGIC, 4) != 0 || header->version != PACK_VERSION)
+        return false;
+    if (header->fileSize != file.Size())
+        return false;
+    if (header->indexOffset + uint64_t(header->entryCount) * sizeof(PackEntry) > file.Size())
+        return false;
+
+    const PackEntry* index = reinterpret_cast<const PackEntry*>(file.Data() + header->indexOffset);
+    for (uint32_t i = 0; i < header->entryCount; i++)
+    {
+        if (index[i].offset + index[i].size > file.Size() || index[i].offset % PACK_ALIGNMENT != 0)
+            return false;
+    }
+
+    entries = index;
+    entryCount = header->entryCount;
+    return true;
+}
+
+const PackEntry* AssetPack::Find(const std::string& name) const
+{
+    for (uint32_t i = 0; i < entryCount; i++)
+    {
+        if (std::strncmp(entries[i].name, name.c_str(), PACK_NAME_LENGTH) == 0)
+            return &entries[i];
+    }
+    return nullptr;
+}
+
+bool AssetPack::GetImage(const std::string& name, Image& out) const
+{
+    const PackEntry* entry = Find(name);
+    if (!entry || entry->type != AssetType::Image)
+        return false;
+    if (uint64_t(entry->pitch) * entry->height > entry->size)
+        return false;
+
+    out.storage.clear();
+    out.pixels = reinterpret_cast<const uint32_t*>(file.Data() + entry->offset);
+    out.width = entry->width;
+    out.height = entry->height;
+    out.pitch = entry->pitch;
+    return true;
+}
+
+bool AssetPack::GetGlyphs(const std::string& name, GlyphAtlas& out) const
+{
+    const PackEntry* entry = Find(name);
+    if (!entry || entry->type != AssetType::Glyphs)
+        return false;
+
+    uint64_t pixelOffset = AlignUp(sizeof(GlyphBlobHeader));
+    if (pixelOffset + uint64_t(entry->pitch) * entry->height > entry->size)
+        return false;
+
+    const uint8_t* blob = file.Data() + entry->offset;
+    const GlyphBlobHeader* header = reinterpret_cast<const GlyphBlobHeader*>(blob);
+    if (header->count != GLYPH_COUNT)
+        return false;
+
+    out.lineHeight = header->lineHeight;
+    std::memcpy(out.glyphs, header->glyphs, sizeof(out.glyphs));
+    out.image.storage.clear();
+    out.image.pixels = reinterpret_cast<const uint32_t*>(blob + pixelOffset);
+    out.image.width = entry->width;
+    out.image.height = entry->height;
+    out.image.pitch = entry->pitch;
+    return true;
+}
+
+void AssetPackWriter::AddImageEntry(const std::string& name, AssetType type, const Image& image, const SourceStamp& source,
+    const void* extra, size_t extraSize)
+{
+    Pending asset;
+    std::memset(&asset.entry, 0, sizeof(asset.entry));
+    std::strncpy(asset.entry.name, name.c_str(), PACK_NAME_LENGTH - 1);
+    asset.entry.type = type;
+    asset.entry.width = image.width;
+    asset.entry.height = image.height;
+    // rows are tightly packed, the blob itself is aligned
+    asset.entry.pitch = image.width * 4;
+    asset.entry.source = source;
+
+    size_t pixelOffset = extra ? AlignUp(extraSize) : 0;
+    asset.data.resize(pixelOffset + size_t(asset.entry.pitch) * image.height);
+    if (extra)
+        std::memcpy(asset.data.data(), extra, extraSize);
+    for (int y = 0; y < image.height; y++)
+    {
+        const uint8_t* row = reinterpret_cast<const uint8_t*>(image.pixels) + y * image.pitch;
+        std::memcpy(asset.data.data() + pixelOffset + y * asset.entry.pitch, row, asset.entry.pitch);
+    }
+    asset.entry.size = asset.data.size();
+    pending.push_back(std::move(asset));
+}
+
+void AssetPackWriter::AddImage(const std::string& name, const Image& image, const SourceStamp& source)
+{
+    AddImageEntry(name, AssetType::Image, image, source, nullptr, 0);
+}
+
+void AssetPackWriter::AddGlyphs(const std::string& name, const GlyphAtlas& atlas, const SourceStamp& source)
+{
+    GlyphBlobHeader header;
+    header.lineHeight = atlas.lineHeight;
+    header.count = GLYPH_COUNT;
+    std::memcpy(header.glyphs, atlas.glyphs, sizeof(header.glyphs));
+    AddImageEntry(name, AssetType::Glyphs, atlas.image, source, &header, sizeof(header));
+}
+
+bool AssetPackWriter::Write(const std::string& path) const
+{
+    PackHeader header;
+    std::memcpy(header.magic, PACK_MAGIC, 4);
+    header.version = PACK_VERSION;
+    header.entryCount = static_cast<uint32_t>(pending.size());
+    header.indexOffset = sizeof(PackHeader);
+
+    std::vector<PackEntry> index;
+    uint64_t offset = AlignUp(header.indexOffset + pending.size() * sizeof(PackEntry));
+    for (const Pending& asset : pending)
+    {
+        PackEntry entry = asset.entry;
+        entry.offset = offset;
+        index.push_back(entry);
+        offset = AlignUp(offset + entry.size);
+    }
+    header.fileSize = offset;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(PackEntry));
+
+    const char zeros[PACK_ALIGNMENT] = {};
+    uint64_t written = sizeof(header) + index.size() * sizeof(PackEntry);
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        out.write(zeros, index[i].offset - written);
+        out.write(reinterpret_cast<const char*>(pending[i].data.data()), pending[i].data.size());
+        written = index[i].offset + pending[i].data.size();
+    }
+    out.write(zeros, header.fileSize - written);
+
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary asset pack.
+// Layout: PackHeader, then the entry index, then every asset blob aligned to
+// PACK_ALIGNMENT. Pixel data is stored as SDL_PIXELFORMAT_RGBA8888, exactly as
+// the textures expect it, so a mapped pack can be uploaded without conversion.
+
+const char PACK_MAGIC[4] = {'R', 'C', 'P', 'K'};
+const uint32_t PACK_VERSION = 2;
+const uint32_t PACK_ALIGNMENT = 64;
+const int PACK_NAME_LENGTH = 48;
+
+enum class AssetType : uint32_t
+{
+    Image = 1,
+    Glyphs = 2,
+};
+
+struct PackHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t indexOffset;
+    uint64_t fileSize;
+};
+
+// size and modification time of the file an asset was baked from
+struct SourceStamp
+{
+    uint64_t size;
+    uint64_t time;
+};
+
+struct PackEntry
+{
+    char name[PACK_NAME_LENGTH];
+    AssetType type;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint64_t offset;
+    uint64_t size;
+    SourceStamp source;
+};
+
+// pixels either point into a mapped pack or into storage
+struct Image
+{
+    const uint32_t* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int pitch = 0; // in bytes
+    std::vector<uint32_t> storage;
+
+    Image() = default;
+    Image(Image&&) = default;
+    Image& operator=(Image&&) = default;
+    // copies keep pointing at their own storage
+    Image(const Image& other) { *this = other; }
+    Image& operator=(const Image& other)
+    {
+        storage = other.storage;
+        pixels = other.OwnsPixels() ? storage.data() : other.pixels;
+        width = other.width;
+        height = other.height;
+        pitch = other.pitch;
+        return *this;
+    }
+
+    bool Valid() const { return pixels != nullptr; }
+    bool OwnsPixels() const { return !storage.empty() && pixels == storage.data(); }
+    uint32_t At(int x, int y) const
+    {
+        return *reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(pixels) + y * pitch + x * 4);
+    }
+};
+
+const int GLYPH_FIRST = 32;
+const int GLYPH_COUNT = 95;
+
+struct GlyphMetrics
+{
+    int16_t x, y;       // position in the atlas
+    int16_t w, h;
+    int16_t advance;
+    int16_t pad;
+};
+
+// printable ascii rasterized once into a single white-on-transparent atlas
+struct GlyphAtlas
+{
+    Image image;
+    int lineHeight = 0;
+    GlyphMetrics glyphs[GLYPH_COUNT] = {};
+
+    bool Valid() const { return image.Valid(); }
+};
+
+// read only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+class AssetPack
+{
+public:
+    // maps the pack and validates header and index, false if anything is off
+    bool Open(const std::string& path);
+
+    bool IsOpen() const { return entries != nullptr; }
+
+    const PackEntry* Find(const std::string& name) const;
+
+    // zero-copy views into the mapping, valid while the pack stays open
+    bool GetImage(const std::string& name, Image& out) const;
+    bool GetGlyphs(const std::string& name, GlyphAtlas& out) const;
+
+private:
+    MappedFile file;
+    const PackEntry* entries = nullptr;
+    uint32_t entryCount = 0;
+};
+
+// Collects assets in memory and writes a pack, used by the asset baker.
+class AssetPackWriter
+{
+public:
+    void AddImage(const std::string& name, const Image& image, const SourceStamp& source);
+    void AddGlyphs(const std::string& name, const GlyphAtlas& atlas, const SourceStamp& source);
+
+    bool Write(const std::string& path) const;
+
+private:
+    struct Pending
+    {
+        PackEntry entry;
+        std::vector<uint8_t> data;
+    };
+
+    void AddImageEntry(const std::string& name, AssetType type, const Image& image, const SourceStamp& source,
+        const void* extra, size_t extraSize);
+
+    std::vector<Pending> pending;
+};
@@ -0,0 +1,119 @@
+// Connects a swarm of fake players to a server on this machine.
+//   bots [count] [address] [seconds]
+// Every bot wanders with random keys and reports what it receives once a second.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "game_client.h"
+#include "net.h"
+#include "protocol.h"
+#include "simulation.h"
+
+// how long a bot keeps its keys before picking new ones
+const int BOT_INPUT_HOLD_MS = 1000;
+
+struct Bot
+{
+    GameClient client;
+    PlayerInput input;
+    int64_t nextInputChange = 0;
+};
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 16;
+    std::string addressText = argc > 2 ? argv[2] : "127.0.0.1";
+    int seconds = argc > 3 ? std::atoi(argv[3]) : 0;
+
+    NetAddress address;
+    if (!ParseAddress(addressText, DEFAULT_SERVER_PORT, address))
+    {
+        std::fprintf(stderr, "bad server address %s\n", addressText.c_str());
+        return 1;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    auto nowMs = [&]() {
+        return int64_t(std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count());
+    };
+
+    std::mt19937 random(1234);
+    std::vector<std::unique_ptr<Bot>> bots;
+    for (int i = 0; i < count; i++)
+    {
+        auto bot = std::make_unique<Bot>();
+        if (!bot->client.Connect(address, nowMs()))
+        {
+            std::fprintf(stderr, "bot %d failed to open a socket\n", i);
+            return 1;
+        }
+        bots.push_back(std::move(bot));
+    }
+
+    std::vector<NetEntity> entities;
+    int64_t nextReport = 1000;
+    uint64_t lastReceived = 0;
+    uint64_t lastSent = 0;
+    int lastSnapshots = 0;
+    auto nextTick = clock::now();
+    while (seconds <= 0 || nowMs() < seconds * 1000)
+    {
+        int64_t now = nowMs();
+        for (auto& bot : bots)
+        {
+            bot->client.Poll(now);
+            if (now >= bot->nextInputChange)
+            {
+                bot->input.buttons = uint8_t(random() & (INPUT_FORWARD | INPUT_BACK | INPUT_LEFT | INPUT_RIGHT));
+                bot->nextInputChange = now + BOT_INPUT_HOLD_MS;
+            }
+            bot->input.angle += MouseTurn(int(random() % 3) - 1, SERVER_TICK_MS);
+            bot->client.SendInput(bot->input);
+        }
+
+        if (now >= nextReport)
+        {
+            uint64_t received = 0;
+            uint64_t sent = 0;
+            int snapshots = 0;
+            int dropped = 0;
+            int connected = 0;
+            for (auto& bot : bots)
+            {
+                received += bot->client.BytesReceived();
+                sent += bot->client.BytesSent();
+                snapshots += bot->client.SnapshotsReceived();
+                dropped += bot->client.SnapshotsDropped();
+                connected += bot->client.Connected() ? 1 : 0;
+            }
+            bots[0]->client.Interpolate(now, entities);
+
+            double perBot = 1024. * std::max(count, 1);
+            std::printf("%d/%d connected, in %.2f KB/s per bot, out %.2f KB/s per bot, %.1f snapshots/s per bot, %d dropped, %zu entities visible\n",
+                connected, count, (received - lastReceived) / perBot, (sent - lastSent) / perBot,
+                double(snapshots - lastSnapshots) / std::max(count, 1), dropped, entities.size());
+            std::fflush(stdout);
+
+            lastReceived = received;
+            lastSent = sent;
+            lastSnapshots = snapshots;
+            nextReport += 1000;
+        }
+
+        nextTick += std::chrono::milliseconds(SERVER_TICK_MS);
+        std::this_thread::sleep_until(nextTick);
+    }
+
+    for (auto& bot : bots)
+    {
+        bot->client.Disconnect();
+    }
+    return 0;
+}
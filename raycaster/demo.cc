@@ -0,0 +1,182 @@
+#include "demo.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+
+uint32_t Fnv1a(uint32_t hash, const std::vector<int>& cells)
+{
+    for (int cell : cells)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            hash ^= uint8_t(uint32_t(cell) >> (i * 8));
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+} // namespace
+
+uint32_t HashLevel(const Level& level)
+{
+    uint32_t hash = 2166136261u;
+    hash = Fnv1a(hash, {level.width, level.height});
+    hash = Fnv1a(hash, level.walls);
+    hash = Fnv1a(hash, level.floors);
+    hash = Fnv1a(hash, level.ceils);
+    hash = Fnv1a(hash, level.heights);
+    return hash;
+}
+
+void DemoRecorder::Begin(const Player& start, const Level& level, int tickMs)
+{
+    std::memcpy(header.magic, DEMO_MAGIC, sizeof(header.magic));
+    header.version = DEMO_VERSION;
+    header.tickMs = tickMs;
+    header.tickCount = 0;
+    header.levelHash = HashLevel(level);
+    header.startX = start.pos.x;
+    header.startY = start.pos.y;
+    header.startAngle = start.angle;
+
+    records.clear();
+    lastAngle = start.angle;
+}
+
+void DemoRecorder::Record(const PlayerInput& input)
+{
+    uint8_t flags = input.buttons & ~DEMO_ANGLE_CHANGED;
+    if (input.angle != lastAngle)
+        flags |= DEMO_ANGLE_CHANGED;
+    records.push_back(flags);
+
+    if (flags & DEMO_ANGLE_CHANGED)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&input.angle);
+        records.insert(records.end(), bytes, bytes + sizeof(input.angle));
+        lastAngle = input.angle;
+    }
+    header.tickCount++;
+}
+
+bool DemoRecorder::Save(const std::string& path, const Player& end)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    DemoFooter footer = {end.pos.x, end.pos.y, end.angle};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(records.data()), records.size());
+    file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    return bool(file);
+}
+
+bool DemoPlayer::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(DemoHeader) + sizeof(DemoFooter))
+        return false;
+
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, DEMO_MAGIC, sizeof(header.magic)) != 0 || header.version != DEMO_VERSION)
+        return false;
+
+    std::memcpy(&footer, data.data() + data.size() - sizeof(footer), sizeof(footer));
+    records.assign(data.begin() + sizeof(header), data.end() - sizeof(footer));
+    readOffset = 0;
+    tick = 0;
+    angle = header.startAngle;
+    return true;
+}
+
+Player DemoPlayer::StartPlayer() const
+{
+    Player player = SpawnPlayer();
+    player.pos = {header.startX, header.startY};
+    player.angle = header.startAngle;
+    return player;
+}
+
+bool DemoPlayer::Next(PlayerInput& out)
+{
+    if (uint32_t(tick) >= header.tickCount || readOffset >= records.size())
+        return false;
+
+    uint8_t flags = records[readOffset++];
+    if (flags & DEMO_ANGLE_CHANGED)
+    {
+        if (readOffset + sizeof(angle) > records.size())
+            return false;
+        std::memcpy(&angle, records.data() + readOffset, sizeof(angle));
+        readOffset += sizeof(angle);
+    }
+
+    out.buttons = flags & ~DEMO_ANGLE_CHANGED;
+    out.angle = angle;
+    tick++;
+    return true;
+}
+
+bool DemoPlayer::MatchesEnd(const Player& player) const
+{
+    return player.pos.x == footer.endX && player.pos.y == footer.endY && player.angle == footer.endAngle;
+}
+
+void DemoReport::AddTick(int tick, int frame, const Player& player, double frameMs)
+{
+    rows.push_back(Row{tick, frame, player.pos.x, player.pos.y, player.angle, frameMs});
+}
+
+bool DemoReport::WriteCsv(const std::string& path) const
+{
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    // %a keeps the trajectory bit exact so two runs can be diffed directly
+    std::fprintf(file, "tick,x,y,angle,frame,frame_ms\n");
+    for (const Row& row : rows)
+    {
+        std::fprintf(file, "%d,%a,%a,%a,%d,%.3f\n", row.tick, row.x, row.y, row.angle, row.frame, row.frameMs);
+    }
+    return std::fclose(file) == 0;
+}
+
+std::string DemoReport::Summary() const
+{
+    if (rows.empty())
+        return "no frames";
+
+    // a frame running several ticks shows up once per tick, count it once
+    std::vector<double> frames;
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        if (i == 0 || rows[i].frame != rows[i - 1].frame)
+            frames.push_back(rows[i].frameMs);
+    }
+
+    double total = 0;
+    for (double ms : frames)
+    {
+        total += ms;
+    }
+    std::sort(frames.begin(), frames.end());
+
+    char text[160];
+    std::snprintf(text, sizeof(text), "%zu frames, mean %.3f ms, median %.3f ms, p99 %.3f ms, worst %.3f ms",
+        frames.size(), total / frames.size(), frames[frames.size() / 2],
+        frames[std::min(frames.size() - 1, frames.size() * 99 / 100)], frames.back());
+    return text;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "level.h"
+#include "simulation.h"
+
+// Demo file, little endian:
+//   DemoHeader
+//   one record per simulation tick, a flags byte (buttons, DEMO_ANGLE_CHANGED)
+//   followed by the new view angle as a double when it changed
+//   DemoFooter, where the recording ended, to check playback against
+// Tick n happens at n * tickMs into the demo.
+
+const char DEMO_MAGIC[4] = {'R', 'C', 'D', 'M'};
+const uint32_t DEMO_VERSION = 1;
+
+const uint8_t DEMO_ANGLE_CHANGED = 0x80;
+
+#pragma pack(push, 1)
+struct DemoHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t tickMs;
+    uint32_t tickCount;
+    uint32_t levelHash;
+    float startX, startY;
+    double startAngle;
+};
+
+struct DemoFooter
+{
+    float endX, endY;
+    double endAngle;
+};
+#pragma pack(pop)
+
+// hash of every tile layer, playback on a different level cannot match
+uint32_t HashLevel(const Level& level);
+
+class DemoRecorder
+{
+public:
+    void Begin(const Player& start, const Level& level, int tickMs);
+    void Record(const PlayerInput& input);
+    bool Save(const std::string& path, const Player& end);
+
+    int TickCount() const { return static_cast<int>(header.tickCount); }
+
+private:
+    DemoHeader header = {};
+    std::vector<uint8_t> records;
+    double lastAngle = 0;
+};
+
+class DemoPlayer
+{
+public:
+    bool Load(const std::string& path);
+
+    const DemoHeader& Header() const { return header; }
+    Player StartPlayer() const;
+
+    // input of the next tick, false once every tick was played
+    bool Next(PlayerInput& out);
+    int Tick() const { return tick; }
+
+    // playback ended exactly where the recording did
+    bool MatchesEnd(const Player& player) const;
+
+private:
+    DemoHeader header = {};
+    DemoFooter footer = {};
+    std::vector<uint8_t> records;
+    size_t readOffset = 0;
+    int tick = 0;
+    double angle = 0;
+};
+
+// Per tick camera trajectory plus the time of the frame which ran the tick.
+// The trajectory columns are bit exact across builds, frame times are what
+// gets compared.
+class DemoReport
+{
+public:
+    void AddTick(int tick, int frame, const Player& player, double frameMs);
+    bool WriteCsv(const std::string& path) const;
+    // frames, mean, median, 99th percentile and worst frame time
+    std::string Summary() const;
+
+private:
+    struct Row
+    {
+        int tick;
+        int frame;
+        float x, y;
+        double angle;
+        double frameMs;
+    };
+    std::vector<Row> rows;
+};
@@ -0,0 +1,77 @@
+#include "depth_hierarchy.h"
+
+#include <algorithm>
+
+void DepthHierarchy::Build(const float* nearest, const float* farthest, int width)
+{
+    this->width = width;
+    levelCount = 1;
+    while ((1 << (levelCount - 1)) < width)
+    {
+        levelCount++;
+    }
+    if (static_cast<int>(levels.size()) < levelCount)
+        levels.resize(levelCount);
+
+    Level& base = levels[0];
+    base.minNear.assign(nearest, nearest + width);
+    base.maxFar.assign(farthest, farthest + width);
+
+    for (int k = 1; k < levelCount; k++)
+    {
+        const Level& below = levels[k - 1];
+        Level& level = levels[k];
+        int belowCount = static_cast<int>(below.minNear.size());
+        int count = (belowCount + 1) / 2;
+        level.minNear.resize(count);
+        level.maxFar.resize(count);
+        for (int n = 0; n < count; n++)
+        {
+            // an odd node at the end has no sibling
+            int a = 2 * n;
+            int b = std::min(a + 1, belowCount - 1);
+            level.minNear[n] = std::min(below.minNear[a], below.minNear[b]);
+            level.maxFar[n] = std::max(below.maxFar[a], below.maxFar[b]);
+        }
+    }
+}
+
+DepthTest DepthHierarchy::Test(int x0, int x1, float depth) const
+{
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, width);
+    if (x0 >= x1)
+        return DepthTest::Hidden;
+
+    // nodes no wider than the range, so it touches at most three of them
+    int k = 0;
+    while (k + 1 < levelCount && (2 << k) <= x1 - x0)
+    {
+        k++;
+    }
+
+    const Level& level = levels[k];
+    float minNear = level.minNear[x0 >> k];
+    float maxFar = level.maxFar[x0 >> k];
+    for (int n = (x0 >> k) + 1; n <= (x1 - 1) >> k; n++)
+    {
+        minNear = std::min(minNear, level.minNear[n]);
+        maxFar = std::max(maxFar, level.maxFar[n]);
+    }
+
+    if (depth >= maxFar)
+        return DepthTest::Hidden;
+    if (depth < minNear)
+        return DepthTest::Visible;
+    return DepthTest::Partial;
+}
+
+size_t DepthHierarchy::MemoryBytes() const
+{
+    size_t bytes = 0;
+    for (const Level& level : levels)
+    {
+        bytes += (level.minNear.capacity() + level.maxFar.capacity()) * sizeof(float);
+    }
+    return bytes;
+}
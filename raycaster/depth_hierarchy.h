@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Min/max reduction of a per-column depth buffer.
+// Level 0 holds, per screen column, the nearest hit and the depth which hides
+// everything behind it, level k the min and max of 2^k columns of level 0.
+// A sprite spanning some columns at one depth is tested against a handful of
+// nodes instead of every column.
+
+enum class DepthTest
+{
+    Hidden,  // behind the hiding depth of every column
+    Visible, // in front of the nearest hit of every column
+    Partial, // needs the per-column test
+};
+
+class DepthHierarchy
+{
+public:
+    // nearest <= farthest per column, storage is reused between frames
+    void Build(const float* nearest, const float* farthest, int width);
+
+    // columns [x0, x1) at depth, conservative: Partial whenever unsure
+    DepthTest Test(int x0, int x1, float depth) const;
+
+    size_t MemoryBytes() const;
+
+private:
+    struct Level
+    {
+        std::vector<float> minNear;
+        std::vector<float> maxFar;
+    };
+
+    int width = 0;
+    int levelCount = 0;
+    std::vector<Level> levels;
+};
@@ -0,0 +1,278 @@
+#include "entities.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "metrics.h"
+#include "ray_query.h"
+
+namespace
+{
+
+template <typename T>
+size_t VectorBytes(const std::vector<T>& values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+} // namespace
+
+EntityStore::EntityStore(int capacity) : capacity(capacity)
+{
+    posX.resize(capacity);
+    posY.resize(capacity);
+    velX.resize(capacity);
+    velY.resize(capacity);
+    aiState.resize(capacity);
+    homeX.resize(capacity);
+    homeY.resize(capacity);
+    patrolX.resize(capacity);
+    patrolY.resize(capacity);
+    patrolForward.resize(capacity);
+    speed.resize(capacity);
+    sightRadius.resize(capacity);
+    trackCost.resize(capacity);
+    seesPlayer.resize(capacity);
+    frame.resize(capacity);
+    frameCount.resize(capacity);
+    frameTimeMs.resize(capacity);
+    texture.resize(capacity);
+
+    slotToId.resize(capacity);
+    idToSlot.resize(capacity, -1);
+    freeIds.reserve(capacity);
+    for (int i = capacity - 1; i >= 0; i--)
+    {
+        freeIds.push_back(i);
+    }
+}
+
+EntityId EntityStore::Spawn(const EnemyDesc& desc)
+{
+    if (freeIds.empty())
+        return INVALID_ENTITY;
+
+    EntityId id = freeIds.back();
+    freeIds.pop_back();
+
+    int slot = count++;
+    slotToId[slot] = id;
+    idToSlot[id] = slot;
+
+    posX[slot] = desc.pos.x;
+    posY[slot] = desc.pos.y;
+    velX[slot] = 0;
+    velY[slot] = 0;
+    aiState[slot] = AiState::Patrol;
+    homeX[slot] = desc.pos.x;
+    homeY[slot] = desc.pos.y;
+    patrolX[slot] = desc.patrolTarget.x;
+    patrolY[slot] = desc.patrolTarget.y;
+    patrolForward[slot] = 1;
+    speed[slot] = desc.speed;
+    sightRadius[slot] = desc.sightRadius;
+    trackCost[slot] = static_cast<uint16_t>(std::min(desc.trackRadius * FLOW_STRAIGHT_COST, float(FLOW_UNREACHABLE - 1)));
+    seesPlayer[slot] = 0;
+    frame[slot] = 0;
+    frameCount[slot] = static_cast<uint16_t>(desc.frameCount > 0 ? desc.frameCount : 1);
+    frameTimeMs[slot] = 0;
+    texture[slot] = desc.texture;
+
+    return id;
+}
+
+bool EntityStore::Alive(EntityId id) const
+{
+    return id < static_cast<EntityId>(capacity) && idToSlot[id] >= 0;
+}
+
+void EntityStore::Despawn(EntityId id)
+{
+    if (!Alive(id))
+        return;
+
+    int slot = idToSlot[id];
+    int last = --count;
+    if (slot != last)
+    {
+        posX[slot] = posX[last];
+        posY[slot] = posY[last];
+        velX[slot] = velX[last];
+        velY[slot] = velY[last];
+        aiState[slot] = aiState[last];
+        homeX[slot] = homeX[last];
+        homeY[slot] = homeY[last];
+        patrolX[slot] = patrolX[last];
+        patrolY[slot] = patrolY[last];
+        patrolForward[slot] = patrolForward[last];
+        speed[slot] = speed[last];
+        sightRadius[slot] = sightRadius[last];
+        trackCost[slot] = trackCost[last];
+        seesPlayer[slot] = seesPlayer[last];
+        frame[slot] = frame[last];
+        frameCount[slot] = frameCount[last];
+        frameTimeMs[slot] = frameTimeMs[last];
+        texture[slot] = texture[last];
+
+        EntityId moved = slotToId[last];
+        slotToId[slot] = moved;
+        idToSlot[moved] = slot;
+    }
+    idToSlot[id] = -1;
+    freeIds.push_back(id);
+}
+
+size_t EntityStore::MemoryBytes() const
+{
+    return VectorBytes(posX) + VectorBytes(posY) + VectorBytes(velX) + VectorBytes(velY) + VectorBytes(aiState) +
+        VectorBytes(homeX) + VectorBytes(homeY) + VectorBytes(patrolX) + VectorBytes(patrolY) +
+        VectorBytes(patrolForward) + VectorBytes(speed) + VectorBytes(sightRadius) + VectorBytes(trackCost) +
+        VectorBytes(seesPlayer) + VectorBytes(frame) + VectorBytes(frameCount) + VectorBytes(frameTimeMs) +
+        VectorBytes(texture) + VectorBytes(slotToId) + VectorBytes(idToSlot) + VectorBytes(freeIds);
+}
+
+void SightSystem(EntityStore& store, const SimulationContext& ctx, int begin, int end)
+{
+    // queries are built on the stack, ENTITY_CHUNK_SIZE entities at a time
+    float dirX[ENTITY_CHUNK_SIZE];
+    float dirY[ENTITY_CHUNK_SIZE];
+    float maxDistance[ENTITY_CHUNK_SIZE];
+    uint8_t blocked[ENTITY_CHUNK_SIZE];
+
+    for (int chunk = begin; chunk < end; chunk += ENTITY_CHUNK_SIZE)
+    {
+        int count = std::min(ENTITY_CHUNK_SIZE, end - chunk);
+        for (int i = 0; i < count; i++)
+        {
+            float toPlayerX = ctx.playerPos.x - store.posX[chunk + i];
+            float toPlayerY = ctx.playerPos.y - store.posY[chunk + i];
+            float playerDist = std::sqrt(toPlayerX * toPlayerX + toPlayerY * toPlayerY);
+
+            // out of range rays are traced with no length, they never hit
+            bool inRange = playerDist < store.sightRadius[chunk + i] && playerDist > 0;
+            dirX[i] = inRange ? toPlayerX / playerDist : 1;
+            dirY[i] = inRange ? toPlayerY / playerDist : 0;
+            maxDistance[i] = inRange ? playerDist : 0;
+            store.seesPlayer[chunk + i] = inRange || playerDist == 0;
+        }
+
+        RayQueries queries = {store.posX.data() + chunk, store.posY.data() + chunk, dirX, dirY, maxDistance};
+        RayResults results = {blocked, nullptr, nullptr, nullptr, nullptr};
+        TraceRays(ctx.grid, queries, results, 0, count);
+
+        for (int i = 0; i < count; i++)
+        {
+            store.seesPlayer[chunk + i] = store.seesPlayer[chunk + i] && !blocked[i];
+        }
+    }
+}
+
+void AiSystem(EntityStore& store, const SimulationContext& ctx, int begin, int end)
+{
+    int tracking = 0;
+    for (int i = begin; i < end; i++)
+    {
+        bool seesPlayer = store.seesPlayer[i] != 0;
+        store.aiState[i] = seesPlayer ? AiState::Chase : AiState::Patrol;
+
+        // out of sight but close by the path, the flow field leads around walls
+        float flowX, flowY;
+        if (!seesPlayer && ctx.flow && ctx.flow->Cost(int(store.posX[i]), int(store.posY[i])) <= store.trackCost[i] &&
+            ctx.flow->Direction(store.posX[i], store.posY[i], flowX, flowY))
+        {
+            store.aiState[i] = AiState::Track;
+            store.velX[i] = flowX * store.speed[i];
+            store.velY[i] = flowY * store.speed[i];
+            tracking++;
+            continue;
+        }
+
+        float targetX = ctx.playerPos.x;
+        float targetY = ctx.playerPos.y;
+        if (!seesPlayer)
+        {
+            targetX = store.patrolForward[i] ? store.patrolX[i] : store.homeX[i];
+            targetY = store.patrolForward[i] ? store.patrolY[i] : store.homeY[i];
+        }
+
+        float toTargetX = targetX - store.posX[i];
+        float toTargetY = targetY - store.posY[i];
+        float targetDist = std::sqrt(toTargetX * toTargetX + toTargetY * toTargetY);
+
+        // stop before walking into the player, turn around at patrol ends
+        float arriveDist = seesPlayer ? .75f : .05f;
+        if (targetDist < arriveDist)
+        {
+            if (!seesPlayer)
+                store.patrolForward[i] = !store.patrolForward[i];
+            store.velX[i] = 0;
+            store.velY[i] = 0;
+            continue;
+        }
+
+        store.velX[i] = toTargetX / targetDist * store.speed[i];
+        store.velY[i] = toTargetY / targetDist * store.speed[i];
+    }
+    CountMetric(Metric::AgentsTracking, tracking);
+}
+
+void MovementSystem(EntityStore& store, const SimulationContext& ctx, int begin, int end)
+{
+    float seconds = ctx.deltaMs / 1000.f;
+    for (int i = begin; i < end; i++)
+    {
+        float nextX = store.posX[i] + store.velX[i] * seconds;
+        float nextY = store.posY[i] + store.velY[i] * seconds;
+
+        // same per axis sliding as the player uses
+        if (!ctx.grid.Solid(int(nextX), int(store.posY[i])))
+            store.posX[i] = nextX;
+        if (!ctx.grid.Solid(int(store.posX[i]), int(nextY)))
+            store.posY[i] = nextY;
+    }
+}
+
+void AnimationSystem(EntityStore& store, const SimulationContext& ctx, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        bool moving = store.velX[i] != 0 || store.velY[i] != 0;
+        if (!moving)
+        {
+            store.frame[i] = 0;
+            store.frameTimeMs[i] = 0;
+            continue;
+        }
+
+        int time = store.frameTimeMs[i] + ctx.deltaMs;
+        int steps = time / ANIMATION_FRAME_MS;
+        store.frameTimeMs[i] = static_cast<uint16_t>(time % ANIMATION_FRAME_MS);
+        store.frame[i] = static_cast<uint16_t>((store.frame[i] + steps) % store.frameCount[i]);
+    }
+}
+
+void UpdateEntities(EntityStore& store, const SimulationContext& ctx, JobSystem& jobs)
+{
+    int count = store.Count();
+    jobs.ParallelFor(count, ENTITY_CHUNK_SIZE, [&](int begin, int end) {
+        SightSystem(store, ctx, begin, end);
+        AiSystem(store, ctx, begin, end);
+    });
+    jobs.ParallelFor(count, ENTITY_CHUNK_SIZE, [&](int begin, int end) {
+        MovementSystem(store, ctx, begin, end);
+    });
+    jobs.ParallelFor(count, ENTITY_CHUNK_SIZE, [&](int begin, int end) {
+        AnimationSystem(store, ctx, begin, end);
+    });
+}
+
+void PackRenderSprites(const EntityStore& store, std::vector<Sprite>& out, JobSystem& jobs)
+{
+    out.resize(store.Count());
+    jobs.ParallelFor(store.Count(), ENTITY_CHUNK_SIZE, [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+            out[i] = Sprite{store.posX[i], store.posY[i], store.texture[i], store.frame[i]};
+        }
+    });
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "flow_field.h"
+#include "job_system.h"
+#include "types.h"
+
+enum class AiState : uint8_t
+{
+    Patrol,
+    Chase, // sees the player and heads straight for it
+    Track  // lost sight, follows the flow field while the path is short enough
+};
+
+typedef uint32_t EntityId;
+
+const EntityId INVALID_ENTITY = 0xFFFFFFFF;
+
+struct EnemyDesc
+{
+    vector2f pos;
+    vector2f patrolTarget;
+    int texture;
+    int frameCount;
+    float speed;
+    float sightRadius;
+    float trackRadius; // path length in tiles, see AiState::Track
+};
+
+// world state the systems read, it is shared by every chunk and never written
+struct SimulationContext
+{
+    GridView grid;
+    vector2f playerPos;
+    int deltaMs;
+    const FlowField* flow = nullptr; // towards playerPos, no tracking without it
+};
+
+// Entity-component store.
+// Every component lives in its own contiguous array indexed by a dense slot,
+// removing an entity moves the last slot into the hole. Storage is reserved
+// once for `capacity` entities, spawning and ticking never allocate.
+class EntityStore
+{
+public:
+    explicit EntityStore(int capacity);
+
+    int Count() const { return count; }
+    int Capacity() const { return capacity; }
+
+    EntityId Spawn(const EnemyDesc& desc);
+    void Despawn(EntityId id);
+    bool Alive(EntityId id) const;
+
+    // every component array and the id tables, reserved up front
+    size_t MemoryBytes() const;
+
+    // transform
+    std::vector<float> posX, posY;
+    // velocity, written by the ai system, consumed by movement
+    std::vector<float> velX, velY;
+    // ai
+    std::vector<AiState> aiState;
+    std::vector<float> homeX, homeY;
+    std::vector<float> patrolX, patrolY;
+    std::vector<uint8_t> patrolForward;
+    std::vector<float> speed;
+    std::vector<float> sightRadius;
+    std::vector<uint16_t> trackCost; // trackRadius in flow field cost units
+    std::vector<uint8_t> seesPlayer; // written by the sight system
+    // animation
+    std::vector<uint16_t> frame;
+    std::vector<uint16_t> frameCount;
+    std::vector<uint16_t> frameTimeMs;
+    // render
+    std::vector<int> texture;
+
+private:
+    int capacity;
+    int count = 0;
+
+    std::vector<EntityId> slotToId;
+    std::vector<int> idToSlot;
+    std::vector<EntityId> freeIds;
+};
+
+const int ENTITY_CHUNK_SIZE = 256;
+
+const int ANIMATION_FRAME_MS = 150;
+
+// line of sight to the player, traced as a ray batch per chunk
+void SightSystem(EntityStore& store, const SimulationContext& ctx, int begin, int end);
+void AiSystem(EntityStore& store, const SimulationContext& ctx, int begin, int end);
+void MovementSystem(EntityStore& store, const SimulationContext& ctx, int begin, int end);
+void AnimationSystem(EntityStore& store, const SimulationContext& ctx, int begin, int end);
+
+// runs every system over the store in parallel chunks, one system after another
+void UpdateEntities(EntityStore& store, const SimulationContext& ctx, JobSystem& jobs);
+
+// Writes one Sprite per entity into out, out must have been reserved for
+// store.Capacity() so this never reallocates.
+void PackRenderSprites(const EntityStore& store, std::vector<Sprite>& out, JobSystem& jobs);
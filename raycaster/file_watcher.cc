@@ -0,0 +1,143 @@
+#include "file_watcher.h"
+
+#include <chrono>
+#include <filesystem>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+FileWatcher::~FileWatcher()
+{
+    Stop();
+}
+
+void FileWatcher::Watch(const std::string& path)
+{
+    paths.push_back(path);
+}
+
+void FileWatcher::MarkChanged(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    changed.insert(path);
+}
+
+std::vector<std::string> FileWatcher::TakeChanged()
+{
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock() || changed.empty())
+        return {};
+
+    std::vector<std::string> result(changed.begin(), changed.end());
+    changed.clear();
+    return result;
+}
+
+static std::string ParentDirectory(const std::string& path)
+{
+    fs::path parent = fs::path(path).parent_path();
+    return parent.empty() ? "." : parent.string();
+}
+
+#ifdef __linux__
+
+bool FileWatcher::Start()
+{
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+        return false;
+
+    for (const std::string& path : paths)
+    {
+        int wd = inotify_add_watch(inotifyFd, ParentDirectory(path).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        watchDescriptors.push_back(wd);
+    }
+
+    running = true;
+    thread = std::thread([this]() { Run(); });
+    return true;
+}
+
+void FileWatcher::Run()
+{
+    alignas(inotify_event) char buffer[4096];
+    pollfd pfd = {inotifyFd, POLLIN, 0};
+    while (running)
+    {
+        // short timeout so Stop does not have to wait for an event
+        if (poll(&pfd, 1, 100) <= 0)
+            continue;
+
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (event->len == 0)
+                continue;
+
+            for (size_t i = 0; i < paths.size(); i++)
+            {
+                if (watchDescriptors[i] == event->wd && fs::path(paths[i]).filename() == event->name)
+                    MarkChanged(paths[i]);
+            }
+        }
+    }
+}
+
+void FileWatcher::Stop()
+{
+    if (running.exchange(false))
+        thread.join();
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+    inotifyFd = -1;
+    watchDescriptors.clear();
+}
+
+#else
+
+bool FileWatcher::Start()
+{
+    running = true;
+    thread = std::thread([this]() { Run(); });
+    return true;
+}
+
+void FileWatcher::Run()
+{
+    std::vector<fs::file_time_type> stamps(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        std::error_code error;
+        stamps[i] = fs::last_write_time(paths[i], error);
+    }
+
+    while (running)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            std::error_code error;
+            fs::file_time_type stamp = fs::last_write_time(paths[i], error);
+            if (!error && stamp != stamps[i])
+            {
+                stamps[i] = stamp;
+                MarkChanged(paths[i]);
+            }
+        }
+    }
+}
+
+void FileWatcher::Stop()
+{
+    if (running.exchange(false))
+        thread.join();
+}
+
+#endif
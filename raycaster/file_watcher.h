@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches a set of files from a background thread.
+// Uses inotify on the parent directories on linux (editors usually save by
+// renaming a temporary file over the original), everywhere else it polls
+// modification times.
+class FileWatcher
+{
+public:
+    FileWatcher() = default;
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // all files have to be added before Start
+    void Watch(const std::string& path);
+    bool Start();
+    void Stop();
+
+    // paths changed since the last call, never blocks
+    std::vector<std::string> TakeChanged();
+
+private:
+    void Run();
+    void MarkChanged(const std::string& path);
+
+    std::vector<std::string> paths;
+    std::set<std::string> changed;
+    std::mutex mutex;
+    std::thread thread;
+    std::atomic<bool> running{false};
+#ifdef __linux__
+    int inotifyFd = -1;
+    std::vector<int> watchDescriptors;
+#endif
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cmath>
+
+#include "scalar.h"
+#include "types.h"
+
+// Floor stepping.
+// Where the rows of one screen column meet a horizontal plane. Row p, counted
+// from the horizon, is height / p / cosCorrection away along the column's
+// ray, height being the distance to the projection plane times the eye height
+// above the plane. The renderer draws floors, ceilings and the top faces of
+// low walls through it.
+// In general the ray and its offset at row 1 are set up once per column, a
+// row then divides by p three times, so a row's error is one rounding and
+// fixed point stays accurate out to the horizon. float keeps the expressions
+// the renderer always had, so float frames do not change.
+
+template <typename Scalar>
+struct FloorPoint
+{
+    Scalar distance;
+    Scalar x, y;
+};
+
+template <typename Scalar>
+class FloorRay
+{
+public:
+    FloorRay(vector2f origin, float angle, float cosCorrection, float height)
+        : originX(ScalarTraits<Scalar>::From(origin.x)), originY(ScalarTraits<Scalar>::From(origin.y))
+    {
+        double scale = double(height) / cosCorrection;
+        stepX = ScalarTraits<Scalar>::From(std::cos(double(angle)) * scale);
+        stepY = ScalarTraits<Scalar>::From(std::sin(double(angle)) * scale);
+        this->scale = ScalarTraits<Scalar>::From(scale);
+    }
+
+    // p > 0
+    FloorPoint<Scalar> Row(int p) const
+    {
+        FloorPoint<Scalar> point;
+        point.distance = scale / p;
+        point.x = originX + stepX / p;
+        point.y = originY + stepY / p;
+        return point;
+    }
+
+private:
+    Scalar originX, originY;
+    Scalar stepX, stepY; // the offset of row 1
+    Scalar scale;
+};
+
+template <>
+class FloorRay<float>
+{
+public:
+    FloorRay(vector2f origin, float angle, float cosCorrection, float height)
+        : origin(origin), angle(angle), cosCorrection(cosCorrection), height(height)
+    {
+    }
+
+    // cos and sin as the renderer always called them, the sum is rounded once
+    FloorPoint<float> Row(int p) const
+    {
+        FloorPoint<float> point;
+        point.distance = (height / float(p)) / cosCorrection;
+        point.x = origin.x + cos(angle) * point.distance;
+        point.y = origin.y + sin(angle) * point.distance;
+        return point;
+    }
+
+private:
+    vector2f origin;
+    float angle;
+    float cosCorrection;
+    float height;
+};
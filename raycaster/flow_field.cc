@@ -0,0 +1,204 @@
+#include "flow_field.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "metrics.h"
+
+namespace
+{
+
+const int BUCKET_COUNT = FLOW_DIAGONAL_COST + 1;
+
+struct Neighbour
+{
+    int dx, dy;
+    int cost;
+};
+
+const Neighbour NEIGHBOURS[8] = {
+    {1, 0, FLOW_STRAIGHT_COST},
+    {-1, 0, FLOW_STRAIGHT_COST},
+    {0, 1, FLOW_STRAIGHT_COST},
+    {0, -1, FLOW_STRAIGHT_COST},
+    {1, 1, FLOW_DIAGONAL_COST},
+    {-1, 1, FLOW_DIAGONAL_COST},
+    {1, -1, FLOW_DIAGONAL_COST},
+    {-1, -1, FLOW_DIAGONAL_COST},
+};
+
+// diagonal steps need both cells they squeeze between to be free
+template <typename Free>
+bool CanStep(int x, int y, const Neighbour& n, Free free)
+{
+    if (!free(x + n.dx, y + n.dy))
+        return false;
+    return n.dx == 0 || n.dy == 0 || (free(x + n.dx, y) && free(x, y + n.dy));
+}
+
+} // namespace
+
+void FlowField::SetTarget(vector2f pos)
+{
+    wantedX = static_cast<int>(std::floor(pos.x));
+    wantedY = static_cast<int>(std::floor(pos.y));
+}
+
+void FlowField::Invalidate()
+{
+    dirty = true;
+}
+
+void FlowField::StartBuild(const GridView& grid)
+{
+    buildWidth = grid.width;
+    buildHeight = grid.height;
+    buildTargetX = wantedX;
+    buildTargetY = wantedY;
+    next.assign(size_t(buildWidth) * buildHeight, FLOW_UNREACHABLE);
+    for (std::vector<int>& bucket : buckets)
+    {
+        bucket.clear();
+    }
+    bucketCost = 0;
+    queued = 0;
+    building = true;
+    dirty = false;
+
+    if (grid.Inside(buildTargetX, buildTargetY) && !grid.Solid(buildTargetX, buildTargetY))
+    {
+        int cell = buildTargetY * buildWidth + buildTargetX;
+        next[cell] = 0;
+        buckets[0].push_back(cell);
+        queued = 1;
+    }
+}
+
+void FlowField::Update(const GridView& grid, int budget)
+{
+    auto start = std::chrono::steady_clock::now();
+    stats.updates++;
+
+    bool targetMoved = wantedX != targetX || wantedY != targetY;
+    bool resized = grid.width != width || grid.height != height;
+    if (building && (dirty || grid.width != buildWidth || grid.height != buildHeight))
+    {
+        // what was settled so far may rest on tiles which are gone
+        StartBuild(grid);
+    }
+    else if (!building && (dirty || targetMoved || resized || !Ready()))
+    {
+        StartBuild(grid);
+    }
+
+    if (building)
+    {
+        auto free = [&grid](int x, int y) { return !grid.Solid(x, y); };
+        int settled = 0;
+        while (queued > 0 && settled < budget)
+        {
+            std::vector<int>& bucket = buckets[bucketCost % BUCKET_COUNT];
+            if (bucket.empty())
+            {
+                bucketCost++;
+                continue;
+            }
+
+            int cell = bucket.back();
+            bucket.pop_back();
+            queued--;
+            // queued again later with a lower cost, that entry was settled already
+            if (next[cell] != bucketCost)
+                continue;
+            settled++;
+
+            int x = cell % buildWidth;
+            int y = cell / buildWidth;
+            for (const Neighbour& n : NEIGHBOURS)
+            {
+                if (!CanStep(x, y, n, free))
+                    continue;
+                int cost = bucketCost + n.cost;
+                int neighbour = (y + n.dy) * buildWidth + x + n.dx;
+                if (cost >= next[neighbour])
+                    continue;
+                next[neighbour] = static_cast<uint16_t>(cost);
+                buckets[cost % BUCKET_COUNT].push_back(neighbour);
+                queued++;
+            }
+        }
+        stats.cellsSettled += settled;
+        CountMetric(Metric::FlowCellsSettled, settled);
+
+        if (queued == 0)
+        {
+            costs.swap(next);
+            width = buildWidth;
+            height = buildHeight;
+            targetX = buildTargetX;
+            targetY = buildTargetY;
+            building = false;
+            stats.rebuilds++;
+        }
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.updateMs += ms;
+    CountMetric(Metric::FlowUpdates);
+    CountMetric(Metric::FlowUpdateUs, uint64_t(ms * 1000));
+}
+
+bool FlowField::Direction(float x, float y, float& dirX, float& dirY) const
+{
+    int cx = static_cast<int>(std::floor(x));
+    int cy = static_cast<int>(std::floor(y));
+    uint16_t cost = Cost(cx, cy);
+    if (cost == 0 || cost == FLOW_UNREACHABLE)
+        return false;
+
+    // a cell is free when the search reached it, walls are never reached
+    auto free = [this](int fx, int fy) { return Cost(fx, fy) != FLOW_UNREACHABLE; };
+    int bestX = cx;
+    int bestY = cy;
+    uint16_t bestCost = cost;
+    for (const Neighbour& n : NEIGHBOURS)
+    {
+        if (!CanStep(cx, cy, n, free))
+            continue;
+        uint16_t neighbourCost = Cost(cx + n.dx, cy + n.dy);
+        if (neighbourCost < bestCost)
+        {
+            bestCost = neighbourCost;
+            bestX = cx + n.dx;
+            bestY = cy + n.dy;
+        }
+    }
+    if (bestCost == cost)
+        return false;
+
+    float toX = bestX + .5f - x;
+    float toY = bestY + .5f - y;
+    float length = std::sqrt(toX * toX + toY * toY);
+    if (length <= 0)
+        return false;
+    dirX = toX / length;
+    dirY = toY / length;
+    return true;
+}
+
+size_t FlowField::MemoryBytes() const
+{
+    size_t bytes = (costs.capacity() + next.capacity()) * sizeof(uint16_t);
+    for (const std::vector<int>& bucket : buckets)
+    {
+        bytes += bucket.capacity() * sizeof(int);
+    }
+    return bytes;
+}
+
+FlowFieldStats FlowField::TakeStats()
+{
+    FlowFieldStats taken = stats;
+    stats = FlowFieldStats();
+    return taken;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+// Flow field.
+// Path cost from every free cell to one target cell of the tile grid, moving
+// to any of the 8 neighbours without cutting wall corners. An agent looks at
+// its cell and the neighbours and heads for the cheapest one, so any number of
+// agents share one search instead of running a path search each.
+// Costs are small integers, the search is Dijkstra with a ring of buckets
+// (Dial's algorithm), no heap. A rebuild only starts when the target moved to
+// another cell or tiles changed, and it settles at most a budget of cells per
+// Update. Until it finishes the previous field stays in use.
+
+const uint16_t FLOW_UNREACHABLE = 0xFFFF;
+
+// costs of a step, roughly 1 : sqrt(2)
+const int FLOW_STRAIGHT_COST = 5;
+const int FLOW_DIAGONAL_COST = 7;
+
+// cells settled per Update, a 64x64 level rebuilds within one tick
+const int FLOW_CELLS_PER_UPDATE = 4096;
+
+// accumulated since the last TakeStats
+struct FlowFieldStats
+{
+    int updates = 0;
+    int rebuilds = 0; // finished and swapped in
+    uint64_t cellsSettled = 0;
+    double updateMs = 0;
+};
+
+class FlowField
+{
+public:
+    // a target in another cell than the current one starts a rebuild
+    void SetTarget(vector2f pos);
+    // tiles changed, the grid view passed to Update must already show them
+    void Invalidate();
+
+    // starts or continues a rebuild, settles at most budget cells
+    void Update(const GridView& grid, int budget = FLOW_CELLS_PER_UPDATE);
+
+    bool Ready() const { return !costs.empty(); }
+
+    // path cost to the target, FLOW_UNREACHABLE outside or when walled off
+    uint16_t Cost(int x, int y) const
+    {
+        if (x < 0 || y < 0 || x >= width || y >= height)
+            return FLOW_UNREACHABLE;
+        return costs[y * width + x];
+    }
+
+    // Unit direction from pos to the centre of the cheapest neighbour cell.
+    // False in the target cell and wherever the target cannot be reached.
+    bool Direction(float x, float y, float& dirX, float& dirY) const;
+
+    FlowFieldStats TakeStats();
+
+    // both fields and the bucket queue
+    size_t MemoryBytes() const;
+
+private:
+    void StartBuild(const GridView& grid);
+
+    // the finished field
+    int width = 0;
+    int height = 0;
+    std::vector<uint16_t> costs;
+    int targetX = -1;
+    int targetY = -1;
+
+    // the field being built, swapped with costs once the queue runs dry
+    bool building = false;
+    bool dirty = false;
+    int buildWidth = 0;
+    int buildHeight = 0;
+    int buildTargetX = -1;
+    int buildTargetY = -1;
+    std::vector<uint16_t> next;
+    // cells by cost % (FLOW_DIAGONAL_COST + 1), every cost still queued is
+    // within FLOW_DIAGONAL_COST of the one being settled
+    std::vector<int> buckets[FLOW_DIAGONAL_COST + 1];
+    int bucketCost = 0;
+    int queued = 0;
+
+    int wantedX = -1;
+    int wantedY = -1;
+
+    FlowFieldStats stats;
+};
@@ -0,0 +1,180 @@
+#include "frame_pipeline.h"
+
+namespace
+{
+
+double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+void FrameFence::Reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    done = false;
+}
+
+void FrameFence::Signal()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    signalled.notify_all();
+}
+
+void FrameFence::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    signalled.wait(lock, [this]() { return done; });
+}
+
+bool FrameFence::Signalled()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return done;
+}
+
+FramePipeline::FramePipeline(int depth) : depth(depth)
+{
+    if (this->depth < 1)
+        this->depth = 1;
+    if (this->depth > MAX_PIPELINE_DEPTH)
+        this->depth = MAX_PIPELINE_DEPTH;
+
+    if (this->depth > 1)
+        renderThread = std::thread([this]() { RenderLoop(); });
+}
+
+FramePipeline::~FramePipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (renderThread.joinable())
+        renderThread.join();
+}
+
+void FramePipeline::WaitIdle()
+{
+    for (int slot = 0; slot < depth; slot++)
+    {
+        if (fences[slot].Signalled())
+            continue;
+
+        auto start = std::chrono::steady_clock::now();
+        fences[slot].Wait();
+        waitMsTotal += ElapsedMs(start);
+    }
+}
+
+int FramePipeline::Acquire()
+{
+    for (int slot = 0; slot < depth; slot++)
+    {
+        if (!inFlight[slot])
+            return slot;
+    }
+
+    // nobody presented, reuse the oldest buffer
+    int slot = presentQueue.front();
+    presentQueue.pop_front();
+    inFlight[slot] = false;
+    if (!fences[slot].Signalled())
+    {
+        auto start = std::chrono::steady_clock::now();
+        fences[slot].Wait();
+        waitMsTotal += ElapsedMs(start);
+    }
+    return slot;
+}
+
+void FramePipeline::Submit(int slot, std::function<void(int)> render)
+{
+    inFlight[slot] = true;
+    presentQueue.push_back(slot);
+    frames++;
+    fences[slot].Reset();
+
+    if (!renderThread.joinable())
+    {
+        Render(slot, render);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(Job{slot, std::move(render)});
+    }
+    wake.notify_one();
+}
+
+int FramePipeline::NextToPresent()
+{
+    if (static_cast<int>(presentQueue.size()) < depth)
+        return -1;
+
+    int slot = presentQueue.front();
+    presentQueue.pop_front();
+    if (!fences[slot].Signalled())
+    {
+        auto start = std::chrono::steady_clock::now();
+        fences[slot].Wait();
+        waitMsTotal += ElapsedMs(start);
+    }
+    return slot;
+}
+
+void FramePipeline::Presented(int slot)
+{
+    inFlight[slot] = false;
+}
+
+void FramePipeline::Flush()
+{
+    WaitIdle();
+    for (int slot : presentQueue)
+    {
+        inFlight[slot] = false;
+    }
+    presentQueue.clear();
+}
+
+FramePipelineStats FramePipeline::Stats() const
+{
+    FramePipelineStats stats;
+    stats.depth = depth;
+    stats.frames = frames;
+    stats.renderMs = frames > 0 ? renderMsTotal / frames : 0;
+    stats.waitMs = frames > 0 ? waitMsTotal / frames : 0;
+    return stats;
+}
+
+void FramePipeline::RenderLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        Render(job.slot, job.render);
+    }
+}
+
+void FramePipeline::Render(int slot, const std::function<void(int)>& render)
+{
+    auto start = std::chrono::steady_clock::now();
+    render(slot);
+    renderMsTotal += ElapsedMs(start);
+    fences[slot].Signal();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Pipelined rendering.
+// Frames are drawn on a render thread into a ring of CPU framebuffers while
+// the main thread simulates the next one and presents the one before. Every
+// buffer has a fence which is signalled when its frame is done, the depth is
+// how many buffers may be in flight: 1 renders and presents serially on the
+// calling thread, 2 presents frame N while N+1 renders, 3 keeps one more
+// frame queued so a slow frame does not hold presenting up, one frame more
+// latency for smoother frame pacing.
+//
+// A frame has to be drawn from state kept in its buffer, the main thread
+// fills that in between Acquire and Submit and is free to change the world
+// right after. Whatever the frames share besides that only changes after
+// WaitIdle.
+
+const int MAX_PIPELINE_DEPTH = 3;
+
+class FrameFence
+{
+public:
+    void Reset();
+    void Signal();
+    void Wait();
+    bool Signalled();
+
+private:
+    std::mutex mutex;
+    std::condition_variable signalled;
+    bool done = true;
+};
+
+struct FramePipelineStats
+{
+    int depth;
+    int64_t frames;
+    double renderMs;  // average time the render thread spent per frame
+    double waitMs;    // average time the main thread blocked on fences per frame
+};
+
+class FramePipeline
+{
+public:
+    explicit FramePipeline(int depth);
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    int Depth() const { return depth; }
+
+    // waits for every frame in flight, what they share may change after
+    void WaitIdle();
+
+    // a free buffer for the next frame, waits for the oldest one when every
+    // buffer is in flight. There is always a free one when every submit is
+    // followed by NextToPresent.
+    int Acquire();
+    // renders into the acquired buffer, render(slot) runs on the render thread
+    // and the slot's fence is signalled when it returns
+    void Submit(int slot, std::function<void(int)> render);
+
+    // oldest buffer in flight once all of them are in use, after waiting for
+    // its fence, -1 while the queue is still filling up
+    int NextToPresent();
+    // the buffer is free again
+    void Presented(int slot);
+
+    // drops whatever is still queued, waiting for the frames being rendered
+    void Flush();
+
+    FramePipelineStats Stats() const;
+
+private:
+    void RenderLoop();
+    void Render(int slot, const std::function<void(int)>& render);
+
+    int depth;
+    FrameFence fences[MAX_PIPELINE_DEPTH];
+    bool inFlight[MAX_PIPELINE_DEPTH] = {};
+    std::deque<int> presentQueue; // submitted slots, oldest first
+
+    // shared with the render thread
+    struct Job
+    {
+        int slot;
+        std::function<void(int)> render;
+    };
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread renderThread;
+    bool stopping = false;
+
+    int64_t frames = 0;
+    double renderMsTotal = 0; // written by whoever renders, read after a fence
+    double waitMsTotal = 0;
+};
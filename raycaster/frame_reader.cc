@@ -0,0 +1,109 @@
+// Reads the frames a running raycaster publishes with --frame-ring.
+//   frame_reader <name> [seconds]
+// Stands in for a capture or streaming process: every frame is looked at in
+// place in shared memory, never copied, and the renderer is never waited on.
+// Prints frames taken, frames dropped on both sides and the age of the frames
+// once a second.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "frame_ring.h"
+
+// how long to sleep when there is no new frame yet
+const int POLL_INTERVAL_US = 500;
+
+namespace
+{
+
+int64_t NowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// what a real consumer would hand to an encoder, it reads every pixel
+uint32_t Checksum(const FrameView& view)
+{
+    uint32_t sum = 0;
+    for (int y = 0; y < view.height; y++)
+    {
+        const uint32_t* row = reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(view.pixels) + size_t(y) * view.pitch);
+        for (int x = 0; x < view.width; x++)
+        {
+            sum = (sum ^ row[x]) * 16777619u;
+        }
+    }
+    return sum;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: frame_reader <name> [seconds]\n");
+        return 1;
+    }
+    const char* name = argv[1];
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 0;
+
+    FrameRingReader reader;
+    if (!reader.Open(name))
+    {
+        std::fprintf(stderr, "no frame ring %s, start the raycaster with --frame-ring %s\n", name, name);
+        return 1;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    auto nextReport = start + std::chrono::seconds(1);
+    uint64_t taken = 0;
+    uint64_t torn = 0;
+    uint32_t checksum = 0;
+    int64_t ageUsTotal = 0;
+    int64_t ageUsMax = 0;
+    while (seconds <= 0 || clock::now() - start < std::chrono::seconds(seconds))
+    {
+        FrameView view;
+        bool any = false;
+        while (reader.Next(view))
+        {
+            any = true;
+            uint32_t sum = Checksum(view);
+            if (!reader.Release(view))
+            {
+                torn++;
+                continue;
+            }
+            checksum = sum;
+            taken++;
+            int64_t age = NowUs() - view.timestampUs;
+            ageUsTotal += age;
+            ageUsMax = std::max(ageUsMax, age);
+        }
+
+        if (clock::now() >= nextReport)
+        {
+            nextReport = clock::now() + std::chrono::seconds(1);
+            FrameRingStats stats = reader.Stats();
+            std::printf("%llu frames published, %llu taken, dropped %llu here (%llu torn), %llu overwritten by the writer, "
+                "age avg %.2f ms max %.2f ms, checksum %08x\n",
+                (unsigned long long)stats.published, (unsigned long long)taken, (unsigned long long)stats.dropped,
+                (unsigned long long)torn, (unsigned long long)stats.overwritten,
+                taken ? ageUsTotal / 1000. / taken : 0., ageUsMax / 1000., checksum);
+            std::fflush(stdout);
+            ageUsTotal = 0;
+            ageUsMax = 0;
+        }
+
+        if (!any)
+            std::this_thread::sleep_for(std::chrono::microseconds(POLL_INTERVAL_US));
+    }
+    return 0;
+}
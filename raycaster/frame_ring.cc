@@ -0,0 +1,383 @@
+#include "frame_ring.h"
+
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+const size_t SLOT_ALIGNMENT = 64;
+
+size_t AlignUp(size_t value)
+{
+    return (value + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+}
+
+size_t HeaderBytes()
+{
+    return AlignUp(sizeof(FrameRingHeader));
+}
+
+size_t SlotPixelsOffset()
+{
+    return AlignUp(sizeof(FrameRingSlot));
+}
+
+} // namespace
+
+SharedMemory::~SharedMemory()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool SharedMemory::Create(const std::string& blockName, size_t blockSize)
+{
+    Close();
+    HANDLE map = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        DWORD(uint64_t(blockSize) >> 32), DWORD(blockSize & 0xFFFFFFFF), blockName.c_str());
+    if (!map)
+        return false;
+
+    void* view = MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, blockSize);
+    if (!view)
+    {
+        CloseHandle(map);
+        return false;
+    }
+
+    mapping = map;
+    data = static_cast<uint8_t*>(view);
+    size = blockSize;
+    name = blockName;
+    owner = true;
+    return true;
+}
+
+bool SharedMemory::Open(const std::string& blockName)
+{
+    Close();
+    HANDLE map = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, blockName.c_str());
+    if (!map)
+        return false;
+
+    void* view = MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(map);
+        return false;
+    }
+
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(view, &info, sizeof(info));
+
+    mapping = map;
+    data = static_cast<uint8_t*>(view);
+    size = info.RegionSize;
+    name = blockName;
+    owner = false;
+    return true;
+}
+
+void SharedMemory::Close()
+{
+    // the block goes away with its last handle
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    data = nullptr;
+    mapping = nullptr;
+    size = 0;
+    owner = false;
+}
+
+#else
+
+bool SharedMemory::Create(const std::string& blockName, size_t blockSize)
+{
+    Close();
+    std::string path = "/" + blockName;
+    shm_unlink(path.c_str());
+    int handle = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (handle < 0)
+        return false;
+
+    if (ftruncate(handle, off_t(blockSize)) != 0)
+    {
+        close(handle);
+        shm_unlink(path.c_str());
+        return false;
+    }
+
+    void* view = mmap(nullptr, blockSize, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+    if (view == MAP_FAILED)
+    {
+        close(handle);
+        shm_unlink(path.c_str());
+        return false;
+    }
+
+    fd = handle;
+    data = static_cast<uint8_t*>(view);
+    size = blockSize;
+    name = blockName;
+    owner = true;
+    return true;
+}
+
+bool SharedMemory::Open(const std::string& blockName)
+{
+    Close();
+    std::string path = "/" + blockName;
+    int handle = shm_open(path.c_str(), O_RDWR, 0);
+    if (handle < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(handle, &st) != 0 || st.st_size == 0)
+    {
+        close(handle);
+        return false;
+    }
+
+    void* view = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+    if (view == MAP_FAILED)
+    {
+        close(handle);
+        return false;
+    }
+
+    fd = handle;
+    data = static_cast<uint8_t*>(view);
+    size = static_cast<size_t>(st.st_size);
+    name = blockName;
+    owner = false;
+    return true;
+}
+
+void SharedMemory::Close()
+{
+    if (data)
+        munmap(data, size);
+    if (fd >= 0)
+        close(fd);
+    if (owner)
+        shm_unlink(("/" + name).c_str());
+    data = nullptr;
+    fd = -1;
+    size = 0;
+    owner = false;
+}
+
+#endif
+
+bool FrameRingWriter::Create(const std::string& name, int width, int height, int slots)
+{
+    header = nullptr;
+    if (width <= 0 || height <= 0 || slots <= 0)
+        return false;
+
+    size_t slotBytes = SlotPixelsOffset() + AlignUp(size_t(width) * height * sizeof(uint32_t));
+    if (!memory.Create(name, HeaderBytes() + slotBytes * slots))
+        return false;
+
+    // a fresh block is zero filled, the atomics start at 0
+    header = new (memory.Data()) FrameRingHeader();
+    header->slotCount = uint32_t(slots);
+    header->slotBytes = uint32_t(slotBytes);
+    header->width = uint32_t(width);
+    header->height = uint32_t(height);
+    for (int i = 0; i < slots; i++)
+    {
+        uint8_t* slot = memory.Data() + HeaderBytes() + slotBytes * i;
+        new (slot) FrameRingSlot();
+    }
+    header->version = FRAME_RING_VERSION;
+
+    // readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, FRAME_RING_MAGIC, sizeof(FRAME_RING_MAGIC));
+    return true;
+}
+
+void FrameRingWriter::Close()
+{
+    header = nullptr;
+    memory.Close();
+}
+
+void FrameRingWriter::Write(const uint32_t* pixels, int pitch, int64_t timestampUs)
+{
+    if (!IsOpen())
+        return;
+
+    uint64_t frame = header->published.load(std::memory_order_relaxed);
+    uint64_t slots = header->slotCount;
+    uint8_t* base = memory.Data() + HeaderBytes() + header->slotBytes * (frame % slots);
+    FrameRingSlot* slot = reinterpret_cast<FrameRingSlot*>(base);
+
+    // the frame this one replaces, lost when an attached reader never took it
+    if (frame >= slots && header->readers.load(std::memory_order_relaxed) > 0 &&
+        header->consumed.load(std::memory_order_relaxed) <= frame - slots)
+    {
+        header->overwritten.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    slot->sequence.store(2 * frame + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int width = int(header->width);
+    int height = int(header->height);
+    slot->frame = frame;
+    slot->timestampUs = timestampUs;
+    slot->width = uint32_t(width);
+    slot->height = uint32_t(height);
+    slot->pitch = uint32_t(width * sizeof(uint32_t));
+    slot->format = FrameFormat::Rgba8888;
+    uint8_t* out = base + SlotPixelsOffset();
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(pixels);
+    for (int y = 0; y < height; y++)
+    {
+        std::memcpy(out + size_t(y) * slot->pitch, in + size_t(y) * pitch, slot->pitch);
+    }
+
+    slot->sequence.store(2 * (frame + 1), std::memory_order_release);
+    header->published.store(frame + 1, std::memory_order_release);
+}
+
+FrameRingStats FrameRingWriter::Stats() const
+{
+    if (!header)
+        return FrameRingStats{0, 0, 0};
+    return FrameRingStats{header->published.load(std::memory_order_relaxed),
+        header->overwritten.load(std::memory_order_relaxed), 0};
+}
+
+FrameRingReader::~FrameRingReader()
+{
+    Close();
+}
+
+bool FrameRingReader::Open(const std::string& name)
+{
+    Close();
+    if (!memory.Open(name) || memory.Size() < HeaderBytes())
+        return false;
+
+    header = reinterpret_cast<FrameRingHeader*>(memory.Data());
+    bool valid = std::memcmp(header->magic, FRAME_RING_MAGIC, sizeof(FRAME_RING_MAGIC)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid = valid && header->version == FRAME_RING_VERSION && header->slotCount > 0 &&
+        memory.Size() >= HeaderBytes() + size_t(header->slotBytes) * header->slotCount;
+    if (!valid)
+    {
+        header = nullptr;
+        memory.Close();
+        return false;
+    }
+
+    // starts at the newest frame, what came before attaching is not dropped
+    uint64_t published = header->published.load(std::memory_order_acquire);
+    next = published > 0 ? published - 1 : 0;
+    dropped = 0;
+    header->consumed.store(next, std::memory_order_relaxed);
+    header->readers.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void FrameRingReader::Close()
+{
+    if (header)
+        header->readers.fetch_sub(1, std::memory_order_relaxed);
+    header = nullptr;
+    memory.Close();
+}
+
+const FrameRingSlot* FrameRingReader::Slot(uint64_t frame) const
+{
+    const uint8_t* base = memory.Data() + HeaderBytes() + size_t(header->slotBytes) * (frame % header->slotCount);
+    return reinterpret_cast<const FrameRingSlot*>(base);
+}
+
+bool FrameRingReader::Next(FrameView& out)
+{
+    if (!header)
+        return false;
+
+    uint64_t published = header->published.load(std::memory_order_acquire);
+    if (next >= published)
+        return false;
+
+    // too far behind, the oldest frame still in the ring is where to go on
+    uint64_t oldest = published > header->slotCount ? published - header->slotCount : 0;
+    if (next < oldest)
+    {
+        dropped += oldest - next;
+        next = oldest;
+    }
+
+    for (; next < published; next++)
+    {
+        const FrameRingSlot* slot = Slot(next);
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * (next + 1))
+        {
+            // being replaced by a newer frame right now
+            dropped++;
+            continue;
+        }
+
+        out.slot = slot;
+        out.sequence = sequence;
+        out.frame = slot->frame;
+        out.timestampUs = slot->timestampUs;
+        out.width = int(slot->width);
+        out.height = int(slot->height);
+        out.pitch = int(slot->pitch);
+        out.format = slot->format;
+        out.pixels = reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(slot) + SlotPixelsOffset());
+
+        // the fields above may already be from the next frame, Release tells
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            dropped++;
+            continue;
+        }
+
+        next++;
+        header->consumed.store(next, std::memory_order_relaxed);
+        return true;
+    }
+    header->consumed.store(next, std::memory_order_relaxed);
+    return false;
+}
+
+bool FrameRingReader::Release(const FrameView& view)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (view.slot->sequence.load(std::memory_order_relaxed) == view.sequence)
+        return true;
+    dropped++;
+    return false;
+}
+
+FrameRingStats FrameRingReader::Stats() const
+{
+    if (!header)
+        return FrameRingStats{0, 0, dropped};
+    return FrameRingStats{header->published.load(std::memory_order_relaxed),
+        header->overwritten.load(std::memory_order_relaxed), dropped};
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Shared memory frame ring.
+// The renderer publishes finished frames into a named shared memory block
+// for another process on the machine (capture, streaming). There are no locks
+// on either side: every slot is a seqlock, the writer bumps its sequence to
+// odd, writes and bumps it to even. A reader looks at the pixels in place and
+// checks the sequence again afterwards, a frame which changed underneath it
+// counts as dropped. The writer never waits, a slow reader loses the frames
+// that were overwritten before it got to them and both sides count them.
+//
+// Layout: FrameRingHeader, then slotCount slots of slotBytes each, every slot
+// a FrameRingSlot followed by the pixels.
+
+const char FRAME_RING_MAGIC[4] = {'R', 'C', 'F', 'R'};
+const uint32_t FRAME_RING_VERSION = 1;
+
+// a reader may run a few frames behind before it loses any
+const int FRAME_RING_SLOTS = 4;
+
+enum class FrameFormat : uint32_t
+{
+    Rgba8888 = 1, // row-major, what TransposeToRows writes
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring is shared between processes");
+
+struct FrameRingHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotBytes;
+    uint32_t width;
+    uint32_t height;
+    // frames published, the next frame goes into slot published % slotCount
+    std::atomic<uint64_t> published;
+    // frames the writer replaced before an attached reader took them
+    std::atomic<uint64_t> overwritten;
+    // written by the reader, frames it has taken (the next one it wants)
+    std::atomic<uint64_t> consumed;
+    std::atomic<uint32_t> readers;
+};
+
+struct FrameRingSlot
+{
+    // odd while written, 2 * (frame + 1) once frame is complete
+    std::atomic<uint64_t> sequence;
+    uint64_t frame;
+    int64_t timestampUs; // steady clock, comparable between processes on one machine
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch; // in bytes
+    FrameFormat format;
+};
+
+// read/write mapping of a named block of shared memory
+class SharedMemory
+{
+public:
+    SharedMemory() = default;
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    // a block which already exists under the name is replaced
+    bool Create(const std::string& name, size_t size);
+    bool Open(const std::string& name);
+    // the creator also removes the name
+    void Close();
+
+    uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    std::string name;
+    bool owner = false;
+#ifdef _WIN32
+    void* mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+struct FrameRingStats
+{
+    uint64_t published;
+    uint64_t overwritten; // by the writer, frames no reader took
+    uint64_t dropped;     // by this reader, frames it skipped or saw torn
+};
+
+class FrameRingWriter
+{
+public:
+    bool Create(const std::string& name, int width, int height, int slots = FRAME_RING_SLOTS);
+    void Close();
+    bool IsOpen() const { return header != nullptr && memory.Data() != nullptr; }
+
+    // copies one finished frame into the next slot, never waits for a reader
+    void Write(const uint32_t* pixels, int pitch, int64_t timestampUs);
+
+    FrameRingStats Stats() const;
+
+private:
+    SharedMemory memory;
+    FrameRingHeader* header = nullptr;
+};
+
+// one frame in place in the ring, valid until the writer comes around again
+struct FrameView
+{
+    const FrameRingSlot* slot;
+    uint64_t sequence;
+    uint64_t frame;
+    int64_t timestampUs;
+    int width;
+    int height;
+    int pitch;
+    FrameFormat format;
+    const uint32_t* pixels;
+};
+
+class FrameRingReader
+{
+public:
+    ~FrameRingReader();
+
+    bool Open(const std::string& name);
+    void Close();
+
+    // the oldest frame not taken yet, false when there is none. Frames the
+    // writer already replaced are skipped and counted as dropped.
+    bool Next(FrameView& out);
+    // true when the writer left the frame alone while it was looked at,
+    // otherwise whatever was read from it is torn and the frame is dropped
+    bool Release(const FrameView& view);
+
+    FrameRingStats Stats() const;
+
+private:
+    const FrameRingSlot* Slot(uint64_t frame) const;
+
+    SharedMemory memory;
+    FrameRingHeader* header = nullptr;
+    uint64_t next = 0;
+    uint64_t dropped = 0;
+};
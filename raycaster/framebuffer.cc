@@ -0,0 +1,162 @@
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAMEBUFFER_SSE2 1
+#endif
+
+namespace
+{
+
+// 4x4 register transposes are grouped into blocks small enough for source
+// and destination rows to stay in L1 while a block is written
+const int TRANSPOSE_BLOCK = 32;
+const int CACHE_LINE = 64;
+
+uint32_t* DstRow(uint32_t* dst, int pitch, int y)
+{
+    return reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(dst) + size_t(y) * pitch);
+}
+
+} // namespace
+
+template <typename Pixel>
+BasicColumnFramebuffer<Pixel>::BasicColumnFramebuffer(int width, int height)
+    : width(width), height(height)
+{
+    const int linePixels = CACHE_LINE / sizeof(Pixel);
+    const int padding = std::max(TRANSPOSE_BLOCK, linePixels);
+    columnPitch = (height + padding - 1) / padding * padding;
+    storage.resize(size_t(width) * columnPitch + linePixels);
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+    uintptr_t aligned = (address + CACHE_LINE - 1) & ~uintptr_t(CACHE_LINE - 1);
+    pixels = reinterpret_cast<Pixel*>(aligned);
+}
+
+template <typename Pixel>
+void BasicColumnFramebuffer<Pixel>::Clear(Pixel color)
+{
+    std::fill(pixels, pixels + size_t(width) * columnPitch, color);
+}
+
+template class BasicColumnFramebuffer<uint32_t>;
+template class BasicColumnFramebuffer<uint8_t>;
+
+void TransposeToRowsScalar(const ColumnFramebuffer& frame, uint32_t* dst, int pitch)
+{
+    for (int y = 0; y < frame.Height(); y++)
+    {
+        uint32_t* row = DstRow(dst, pitch, y);
+        for (int x = 0; x < frame.Width(); x++)
+        {
+            row[x] = frame.Column(x)[y];
+        }
+    }
+}
+
+void TransposeToRows(const ColumnFramebuffer& frame, uint32_t* dst, int pitch)
+{
+    int width = frame.Width();
+    int height = frame.Height();
+
+    for (int by = 0; by < height; by += TRANSPOSE_BLOCK)
+    {
+        int blockHeight = std::min(TRANSPOSE_BLOCK, height - by);
+        for (int bx = 0; bx < width; bx += TRANSPOSE_BLOCK)
+        {
+            int blockWidth = std::min(TRANSPOSE_BLOCK, width - bx);
+            int x = bx;
+#ifdef FRAMEBUFFER_SSE2
+            if (blockHeight % 4 == 0)
+            {
+                // columns are padded to whole blocks so reading 4 rows is always safe
+                for (; x + 4 <= bx + blockWidth; x += 4)
+                {
+                    const uint32_t* c0 = frame.Column(x);
+                    const uint32_t* c1 = frame.Column(x + 1);
+                    const uint32_t* c2 = frame.Column(x + 2);
+                    const uint32_t* c3 = frame.Column(x + 3);
+                    for (int y = by; y < by + blockHeight; y += 4)
+                    {
+                        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(c0 + y));
+                        __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(c1 + y));
+                        __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(c2 + y));
+                        __m128i d = _mm_load_si128(reinterpret_cast<const __m128i*>(c3 + y));
+
+                        __m128i ab0 = _mm_unpacklo_epi32(a, b);
+                        __m128i ab1 = _mm_unpackhi_epi32(a, b);
+                        __m128i cd0 = _mm_unpacklo_epi32(c, d);
+                        __m128i cd1 = _mm_unpackhi_epi32(c, d);
+
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(DstRow(dst, pitch, y) + x), _mm_unpacklo_epi64(ab0, cd0));
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(DstRow(dst, pitch, y + 1) + x), _mm_unpackhi_epi64(ab0, cd0));
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(DstRow(dst, pitch, y + 2) + x), _mm_unpacklo_epi64(ab1, cd1));
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(DstRow(dst, pitch, y + 3) + x), _mm_unpackhi_epi64(ab1, cd1));
+                    }
+                }
+            }
+#endif
+            // columns left over at the right edge, or no SSE2 at all
+            for (; x < bx + blockWidth; x++)
+            {
+                const uint32_t* column = frame.Column(x);
+                for (int y = by; y < by + blockHeight; y++)
+                {
+                    DstRow(dst, pitch, y)[x] = column[y];
+                }
+            }
+        }
+    }
+}
+
+void TransposeToRows(const IndexedFramebuffer& frame, const uint32_t* palette, uint32_t* dst, int pitch)
+{
+    int width = frame.Width();
+    int height = frame.Height();
+
+    // a block of 8-bit columns is a quarter of the 32-bit one, the palette
+    // lookup rides along with the transpose
+    for (int by = 0; by < height; by += TRANSPOSE_BLOCK)
+    {
+        int blockHeight = std::min(TRANSPOSE_BLOCK, height - by);
+        for (int bx = 0; bx < width; bx += TRANSPOSE_BLOCK)
+        {
+            int blockWidth = std::min(TRANSPOSE_BLOCK, width - bx);
+            for (int y = by; y < by + blockHeight; y++)
+            {
+                uint32_t* row = DstRow(dst, pitch, y);
+                for (int x = bx; x < bx + blockWidth; x++)
+                {
+                    row[x] = palette[frame.Column(x)[y]];
+                }
+            }
+        }
+    }
+}
+
+Image TransposeImage(const Image& image)
+{
+    Image columns;
+    columns.width = image.height;
+    columns.height = image.width;
+    columns.pitch = image.height * 4;
+    columns.storage.resize(size_t(image.width) * image.height);
+    columns.pixels = columns.storage.data();
+    TransposeImageRect(image, columns, TileRect{0, 0, image.width, image.height});
+    return columns;
+}
+
+void TransposeImageRect(const Image& image, Image& columns, const TileRect& rect)
+{
+    for (int x = rect.x; x < rect.x + rect.w; x++)
+    {
+        uint32_t* column = columns.storage.data() + size_t(x) * columns.width;
+        for (int y = rect.y; y < rect.y + rect.h; y++)
+        {
+            column[y] = image.At(x, y);
+        }
+    }
+}
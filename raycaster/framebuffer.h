@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "asset_pack.h"
+#include "level.h"
+
+// Column-major render target, pixel (x, y) lives at Column(x)[y].
+// The raycaster fills the screen one vertical column at a time, with this
+// layout every column stage writes sequentially instead of striding a row.
+// Columns are padded to whole transpose blocks and start on a cache line.
+// Pixels are RGBA8888, or palette indices for the 8-bit path.
+template <typename Pixel>
+class BasicColumnFramebuffer
+{
+public:
+    BasicColumnFramebuffer(int width, int height);
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    int ColumnPitch() const { return columnPitch; }
+
+    Pixel* Column(int x) { return pixels + size_t(x) * columnPitch; }
+    const Pixel* Column(int x) const { return pixels + size_t(x) * columnPitch; }
+
+    void Clear(Pixel color);
+
+private:
+    int width;
+    int height;
+    int columnPitch;
+    std::vector<Pixel> storage;
+    Pixel* pixels;
+};
+
+using ColumnFramebuffer = BasicColumnFramebuffer<uint32_t>;
+using IndexedFramebuffer = BasicColumnFramebuffer<uint8_t>;
+
+// Writes the framebuffer row-major into dst (pitch in bytes), in cache sized
+// blocks with 4x4 SSE2 register transposes where available.
+void TransposeToRows(const ColumnFramebuffer& frame, uint32_t* dst, int pitch);
+
+// 8-bit frame, every index goes through the palette on the way out
+void TransposeToRows(const IndexedFramebuffer& frame, const uint32_t* palette, uint32_t* dst, int pitch);
+
+// reference version of TransposeToRows, used by the benchmark
+void TransposeToRowsScalar(const ColumnFramebuffer& frame, uint32_t* dst, int pitch);
+
+// Column-major copy of an image, columns.At(y, x) == image.At(x, y), so
+// walking down a texture column walks through memory sequentially.
+Image TransposeImage(const Image& image);
+
+// refreshes one rect (in source pixels) of a transposed copy after a reload
+void TransposeImageRect(const Image& image, Image& columns, const TileRect& rect);
@@ -0,0 +1,170 @@
+// Compares drawing raycaster style columns into a row-major target against
+// the column-major framebuffer plus transpose, and against the 8-bit frame
+// expanded through a palette, at the resolutions we ship.
+//   framebuffer_bench [frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "framebuffer.h"
+
+namespace
+{
+
+const int TEX_SIZE = 64;
+const int TEX_COUNT = 8;
+
+struct Resolution
+{
+    int width, height;
+};
+
+const Resolution RESOLUTIONS[] = {
+    {640, 360},
+    {1280, 720},
+};
+
+// synthetic wall atlas, stored column-major like the game's wall columns
+std::vector<uint32_t> MakeTextureColumns()
+{
+    std::vector<uint32_t> columns(size_t(TEX_SIZE) * TEX_COUNT * TEX_SIZE);
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        columns[i] = uint32_t(i * 2654435761u) | 0xFF;
+    }
+    return columns;
+}
+
+// Fills one column the way the raycaster does: a wall slice in the middle,
+// floor below and mirrored ceiling above. put(y, color) does the write.
+template<typename Put>
+void DrawBenchColumn(const std::vector<uint32_t>& texColumns, int x, int width, int height, float phase, Put put)
+{
+    int mid = height / 2;
+    float distance = 1.5f + 4 * (1 + std::sin(x * 6.f / width + phase));
+    int sliceSize = int(width / distance);
+    int top = std::max(mid - sliceSize / 2, 0);
+    int bottom = std::min(mid + sliceSize / 2, height);
+
+    const uint32_t* texColumn = texColumns.data() + size_t(x % (TEX_SIZE * TEX_COUNT)) * TEX_SIZE;
+    float texPerRow = float(TEX_SIZE) / std::max(sliceSize, 1);
+    float texY = (top - (mid - sliceSize / 2)) * texPerRow;
+    for (int y = top; y < bottom; y++, texY += texPerRow)
+    {
+        put(y, texColumn[std::min(int(texY), TEX_SIZE - 1)]);
+    }
+
+    for (int y = bottom; y < height; y++)
+    {
+        float rowDist = float(width / 2) / (y - mid + 1);
+        int tx = int(x * rowDist) & (TEX_SIZE - 1);
+        int ty = int(rowDist * 16) & (TEX_SIZE - 1);
+        put(y, texColumns[size_t(tx) * TEX_SIZE + ty]);
+        put(height - 1 - y, texColumns[size_t(TEX_SIZE + tx) * TEX_SIZE + ty]);
+    }
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 200;
+    std::vector<uint32_t> texColumns = MakeTextureColumns();
+
+    // stand-ins for the palette and one colormap row
+    uint32_t palette[256];
+    uint8_t shade[256];
+    for (int i = 0; i < 256; i++)
+    {
+        palette[i] = uint32_t(i * 2654435761u) | 0xFF;
+        shade[i] = uint8_t(i * 3 / 4);
+    }
+
+    std::printf("%-10s %14s %14s %14s %14s %14s %14s\n", "size", "rows ms", "columns ms", "transpose ms", "scalar tr ms",
+        "8-bit ms", "expand ms");
+    for (const Resolution& res : RESOLUTIONS)
+    {
+        std::vector<uint32_t> rows(size_t(res.width) * res.height);
+        ColumnFramebuffer frame(res.width, res.height);
+        IndexedFramebuffer indexedFrame(res.width, res.height);
+        int pitch = res.width * 4;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++)
+        {
+            for (int x = 0; x < res.width; x++)
+            {
+                uint32_t* out = rows.data() + x;
+                DrawBenchColumn(texColumns, x, res.width, res.height, f * .01f, [&](int y, uint32_t c) {
+                    out[size_t(y) * res.width] = c;
+                });
+            }
+        }
+        double rowMs = ElapsedMs(start) / frames;
+
+        double columnMs = 0;
+        double transposeMs = 0;
+        for (int f = 0; f < frames; f++)
+        {
+            start = std::chrono::steady_clock::now();
+            for (int x = 0; x < res.width; x++)
+            {
+                uint32_t* out = frame.Column(x);
+                DrawBenchColumn(texColumns, x, res.width, res.height, f * .01f, [&](int y, uint32_t c) {
+                    out[y] = c;
+                });
+            }
+            columnMs += ElapsedMs(start);
+
+            start = std::chrono::steady_clock::now();
+            TransposeToRows(frame, rows.data(), pitch);
+            transposeMs += ElapsedMs(start);
+        }
+
+        start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++)
+        {
+            TransposeToRowsScalar(frame, rows.data(), pitch);
+        }
+        double scalarMs = ElapsedMs(start) / frames;
+
+        double indexedMs = 0;
+        double expandMs = 0;
+        for (int f = 0; f < frames; f++)
+        {
+            start = std::chrono::steady_clock::now();
+            for (int x = 0; x < res.width; x++)
+            {
+                uint8_t* out = indexedFrame.Column(x);
+                DrawBenchColumn(texColumns, x, res.width, res.height, f * .01f, [&](int y, uint32_t c) {
+                    out[y] = shade[c >> 24];
+                });
+            }
+            indexedMs += ElapsedMs(start);
+
+            start = std::chrono::steady_clock::now();
+            TransposeToRows(indexedFrame, palette, rows.data(), pitch);
+            expandMs += ElapsedMs(start);
+        }
+
+        char size[32];
+        std::snprintf(size, sizeof(size), "%dx%d", res.width, res.height);
+        std::printf("%-10s %14.3f %14.3f %14.3f %14.3f %14.3f %14.3f\n", size, rowMs,
+            columnMs / frames, transposeMs / frames, scalarMs, indexedMs / frames, expandMs / frames);
+        std::printf("%-10s column-major + transpose is %.2fx the row-major time\n", "",
+            (columnMs + transposeMs) / frames / rowMs);
+        std::printf("%-10s 8-bit + expand is %.2fx the row-major time\n", "",
+            (indexedMs + expandMs) / frames / rowMs);
+    }
+    return 0;
+}
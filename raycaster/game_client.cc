@@ -0,0 +1,204 @@
+#include "game_client.h"
+
+#include <cmath>
+
+namespace
+{
+
+// how fast the clock offset follows snapshots arriving later than the best one
+const double CLOCK_DRIFT_RATE = .01;
+
+const double TWO_PI = 6.283185307179586;
+
+double LerpAngle(double from, double to, double t)
+{
+    double delta = std::remainder(to - from, TWO_PI);
+    return from + delta * t;
+}
+
+NetEntity Dequantize(const EntityState& entity)
+{
+    return NetEntity{
+        entity.id, entity.kind,
+        DequantizePosition(entity.x), DequantizePosition(entity.y),
+        DequantizeAngle(entity.angle), entity.frame
+    };
+}
+
+} // namespace
+
+bool GameClient::Connect(const NetAddress& address, int64_t timeMs)
+{
+    if (!socket.Open(0))
+        return false;
+
+    server = address;
+    clientId = -1;
+    inputSequence = 0;
+    newestTick = 0;
+    clockValid = false;
+    for (Snapshot& snapshot : history)
+    {
+        snapshot.tick = 0;
+    }
+
+    uint8_t packet[16];
+    int size = WriteConnect(packet, sizeof(packet));
+    lastConnectMs = timeMs;
+    return socket.Send(server, packet, size);
+}
+
+void GameClient::Disconnect()
+{
+    if (!socket.IsOpen())
+        return;
+
+    uint8_t packet[16];
+    int size = WriteDisconnect(packet, sizeof(packet));
+    socket.Send(server, packet, size);
+    socket.Close();
+    clientId = -1;
+}
+
+void GameClient::SendInput(const PlayerInput& input)
+{
+    if (!Connected())
+        return;
+
+    InputMessage message;
+    message.sequence = ++inputSequence;
+    message.ackTick = newestTick;
+    message.buttons = input.buttons;
+    message.angle = QuantizeAngle(input.angle);
+
+    uint8_t packet[32];
+    int size = WriteInput(packet, sizeof(packet), message);
+    socket.Send(server, packet, size);
+}
+
+void GameClient::Poll(int64_t timeMs)
+{
+    if (!socket.IsOpen())
+        return;
+
+    if (!Connected() && timeMs - lastConnectMs >= CONNECT_RETRY_MS)
+    {
+        uint8_t packet[16];
+        int size = WriteConnect(packet, sizeof(packet));
+        socket.Send(server, packet, size);
+        lastConnectMs = timeMs;
+    }
+
+    uint8_t packet[MAX_PACKET_SIZE];
+    NetAddress from;
+    int size;
+    while ((size = socket.Receive(from, packet, sizeof(packet))) > 0)
+    {
+        if (from != server)
+            continue;
+        if (PeekMessageType(packet, size) == MSG_SNAPSHOT)
+            ReceiveSnapshot(packet, size, timeMs);
+    }
+}
+
+const Snapshot* GameClient::FindSnapshot(uint32_t tick) const
+{
+    const Snapshot& snapshot = history[tick % SNAPSHOT_HISTORY];
+    return tick != 0 && snapshot.tick == tick ? &snapshot : nullptr;
+}
+
+void GameClient::ReceiveSnapshot(const uint8_t* packet, int size, int64_t timeMs)
+{
+    SnapshotHeader header;
+    if (!ReadSnapshotHeader(packet, size, header))
+    {
+        snapshotsDropped++;
+        return;
+    }
+    // older than anything kept, or a duplicate
+    if (header.tick + SNAPSHOT_HISTORY <= newestTick || FindSnapshot(header.tick))
+        return;
+
+    // decoded into a scratch snapshot, the slot may hold the baseline itself
+    Snapshot decoded;
+    if (!ReadSnapshot(packet, size, FindSnapshot(header.baseTick), decoded))
+    {
+        snapshotsDropped++;
+        return;
+    }
+    history[header.tick % SNAPSHOT_HISTORY] = std::move(decoded);
+
+    snapshotsReceived++;
+    clientId = header.clientId;
+    if (header.tick > newestTick)
+        newestTick = header.tick;
+
+    double offset = double(timeMs) - double(header.tick) * SERVER_TICK_MS;
+    if (!clockValid || offset < clockOffset)
+        clockOffset = offset;
+    else
+        clockOffset += (offset - clockOffset) * CLOCK_DRIFT_RATE;
+    clockValid = true;
+}
+
+bool GameClient::Interpolate(int64_t timeMs, std::vector<NetEntity>& out) const
+{
+    out.clear();
+    if (!clockValid)
+        return false;
+
+    double renderTime = double(timeMs) - clockOffset - INTERPOLATION_DELAY_MS;
+
+    // newest snapshot at or before renderTime and the oldest one after it
+    const Snapshot* from = nullptr;
+    const Snapshot* to = nullptr;
+    for (const Snapshot& snapshot : history)
+    {
+        if (snapshot.tick == 0)
+            continue;
+
+        double time = double(snapshot.tick) * SERVER_TICK_MS;
+        if (time <= renderTime)
+        {
+            if (!from || snapshot.tick > from->tick)
+                from = &snapshot;
+        }
+        else if (!to || snapshot.tick < to->tick)
+        {
+            to = &snapshot;
+        }
+    }
+
+    // no extrapolation, hold the closest snapshot
+    if (!from || !to)
+    {
+        const Snapshot* only = from ? from : to;
+        for (const EntityState& entity : only->entities)
+        {
+            out.push_back(Dequantize(entity));
+        }
+        return true;
+    }
+
+    double t = (renderTime - double(from->tick) * SERVER_TICK_MS) / (double(to->tick - from->tick) * SERVER_TICK_MS);
+
+    // both lists are sorted by id, entities missing from `to` are held
+    size_t j = 0;
+    for (const EntityState& entity : from->entities)
+    {
+        NetEntity blended = Dequantize(entity);
+        while (j < to->entities.size() && to->entities[j].id < entity.id)
+        {
+            j++;
+        }
+        if (j < to->entities.size() && to->entities[j].id == entity.id)
+        {
+            NetEntity next = Dequantize(to->entities[j]);
+            blended.x += float((next.x - blended.x) * t);
+            blended.y += float((next.y - blended.y) * t);
+            blended.angle = LerpAngle(blended.angle, next.angle, t);
+        }
+        out.push_back(blended);
+    }
+    return true;
+}
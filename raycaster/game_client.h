@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "net.h"
+#include "protocol.h"
+#include "simulation.h"
+
+// entities are shown this far behind the newest snapshot, about three ticks,
+// so there are nearly always two snapshots to blend between
+const int INTERPOLATION_DELAY_MS = 100;
+
+const int CONNECT_RETRY_MS = 500;
+
+// dequantized and interpolated entity, ready to render
+struct NetEntity
+{
+    uint16_t id;
+    EntityKind kind;
+    float x, y;
+    double angle;
+    int frame;
+};
+
+// Client end of the server protocol.
+// Sends input commands, decodes snapshot deltas against the snapshots it
+// kept and interpolates between them. Times are in ms of any steady clock.
+class GameClient
+{
+public:
+    bool Connect(const NetAddress& server, int64_t timeMs);
+    void Disconnect();
+
+    // true once the first snapshot arrived
+    bool Connected() const { return clientId >= 0; }
+    int ClientId() const { return clientId; }
+
+    void SendInput(const PlayerInput& input);
+
+    // drains the socket, retries connecting until the server answers
+    void Poll(int64_t timeMs);
+
+    // world as of INTERPOLATION_DELAY_MS ago, false before the first snapshot
+    bool Interpolate(int64_t timeMs, std::vector<NetEntity>& out) const;
+
+    uint64_t BytesSent() const { return socket.BytesSent(); }
+    uint64_t BytesReceived() const { return socket.BytesReceived(); }
+    int SnapshotsReceived() const { return snapshotsReceived; }
+    // deltas whose baseline was already gone, and packets that failed to decode
+    int SnapshotsDropped() const { return snapshotsDropped; }
+
+private:
+    const Snapshot* FindSnapshot(uint32_t tick) const;
+    void ReceiveSnapshot(const uint8_t* packet, int size, int64_t timeMs);
+
+    UdpSocket socket;
+    NetAddress server;
+    int clientId = -1;
+    uint32_t inputSequence = 0;
+    uint32_t newestTick = 0;
+    int64_t lastConnectMs = 0;
+    // by tick % SNAPSHOT_HISTORY, baselines and interpolation sources
+    std::array<Snapshot, SNAPSHOT_HISTORY> history;
+    // local time minus server time, taken from the least delayed snapshot
+    double clockOffset = 0;
+    bool clockValid = false;
+    int snapshotsReceived = 0;
+    int snapshotsDropped = 0;
+};
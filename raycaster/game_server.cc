@@ -0,0 +1,255 @@
+#include "game_server.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+
+const uint32_t CLIENT_TIMEOUT_TICKS = CLIENT_TIMEOUT_MS / SERVER_TICK_MS;
+
+// player ids come first, enemies follow
+const int ENEMY_ID_BASE = MAX_CLIENTS;
+
+float DistanceSquared(const EntityState& entity, const vector2f& pos)
+{
+    float dx = DequantizePosition(entity.x) - pos.x;
+    float dy = DequantizePosition(entity.y) - pos.y;
+    return dx * dx + dy * dy;
+}
+
+} // namespace
+
+GameServer::GameServer(JobSystem& jobs, const Level& level)
+    : jobs(jobs), level(level), enemies(ENTITY_CAPACITY), clients(MAX_CLIENTS)
+{
+    SpawnEnemies(enemies, this->level.Walls());
+    world.reserve(MAX_CLIENTS + ENTITY_CAPACITY);
+}
+
+bool GameServer::Start(uint16_t port)
+{
+    return socket.Open(port);
+}
+
+int GameServer::ClientCount() const
+{
+    return static_cast<int>(std::count_if(clients.begin(), clients.end(),
+        [](const Client& client) { return client.connected; }));
+}
+
+ServerStats GameServer::TakeStats()
+{
+    ServerStats taken = stats;
+    taken.clients = ClientCount();
+    stats = ServerStats();
+    return taken;
+}
+
+void GameServer::Tick()
+{
+    auto start = std::chrono::steady_clock::now();
+    tick++;
+
+    uint64_t bytesIn = socket.BytesReceived();
+    uint64_t bytesOut = socket.BytesSent();
+
+    ReceivePackets();
+    Simulate();
+    SendSnapshots();
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.ticks++;
+    stats.tickMsTotal += ms;
+    stats.tickMsMax = std::max(stats.tickMsMax, ms);
+    stats.bytesIn += socket.BytesReceived() - bytesIn;
+    stats.bytesOut += socket.BytesSent() - bytesOut;
+}
+
+int GameServer::FindClient(const NetAddress& address) const
+{
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].connected && clients[i].address == address)
+            return i;
+    }
+    return -1;
+}
+
+void GameServer::Connect(const NetAddress& address)
+{
+    // a repeated connect of a known client keeps its slot
+    if (FindClient(address) >= 0)
+        return;
+
+    for (Client& client : clients)
+    {
+        if (client.connected)
+            continue;
+
+        client.connected = true;
+        client.address = address;
+        client.player = SpawnPlayer();
+        client.input = PlayerInput();
+        client.input.angle = client.player.angle;
+        client.inputSequence = 0;
+        client.ackTick = 0;
+        client.lastHeardTick = tick;
+        for (Snapshot& snapshot : client.history)
+        {
+            snapshot.tick = 0;
+        }
+        return;
+    }
+}
+
+void GameServer::ReceivePackets()
+{
+    uint8_t packet[MAX_PACKET_SIZE];
+    NetAddress from;
+    int size;
+    while ((size = socket.Receive(from, packet, sizeof(packet))) > 0)
+    {
+        switch (PeekMessageType(packet, size))
+        {
+            case MSG_CONNECT:
+                if (size >= 2 && packet[1] == PROTOCOL_VERSION)
+                    Connect(from);
+                break;
+
+            case MSG_INPUT:
+            {
+                int index = FindClient(from);
+                InputMessage input;
+                if (index < 0 || !ReadInput(packet, size, input))
+                    break;
+
+                Client& client = clients[index];
+                client.lastHeardTick = tick;
+                // late or duplicated datagrams are ignored
+                if (input.sequence <= client.inputSequence)
+                    break;
+
+                client.inputSequence = input.sequence;
+                client.input.buttons = input.buttons;
+                client.input.angle = DequantizeAngle(input.angle);
+                if (input.ackTick > client.ackTick && input.ackTick < tick)
+                    client.ackTick = input.ackTick;
+                break;
+            }
+
+            case MSG_DISCONNECT:
+            {
+                int index = FindClient(from);
+                if (index >= 0)
+                    clients[index].connected = false;
+                break;
+            }
+        }
+    }
+
+    for (Client& client : clients)
+    {
+        if (client.connected && tick - client.lastHeardTick > CLIENT_TIMEOUT_TICKS)
+            client.connected = false;
+    }
+}
+
+void GameServer::Simulate()
+{
+    // enemies only know about a single player, they hunt the first one
+    vector2f target = {-1000, -1000};
+    bool haveTarget = false;
+    for (Client& client : clients)
+    {
+        if (!client.connected)
+            continue;
+
+        ApplyPlayerInput(client.player, client.input, level, SERVER_TICK_MS);
+        if (!haveTarget)
+        {
+            target = client.player.pos;
+            haveTarget = true;
+        }
+    }
+
+    const FlowField* hunt = nullptr;
+    if (haveTarget)
+    {
+        flow.SetTarget(target);
+        flow.Update(level.Walls());
+        stats.flowMsTotal += flow.TakeStats().updateMs;
+        hunt = &flow;
+    }
+
+    SimulationContext simulation = {level.Walls(), target, SERVER_TICK_MS, hunt};
+    UpdateEntities(enemies, simulation, jobs);
+
+    world.clear();
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        const Client& client = clients[i];
+        if (!client.connected)
+            continue;
+
+        world.push_back(EntityState{
+            uint16_t(i), EntityKind::Player,
+            QuantizePosition(client.player.pos.x), QuantizePosition(client.player.pos.y),
+            QuantizeAngle(client.player.angle), 0
+        });
+    }
+    for (int i = 0; i < enemies.Count(); i++)
+    {
+        stats.agentsTracking += enemies.aiState[i] == AiState::Track;
+        world.push_back(EntityState{
+            uint16_t(ENEMY_ID_BASE + i), EntityKind::Enemy,
+            QuantizePosition(enemies.posX[i]), QuantizePosition(enemies.posY[i]),
+            0, uint8_t(enemies.frame[i])
+        });
+    }
+}
+
+void GameServer::BuildSnapshot(const Client& client, Snapshot& out)
+{
+    out.tick = tick;
+    out.entities.assign(world.begin(), world.end());
+    if (out.entities.size() <= size_t(MAX_SNAPSHOT_ENTITIES))
+        return;
+
+    vector2f pos = client.player.pos;
+    std::nth_element(out.entities.begin(), out.entities.begin() + MAX_SNAPSHOT_ENTITIES, out.entities.end(),
+        [&](const EntityState& a, const EntityState& b) { return DistanceSquared(a, pos) < DistanceSquared(b, pos); });
+    out.entities.resize(MAX_SNAPSHOT_ENTITIES);
+    std::sort(out.entities.begin(), out.entities.end(),
+        [](const EntityState& a, const EntityState& b) { return a.id < b.id; });
+}
+
+void GameServer::SendSnapshots()
+{
+    uint8_t packet[MAX_PACKET_SIZE];
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        Client& client = clients[i];
+        if (!client.connected)
+            continue;
+
+        Snapshot& snapshot = client.history[tick % SNAPSHOT_HISTORY];
+        BuildSnapshot(client, snapshot);
+
+        const Snapshot* baseline = nullptr;
+        if (client.ackTick != 0 && tick - client.ackTick < uint32_t(SNAPSHOT_HISTORY))
+        {
+            const Snapshot& acked = client.history[client.ackTick % SNAPSHOT_HISTORY];
+            if (acked.tick == client.ackTick)
+                baseline = &acked;
+        }
+
+        int size = WriteSnapshot(packet, sizeof(packet), uint8_t(i), snapshot, baseline);
+        if (size > 0 && socket.Send(client.address, packet, size))
+        {
+            stats.snapshots++;
+            if (baseline)
+                stats.deltaSnapshots++;
+        }
+    }
+}
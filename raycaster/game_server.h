@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "entities.h"
+#include "flow_field.h"
+#include "job_system.h"
+#include "level.h"
+#include "net.h"
+#include "protocol.h"
+#include "simulation.h"
+
+// clients which have not sent anything for this long are dropped
+const int CLIENT_TIMEOUT_MS = 3000;
+
+// accumulated since the last TakeStats
+struct ServerStats
+{
+    int ticks = 0;
+    double tickMsTotal = 0;
+    double tickMsMax = 0;
+    int clients = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t snapshots = 0;
+    uint64_t deltaSnapshots = 0;
+    // enemy flow field towards the hunted player
+    double flowMsTotal = 0;
+    uint64_t agentsTracking = 0; // summed over ticks
+};
+
+// Authoritative world for up to MAX_CLIENTS players over UDP.
+// Every Tick() drains incoming packets, steps each player with its newest
+// input and the enemies by SERVER_TICK_MS, then sends every client a snapshot
+// delta-compressed against the newest one the client acknowledged.
+class GameServer
+{
+public:
+    GameServer(JobSystem& jobs, const Level& level);
+
+    bool Start(uint16_t port);
+    void Tick();
+
+    uint32_t CurrentTick() const { return tick; }
+    int ClientCount() const;
+    ServerStats TakeStats();
+
+private:
+    struct Client
+    {
+        bool connected = false;
+        NetAddress address;
+        Player player;
+        PlayerInput input;
+        uint32_t inputSequence = 0;
+        uint32_t ackTick = 0;
+        uint32_t lastHeardTick = 0;
+        // sent snapshots by tick % SNAPSHOT_HISTORY, baselines for later deltas
+        std::array<Snapshot, SNAPSHOT_HISTORY> history;
+    };
+
+    int FindClient(const NetAddress& address) const;
+    void Connect(const NetAddress& address);
+    void ReceivePackets();
+    void Simulate();
+    void SendSnapshots();
+    // entities the client sees this tick, the nearest ones when there are too many
+    void BuildSnapshot(const Client& client, Snapshot& out);
+
+    JobSystem& jobs;
+    Level level;
+    EntityStore enemies;
+    FlowField flow;
+    UdpSocket socket;
+    std::vector<Client> clients;
+    // 0 is never sent, it means "no baseline" on the wire
+    uint32_t tick = 0;
+    ServerStats stats;
+    // every entity of the current tick, sorted by id
+    std::vector<EntityState> world;
+};
@@ -0,0 +1,171 @@
+#include "grid_traversal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace
+{
+
+template <typename Scalar>
+Scalar Delta(Scalar dir)
+{
+    return (dir == Scalar(0)) ? ScalarTraits<Scalar>::Max() : Abs(Scalar(1) / dir);
+}
+
+template <typename Scalar>
+int Step(Scalar dir)
+{
+    return dir > Scalar(0) ? 1 : -1;
+}
+
+// distance along the ray to a grid line, computed from the line every time
+// instead of summed up step by step, so a replayed hit gets the same bits
+template <typename Scalar>
+Scalar LineDistance(int line, Scalar origin, int step, Scalar delta)
+{
+    return (Scalar(line) - origin) * (step > 0 ? delta : -delta);
+}
+
+// the next grid line the ray crosses after cell
+int NextLine(int cell, int step)
+{
+    return step > 0 ? cell + 1 : cell;
+}
+
+} // namespace
+
+bool SamePath(const RayPath& a, const RayPath& b)
+{
+    if (!a.complete || !b.complete || a.steps != b.steps || a.stepX != b.stepX || a.stepY != b.stepY)
+        return false;
+    for (int i = 0; i < (a.steps + 63) / 64; i++)
+    {
+        uint64_t mask = (a.steps - i * 64) >= 64 ? ~0ull : (1ull << (a.steps - i * 64)) - 1;
+        if ((a.sides[i] ^ b.sides[i]) & mask)
+            return false;
+    }
+    return true;
+}
+
+bool StepsLike(const RayPath& path, vector2f dir)
+{
+    return Step(dir.x) == path.stepX && Step(dir.y) == path.stepY;
+}
+
+template <typename Scalar>
+BasicGridTraversal<Scalar>::BasicGridTraversal(const GridView& grid, vector2f origin, vector2f dir, float maxDistance, RayPath* path)
+    : grid(grid), path(path)
+{
+    originX = ScalarTraits<Scalar>::From(origin.x);
+    originY = ScalarTraits<Scalar>::From(origin.y);
+    dirX = ScalarTraits<Scalar>::From(dir.x);
+    dirY = ScalarTraits<Scalar>::From(dir.y);
+    this->maxDistance = ScalarTraits<Scalar>::From(maxDistance);
+
+    mapX = ToInt(originX);
+    mapY = ToInt(originY);
+
+    deltaX = Delta(dirX);
+    deltaY = Delta(dirY);
+    stepX = Step(dirX);
+    stepY = Step(dirY);
+    rayX = LineDistance(NextLine(mapX, stepX), originX, stepX, deltaX);
+    rayY = LineDistance(NextLine(mapY, stepY), originY, stepY, deltaY);
+
+    if (path)
+    {
+        path->stepX = stepX;
+        path->stepY = stepY;
+        path->steps = 0;
+        path->complete = true;
+        std::fill(std::begin(path->sides), std::end(path->sides), 0);
+    }
+}
+
+template <typename Scalar>
+bool BasicGridTraversal<Scalar>::Next(BasicGridHit<Scalar>& hit)
+{
+    for (;;)
+    {
+        Scalar distance;
+        TILE_SIDE side;
+        if (rayX < rayY)
+        {
+            distance = rayX;
+            mapX += stepX;
+            rayX = LineDistance(NextLine(mapX, stepX), originX, stepX, deltaX);
+            side = X;
+        }
+        else
+        {
+            distance = rayY;
+            mapY += stepY;
+            rayY = LineDistance(NextLine(mapY, stepY), originY, stepY, deltaY);
+            side = Y;
+        }
+
+        if (path)
+        {
+            if (steps < RAY_PATH_MAX_STEPS)
+            {
+                if (side == X)
+                    path->sides[steps / 64] |= 1ull << (steps % 64);
+                path->steps = steps + 1;
+            }
+            else
+            {
+                path->complete = false;
+            }
+        }
+        steps++;
+
+        if (distance >= maxDistance)
+        {
+            if (path)
+                path->complete = false;
+            return false;
+        }
+        if (!grid.Inside(mapX, mapY))
+            return false;
+
+        // the bits stay in cache, the tile id is only read for a hit
+        if (grid.Solid(mapX, mapY))
+        {
+            hit.x = mapX;
+            hit.y = mapY;
+            hit.tile = grid.cells[mapY * grid.width + mapX];
+            hit.side = side;
+            hit.distance = distance;
+            hit.exitDistance = std::min(rayX, rayY);
+            hit.hitX = originX + dirX * distance;
+            hit.hitY = originY + dirY * distance;
+            return true;
+        }
+    }
+}
+
+template class BasicGridTraversal<float>;
+template class BasicGridTraversal<double>;
+template class BasicGridTraversal<Fixed>;
+
+GridHit ReplayHit(const GridHit& hit, vector2f origin, vector2f dir)
+{
+    float deltaX = Delta(dir.x);
+    float deltaY = Delta(dir.y);
+    int stepX = Step(dir.x);
+    int stepY = Step(dir.y);
+
+    // the line crossed into the cell is the one the previous cell leaves through
+    float distance = hit.side == X
+        ? LineDistance(NextLine(hit.x - stepX, stepX), origin.x, stepX, deltaX)
+        : LineDistance(NextLine(hit.y - stepY, stepY), origin.y, stepY, deltaY);
+
+    GridHit out = hit;
+    out.distance = distance;
+    out.exitDistance = std::min(LineDistance(NextLine(hit.x, stepX), origin.x, stepX, deltaX),
+        LineDistance(NextLine(hit.y, stepY), origin.y, stepY, deltaY));
+    out.hitX = origin.x + dir.x * distance;
+    out.hitY = origin.y + dir.y * distance;
+    return out;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+#include "scalar.h"
+#include "types.h"
+
+template <typename Scalar>
+struct BasicGridHit
+{
+    int x, y;         // cell
+    int tile;         // cell value
+    TILE_SIDE side;   // grid line crossed to enter the cell
+    Scalar distance;  // along the ray to the entry point
+    Scalar exitDistance; // along the ray to where it leaves the cell again
+    Scalar hitX, hitY; // entry point
+};
+
+using GridHit = BasicGridHit<float>;
+
+const int RAY_PATH_MAX_STEPS = 128;
+
+// The cells a ray stepped through, as the grid line crossed at every step.
+// Two rays from the same point with the same path cross the same cell edges
+// in the same order, and so does every ray between them: the wedge they span
+// is covered by those cells. Their hits then follow from the edges alone, see
+// ReplayHit, without walking the grid again.
+struct RayPath
+{
+    int stepX, stepY;
+    int steps;
+    bool complete; // false when the walk was cut by maxDistance or the step limit
+    uint64_t sides[RAY_PATH_MAX_STEPS / 64]; // bit set for an X step
+};
+
+bool SamePath(const RayPath& a, const RayPath& b);
+
+// Incremental DDA walk over a grid, Next returns the non-empty cells the ray
+// enters in front to back order. The caller decides when to stop, so one walk
+// can collect several hits (lower walls, masked tiles) and end as soon as
+// everything behind is hidden. dir has to be normalized for distances to be
+// in cells.
+// Instantiated for float, which everything draws and queries with, and for
+// double and Fixed (scalar_bench). The ray is converted to Scalar once, a
+// Fixed walk steps with integer instructions only.
+template <typename Scalar>
+class BasicGridTraversal
+{
+public:
+    // path, when given, records every step until the walk ends or the caller stops
+    BasicGridTraversal(const GridView& grid, vector2f origin, vector2f dir, float maxDistance, RayPath* path = nullptr);
+
+    bool Next(BasicGridHit<Scalar>& hit);
+
+    // cells stepped through so far
+    int Steps() const { return steps; }
+
+private:
+    GridView grid;
+    Scalar originX, originY;
+    Scalar dirX, dirY;
+    Scalar maxDistance;
+    RayPath* path;
+
+    int mapX, mapY;
+    int stepX, stepY;
+    Scalar deltaX, deltaY;
+    Scalar rayX, rayY;
+    int steps = 0;
+};
+
+using GridTraversal = BasicGridTraversal<float>;
+
+// The hit a ray along dir gets in a cell of a path it shares with another
+// ray, bit for bit what its own GridTraversal would return. Only the cell,
+// tile and side are read from hit.
+GridHit ReplayHit(const GridHit& hit, vector2f origin, vector2f dir);
+
+// whether a ray along dir steps the same way as the rays of a path
+bool StepsLike(const RayPath& path, vector2f dir);
@@ -0,0 +1,187 @@
+// Headless host for many worlds in one process.
+//   host [worlds] [seconds]
+// Every world has its own player wandering with random keys, its own enemies,
+// lights and frame, all of them are stepped and drawn on one job system. The
+// level and the art are loaded once and shared. Prints what each session
+// costs on top of the shared assets, then tick times once a second.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "SDL2/include/SDL.h"
+#include "SDL2_image/include/SDL_image.h"
+
+#include "asset_loader.h"
+#include "asset_pack.h"
+#include "framebuffer.h"
+#include "job_system.h"
+#include "level.h"
+#include "simulation.h"
+#include "virtual_texture.h"
+#include "world_renderer.h"
+#include "world_session.h"
+
+const char LEVEL_PATH[] = "data/level.txt";
+const char WALL_TEXTURES_PATH[] = "data/wolftextures.png";
+const char ENEMY_TEXTURES_PATH[] = "data/enemy.png";
+const char VIRTUAL_TEXTURES_PATH[] = "data/textures.vt";
+
+// every world is stepped and drawn once per tick
+const int HOST_TICK_MS = 1000 / 30;
+// how long a wandering player keeps its keys before picking new ones
+const int WANDER_INPUT_HOLD_MS = 1000;
+
+namespace
+{
+
+bool LoadSharedAssets(SharedAssets& assets)
+{
+    if (!LoadLevel(LEVEL_PATH, assets.level))
+    {
+        std::fprintf(stderr, "failed to load %s\n", LEVEL_PATH);
+        return false;
+    }
+
+    AssetPack pack;
+    pack.Open(ASSET_PACK_PATH);
+
+    // the baked set when there is one, the atlas otherwise, read in full once
+    Image wallImage;
+    VirtualTextureFile baked;
+    if (baked.Open(VIRTUAL_TEXTURES_PATH))
+    {
+        if (!assets.textures.Load(baked))
+        {
+            std::fprintf(stderr, "failed to read %s\n", VIRTUAL_TEXTURES_PATH);
+            return false;
+        }
+    }
+    else
+    {
+        if (!LoadImageAsset(pack, WALL_TEXTURES_PATH, wallImage))
+        {
+            std::fprintf(stderr, "failed to load %s: %s\n", WALL_TEXTURES_PATH, SDL_GetError());
+            return false;
+        }
+        ImageTileSource atlas(wallImage, TILE_SIZE);
+        if (!assets.textures.Load(atlas))
+        {
+            std::fprintf(stderr, "failed to read the pages of %s\n", WALL_TEXTURES_PATH);
+            return false;
+        }
+    }
+
+    Image enemyImage;
+    if (!LoadImageAsset(pack, ENEMY_TEXTURES_PATH, enemyImage))
+    {
+        std::fprintf(stderr, "failed to load %s: %s\n", ENEMY_TEXTURES_PATH, SDL_GetError());
+        return false;
+    }
+    assets.sprites.columns = TransposeImage(enemyImage);
+    assets.sprites.frameWidth = enemyImage.width / ENEMY_FRAME_COUNT;
+    return true;
+}
+
+struct Wanderer
+{
+    PlayerInput input;
+    int heldMs = WANDER_INPUT_HOLD_MS;
+};
+
+void Wander(Wanderer& wanderer, std::mt19937& random, int tickMs)
+{
+    wanderer.heldMs += tickMs;
+    if (wanderer.heldMs < WANDER_INPUT_HOLD_MS)
+        return;
+
+    wanderer.heldMs = 0;
+    wanderer.input.buttons = static_cast<uint8_t>(random() & (INPUT_FORWARD | INPUT_LEFT | INPUT_RIGHT | INPUT_FIRE));
+    wanderer.input.angle = std::uniform_real_distribution<double>(0, 2 * PI)(random);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int worlds = argc > 1 ? std::atoi(argv[1]) : 8;
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 0;
+    if (worlds <= 0)
+    {
+        std::fprintf(stderr, "usage: host [worlds] [seconds]\n");
+        return 1;
+    }
+
+    SDL_Init(0);
+    IMG_Init(IMG_INIT_PNG);
+
+    SharedAssets assets;
+    if (!LoadSharedAssets(assets))
+        return 1;
+
+    std::vector<std::unique_ptr<WorldSession>> sessions;
+    std::vector<Wanderer> wanderers(worlds);
+    std::vector<std::mt19937> randoms;
+    for (int i = 0; i < worlds; i++)
+    {
+        sessions.push_back(std::make_unique<WorldSession>(assets));
+        wanderers[i].input.angle = sessions[i]->CurrentPlayer().angle;
+        randoms.emplace_back(1234 + i);
+    }
+
+    size_t sessionBytes = sessions[0]->MemoryBytes();
+    size_t frameBytes = size_t(PLANE_WIDTH) * PLANE_HEIGHT * sizeof(uint32_t);
+    std::printf("shared assets %.1f KB, per session %.1f KB (frame %.1f KB), %d sessions %.1f KB\n",
+        assets.MemoryBytes() / 1024., sessionBytes / 1024., frameBytes / 1024., worlds,
+        (assets.MemoryBytes() + sessionBytes * worlds) / 1024.);
+    std::fflush(stdout);
+
+    // a session is one chunk, its enemies run nested on the same workers
+    JobSystem jobs;
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    auto nextTick = start;
+    auto nextReport = start + std::chrono::seconds(1);
+    int ticks = 0;
+    double tickMsTotal = 0;
+    double tickMsMax = 0;
+    while (seconds <= 0 || clock::now() - start < std::chrono::seconds(seconds))
+    {
+        auto tickStart = clock::now();
+        jobs.ParallelFor(worlds, 1, [&](int begin, int end) {
+            for (int i = begin; i < end; i++)
+            {
+                Wander(wanderers[i], randoms[i], HOST_TICK_MS);
+                sessions[i]->Step(wanderers[i].input, HOST_TICK_MS, jobs);
+                sessions[i]->Render(jobs);
+            }
+        });
+        double tickMs = std::chrono::duration<double, std::milli>(clock::now() - tickStart).count();
+        ticks++;
+        tickMsTotal += tickMs;
+        tickMsMax = std::max(tickMsMax, tickMs);
+
+        if (clock::now() >= nextReport)
+        {
+            nextReport = clock::now() + std::chrono::seconds(1);
+            std::printf("%d worlds: tick avg %.3f ms max %.3f ms, budget %d ms\n", worlds,
+                ticks ? tickMsTotal / ticks : 0., tickMsMax, HOST_TICK_MS);
+            std::fflush(stdout);
+            ticks = 0;
+            tickMsTotal = 0;
+            tickMsMax = 0;
+        }
+
+        // fixed rate, a tick that ran late is not made up for
+        nextTick += std::chrono::milliseconds(HOST_TICK_MS);
+        if (nextTick < clock::now())
+            nextTick = clock::now();
+        std::this_thread::sleep_until(nextTick);
+    }
+    return 0;
+}
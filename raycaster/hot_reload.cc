@@ -0,0 +1,180 @@
+#include "hot_reload.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "asset_loader.h"
+
+HotReloader::HotReloader(JobSystem& jobs) : jobs(jobs)
+{
+}
+
+HotReloader::~HotReloader()
+{
+    watcher.Stop();
+    while (inFlight.load() > 0)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void HotReloader::WatchLevel(const std::string& path, const Level& current)
+{
+    levelPath = path;
+    levelBaseline = current;
+    watcher.Watch(path);
+}
+
+void HotReloader::WatchImage(const std::string& path, const Image& current, int tileSize)
+{
+    WatchedImage watched;
+    watched.path = path;
+    watched.tileSize = tileSize;
+    // the current image may be a view into the mapped pack, keep an owned copy
+    watched.baseline.width = current.width;
+    watched.baseline.height = current.height;
+    watched.baseline.pitch = current.width * 4;
+    watched.baseline.storage.resize(size_t(current.width) * current.height);
+    for (int y = 0; y < current.height; y++)
+    {
+        std::memcpy(watched.baseline.storage.data() + size_t(y) * current.width,
+            reinterpret_cast<const uint8_t*>(current.pixels) + y * current.pitch,
+            current.width * 4);
+    }
+    watched.baseline.pixels = watched.baseline.storage.data();
+    images.push_back(std::move(watched));
+    watcher.Watch(path);
+}
+
+bool HotReloader::Start()
+{
+    return watcher.Start();
+}
+
+void HotReloader::Poll()
+{
+    for (const std::string& path : watcher.TakeChanged())
+    {
+        if (path == levelPath)
+        {
+            inFlight++;
+            jobs.Submit([this]() {
+                ReloadLevel();
+                inFlight--;
+            });
+            continue;
+        }
+        for (WatchedImage& watched : images)
+        {
+            if (watched.path == path)
+            {
+                inFlight++;
+                jobs.Submit([this, &watched]() {
+                    ReloadImage(watched);
+                    inFlight--;
+                });
+            }
+        }
+    }
+}
+
+void HotReloader::ReloadLevel()
+{
+    std::lock_guard<std::mutex> busy(busyMutex);
+
+    LevelReload reload;
+    // a half written file fails to parse, the next write event retries
+    if (!LoadLevel(levelPath, reload.level))
+        return;
+
+    reload.resized = reload.level.width != levelBaseline.width || reload.level.height != levelBaseline.height;
+    if (reload.resized)
+        reload.dirty.push_back(TileRect{0, 0, reload.level.width, reload.level.height});
+    else
+        reload.dirty = DiffLevel(levelBaseline, reload.level);
+
+    if (reload.dirty.empty())
+        return;
+
+    levelBaseline = reload.level;
+    std::lock_guard<std::mutex> lock(resultMutex);
+    levelResults.push_back(std::move(reload));
+}
+
+void HotReloader::ReloadImage(WatchedImage& watched)
+{
+    std::lock_guard<std::mutex> busy(busyMutex);
+
+    ImageReload reload;
+    reload.path = watched.path;
+    if (!DecodeImage(watched.path, reload.image))
+        return;
+
+    reload.resized = reload.image.width != watched.baseline.width || reload.image.height != watched.baseline.height;
+    if (reload.resized)
+        reload.dirty.push_back(TileRect{0, 0, reload.image.width, reload.image.height});
+    else
+        reload.dirty = DiffImageTiles(watched.baseline, reload.image, watched.tileSize);
+
+    if (reload.dirty.empty())
+        return;
+
+    watched.baseline = reload.image;
+
+    std::lock_guard<std::mutex> lock(resultMutex);
+    imageResults.push_back(std::move(reload));
+}
+
+bool HotReloader::TakeLevel(LevelReload& out)
+{
+    std::unique_lock<std::mutex> lock(resultMutex, std::try_to_lock);
+    if (!lock.owns_lock() || levelResults.empty())
+        return false;
+
+    // only the newest level matters, but the dirty chunks of all of them do
+    out = std::move(levelResults.back());
+    for (size_t i = 0; i + 1 < levelResults.size(); i++)
+    {
+        out.resized = out.resized || levelResults[i].resized;
+        out.dirty.insert(out.dirty.end(), levelResults[i].dirty.begin(), levelResults[i].dirty.end());
+    }
+    if (out.resized)
+        out.dirty.assign(1, TileRect{0, 0, out.level.width, out.level.height});
+    levelResults.clear();
+    return true;
+}
+
+bool HotReloader::TakeImage(ImageReload& out)
+{
+    std::unique_lock<std::mutex> lock(resultMutex, std::try_to_lock);
+    if (!lock.owns_lock() || imageResults.empty())
+        return false;
+
+    out = std::move(imageResults.front());
+    imageResults.erase(imageResults.begin());
+    return true;
+}
+
+std::vector<TileRect> DiffImageTiles(const Image& current, const Image& next, int tileSize)
+{
+    std::vector<TileRect> dirty;
+    for (int ty = 0; ty < current.height; ty += tileSize)
+    {
+        for (int tx = 0; tx < current.width; tx += tileSize)
+        {
+            TileRect tile = {tx, ty, std::min(tileSize, current.width - tx), std::min(tileSize, current.height - ty)};
+            for (int y = tile.y; y < tile.y + tile.h; y++)
+            {
+                const uint8_t* a = reinterpret_cast<const uint8_t*>(current.pixels) + y * current.pitch + tile.x * 4;
+                const uint8_t* b = reinterpret_cast<const uint8_t*>(next.pixels) + y * next.pitch + tile.x * 4;
+                if (std::memcmp(a, b, tile.w * 4) != 0)
+                {
+                    dirty.push_back(tile);
+                    break;
+                }
+            }
+        }
+    }
+    return dirty;
+}
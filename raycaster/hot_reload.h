@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "asset_pack.h"
+#include "file_watcher.h"
+#include "job_system.h"
+#include "level.h"
+
+struct LevelReload
+{
+    Level level;
+    // chunks in cells, the whole level when resized
+    std::vector<TileRect> dirty;
+    bool resized = false;
+};
+
+struct ImageReload
+{
+    std::string path;
+    Image image;
+    // tiles in pixels, the whole image when the size changed
+    std::vector<TileRect> dirty;
+    bool resized = false;
+};
+
+// Reloads watched levels and images while the game runs.
+// Files are parsed/decoded and diffed against the last seen version on a job
+// thread, the main loop picks up finished reloads between frames and only has
+// to patch the dirty parts. Nothing here waits on file io.
+class HotReloader
+{
+public:
+    explicit HotReloader(JobSystem& jobs);
+    // waits for reloads which are still running
+    ~HotReloader();
+
+    // baselines are copied, diffs are made against them
+    void WatchLevel(const std::string& path, const Level& current);
+    void WatchImage(const std::string& path, const Image& current, int tileSize);
+    bool Start();
+
+    // starts background reloads for files changed since the last frame
+    void Poll();
+
+    bool TakeLevel(LevelReload& out);
+    bool TakeImage(ImageReload& out);
+
+private:
+    struct WatchedImage
+    {
+        std::string path;
+        Image baseline;
+        int tileSize;
+    };
+
+    void ReloadLevel();
+    void ReloadImage(WatchedImage& watched);
+
+    JobSystem& jobs;
+    FileWatcher watcher;
+
+    std::string levelPath;
+    Level levelBaseline;
+    std::vector<WatchedImage> images;
+
+    // a reload which is still running just gets the next change queued up
+    std::mutex busyMutex;
+    std::atomic<int> inFlight{0};
+
+    std::mutex resultMutex;
+    std::vector<LevelReload> levelResults;
+    std::vector<ImageReload> imageResults;
+};
+
+// tiles of tileSize x tileSize pixels whose content differs
+std::vector<TileRect> DiffImageTiles(const Image& current, const Image& next, int tileSize);
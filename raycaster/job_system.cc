@@ -0,0 +1,131 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(int workerCount)
+{
+    if (workerCount <= 0)
+    {
+        workerCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    }
+    workers.reserve(workerCount);
+    for (int i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void JobSystem::Submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(Job{std::move(job), nullptr});
+    }
+    jobAvailable.notify_one();
+}
+
+void JobSystem::ParallelFor(int count, int chunkSize, const std::function<void(int, int)>& fn)
+{
+    if (count <= 0)
+        return;
+
+    chunkSize = std::max(1, chunkSize);
+    int chunkCount = (count + chunkSize - 1) / chunkSize;
+    if (chunkCount == 1 || workers.empty())
+    {
+        fn(0, count);
+        return;
+    }
+
+    Batch batch;
+    batch.fn = &fn;
+    batch.count = count;
+    batch.chunkSize = chunkSize;
+    batch.chunkCount = chunkCount;
+    batch.nextChunk = 0;
+    batch.doneChunks = 0;
+    batch.activeHelpers = 0;
+
+    int helpers = std::min(chunkCount - 1, WorkerCount());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < helpers; i++)
+        {
+            jobs.push_back(Job{nullptr, &batch});
+        }
+    }
+    jobAvailable.notify_all();
+
+    // calling thread works too instead of sleeping
+    RunChunks(batch);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // helpers which were never picked up must not outlive the batch
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&batch](const Job& job) {
+        return job.batch == &batch;
+    }), jobs.end());
+    batchFinished.wait(lock, [&batch]() {
+        return batch.activeHelpers == 0 && batch.doneChunks.load() == batch.chunkCount;
+    });
+}
+
+void JobSystem::RunChunks(Batch& batch)
+{
+    for (;;)
+    {
+        int chunk = batch.nextChunk.fetch_add(1);
+        if (chunk >= batch.chunkCount)
+            break;
+
+        int begin = chunk * batch.chunkSize;
+        int end = std::min(batch.count, begin + batch.chunkSize);
+        (*batch.fn)(begin, end);
+        batch.doneChunks.fetch_add(1);
+    }
+}
+
+void JobSystem::WorkerLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty())
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            if (job.batch)
+                job.batch->activeHelpers++;
+        }
+
+        if (job.batch)
+        {
+            RunChunks(*job.batch);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job.batch->activeHelpers--;
+            }
+            batchFinished.notify_all();
+        }
+        else
+        {
+            job.task();
+        }
+    }
+}
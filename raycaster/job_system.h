@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed pool of worker threads.
+// ParallelFor splits a range into chunks which are picked up by the workers
+// and by the calling thread, the call returns once every chunk has finished.
+class JobSystem
+{
+public:
+    // workerCount <= 0 uses one worker less than hardware threads
+    explicit JobSystem(int workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    int WorkerCount() const { return static_cast<int>(workers.size()); }
+
+    // runs fn(begin, end) over [0, count) in chunks of chunkSize
+    void ParallelFor(int count, int chunkSize, const std::function<void(int, int)>& fn);
+
+    // fire and forget job, executed by the first free worker
+    void Submit(std::function<void()> job);
+
+private:
+    struct Batch
+    {
+        const std::function<void(int, int)>* fn;
+        int count;
+        int chunkSize;
+        int chunkCount;
+        std::atomic<int> nextChunk;
+        std::atomic<int> doneChunks;
+        int activeHelpers;
+    };
+
+    struct Job
+    {
+        std::function<void()> task;
+        Batch* batch;
+    };
+
+    void WorkerLoop();
+    void RunChunks(Batch& batch);
+
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable batchFinished;
+    bool stopping = false;
+};
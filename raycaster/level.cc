@@ -0,0 +1,167 @@
+#include "level.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+void Level::Resize(int w, int h)
+{
+    width = w;
+    height = h;
+    walls.assign(size_t(w) * h, 0);
+    floors.assign(size_t(w) * h, 0);
+    ceils.assign(size_t(w) * h, 0);
+    heights.assign(size_t(w) * h, 0);
+    SyncOccupancy();
+}
+
+void Level::SetKind(int tile, TileKind kind)
+{
+    if (tile < 0)
+        return;
+    if (tile >= int(tileKinds.size()))
+        tileKinds.resize(tile + 1, TileKind::Opaque);
+    tileKinds[tile] = kind;
+}
+
+static bool ReadLayer(std::istream& in, std::vector<int>& layer)
+{
+    for (int& cell : layer)
+    {
+        if (!(in >> cell))
+            return false;
+    }
+    return true;
+}
+
+bool LoadLevel(const std::string& path, Level& out)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+
+    // strip comments first so the layers can be read as one number stream
+    std::stringstream content;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line[0] == '#')
+            continue;
+        content << line << '\n';
+    }
+
+    Level level;
+    bool hasWalls = false;
+    std::string token;
+    while (content >> token)
+    {
+        if (token == "size")
+        {
+            int w = 0, h = 0;
+            if (!(content >> w >> h) || w <= 0 || h <= 0)
+                return false;
+            level.Resize(w, h);
+        }
+        else if (level.width == 0)
+        {
+            return false;
+        }
+        else if (token == "walls")
+        {
+            if (!ReadLayer(content, level.walls))
+                return false;
+            hasWalls = true;
+        }
+        else if (token == "floors")
+        {
+            if (!ReadLayer(content, level.floors))
+                return false;
+        }
+        else if (token == "ceils")
+        {
+            if (!ReadLayer(content, level.ceils))
+                return false;
+        }
+        else if (token == "heights")
+        {
+            if (!ReadLayer(content, level.heights))
+                return false;
+        }
+        else if (token == "masked" || token == "translucent")
+        {
+            int tile = 0;
+            if (!(content >> tile) || tile <= 0)
+                return false;
+            level.SetKind(tile, token == "masked" ? TileKind::Masked : TileKind::Translucent);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (!hasWalls)
+        return false;
+
+    level.SyncOccupancy();
+    out = std::move(level);
+    return true;
+}
+
+static bool ChunkDiffers(const Level& a, const Level& b, const TileRect& chunk)
+{
+    for (int y = chunk.y; y < chunk.y + chunk.h; y++)
+    {
+        int row = y * a.width + chunk.x;
+        if (!std::equal(a.walls.begin() + row, a.walls.begin() + row + chunk.w, b.walls.begin() + row) ||
+            !std::equal(a.floors.begin() + row, a.floors.begin() + row + chunk.w, b.floors.begin() + row) ||
+            !std::equal(a.ceils.begin() + row, a.ceils.begin() + row + chunk.w, b.ceils.begin() + row) ||
+            !std::equal(a.heights.begin() + row, a.heights.begin() + row + chunk.w, b.heights.begin() + row))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void CopyChunk(Level& to, const Level& from, const TileRect& chunk)
+{
+    for (int y = chunk.y; y < chunk.y + chunk.h; y++)
+    {
+        int row = y * to.width + chunk.x;
+        std::copy(from.walls.begin() + row, from.walls.begin() + row + chunk.w, to.walls.begin() + row);
+        std::copy(from.floors.begin() + row, from.floors.begin() + row + chunk.w, to.floors.begin() + row);
+        std::copy(from.ceils.begin() + row, from.ceils.begin() + row + chunk.w, to.ceils.begin() + row);
+        std::copy(from.heights.begin() + row, from.heights.begin() + row + chunk.w, to.heights.begin() + row);
+    }
+}
+
+std::vector<TileRect> DiffLevel(const Level& current, const Level& next)
+{
+    // a kind applies to every cell of its tile
+    bool kindsDiffer = current.tileKinds != next.tileKinds;
+    std::vector<TileRect> dirty;
+    for (int cy = 0; cy < current.height; cy += LEVEL_CHUNK_SIZE)
+    {
+        for (int cx = 0; cx < current.width; cx += LEVEL_CHUNK_SIZE)
+        {
+            TileRect chunk = {
+                cx, cy,
+                std::min(LEVEL_CHUNK_SIZE, current.width - cx),
+                std::min(LEVEL_CHUNK_SIZE, current.height - cy)
+            };
+            if (kindsDiffer || ChunkDiffers(current, next, chunk))
+                dirty.push_back(chunk);
+        }
+    }
+    return dirty;
+}
+
+void CopyLevelChunks(Level& to, const Level& from, const std::vector<TileRect>& chunks)
+{
+    to.tileKinds = from.tileKinds;
+    for (const TileRect& chunk : chunks)
+    {
+        CopyChunk(to, from, chunk);
+        to.SyncOccupancy(chunk);
+    }
+}
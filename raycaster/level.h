@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "occupancy.h"
+#include "types.h"
+
+// levels are diffed and patched in square chunks of cells
+const int LEVEL_CHUNK_SIZE = 8;
+
+// wall heights are stored in steps of a full wall, 0 is a full wall
+const int WALL_HEIGHT_STEPS = 4;
+
+// how a wall tile is drawn, rays go on behind see-through tiles
+enum class TileKind : uint8_t
+{
+    Opaque,
+    Masked,      // texels are there or not, alpha tested (grates)
+    Translucent, // blended by texel alpha (glass)
+};
+
+struct TileRect
+{
+    int x, y;
+    int w, h;
+};
+
+// Tile layers of one level, all row-major with cells[y * width + x].
+// occupancy mirrors walls, whoever writes walls directly calls SyncOccupancy.
+struct Level
+{
+    int width = 0;
+    int height = 0;
+    std::vector<int> walls;
+    std::vector<int> floors;
+    std::vector<int> ceils;
+    std::vector<int> heights;
+    // by tile id, tiles past the end are opaque. See-through walls still block movement.
+    std::vector<TileKind> tileKinds;
+    OccupancyGrid occupancy;
+
+    void Resize(int w, int h);
+    void SyncOccupancy() { occupancy.Build(GridView{walls.data(), width, height}); }
+    void SyncOccupancy(const TileRect& rect) { occupancy.Update(GridView{walls.data(), width, height}, rect.x, rect.y, rect.w, rect.h); }
+
+    bool Inside(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+
+    // outside of the level is solid wall, empty floor and ceiling
+    int Wall(int x, int y) const { return Inside(x, y) ? walls[y * width + x] : 1; }
+    // collision, from the occupancy bits
+    bool Solid(int x, int y) const { return Walls().Solid(x, y); }
+    int Floor(int x, int y) const { return Inside(x, y) ? floors[y * width + x] : 0; }
+    int Ceil(int x, int y) const { return Inside(x, y) ? ceils[y * width + x] : 0; }
+
+    // height of the wall in the cell as part of a full wall, 0 for empty cells
+    float WallHeight(int x, int y) const
+    {
+        if (!Wall(x, y))
+            return 0;
+        int steps = Inside(x, y) ? heights[y * width + x] : 0;
+        return (steps <= 0 || steps >= WALL_HEIGHT_STEPS) ? 1.f : float(steps) / WALL_HEIGHT_STEPS;
+    }
+
+    TileKind Kind(int tile) const
+    {
+        return tile >= 0 && tile < int(tileKinds.size()) ? tileKinds[tile] : TileKind::Opaque;
+    }
+    void SetKind(int tile, TileKind kind);
+
+    GridView Walls() const { return GridView{walls.data(), width, height, occupancy.View()}; }
+};
+
+// Text format:
+//   size <width> <height>
+//   walls / floors / ceils / heights followed by height rows of width numbers
+//   masked <tile> / translucent <tile> mark a wall tile see-through
+// heights and tile kinds are optional
+// lines starting with # are ignored
+bool LoadLevel(const std::string& path, Level& out);
+
+// chunks (in cells) that differ between two levels of the same size, every
+// chunk when the tile kinds differ
+std::vector<TileRect> DiffLevel(const Level& current, const Level& next);
+void CopyLevelChunks(Level& to, const Level& from, const std::vector<TileRect>& chunks);
@@ -0,0 +1,262 @@
+#include "light_map.h"
+
+#include <algorithm>
+#include <cmath>
+
+void LightMap::Reset(const GridView& gridView, int ambientLight)
+{
+    grid = gridView;
+    ambient = ambientLight;
+    width = grid.width * LIGHT_SUBDIVISION;
+    height = grid.height * LIGHT_SUBDIVISION;
+    cells.assign(size_t(width) * height, static_cast<uint8_t>(ambient));
+    visited.assign(size_t(width) * height, 0);
+    dirty.clear();
+    for (const LightSlot& slot : lights)
+    {
+        if (slot.active)
+            MarkDirty(LightArea(slot.light));
+    }
+}
+
+LightId LightMap::AddLight(const PointLight& light)
+{
+    LightId id = static_cast<LightId>(lights.size());
+    for (LightId i = 0; i < static_cast<LightId>(lights.size()); i++)
+    {
+        if (!lights[i].active)
+        {
+            id = i;
+            break;
+        }
+    }
+    if (id == static_cast<LightId>(lights.size()))
+        lights.push_back(LightSlot{light, true});
+    else
+        lights[id] = LightSlot{light, true};
+
+    MarkDirty(LightArea(light));
+    return id;
+}
+
+void LightMap::MoveLight(LightId id, float x, float y)
+{
+    PointLight& light = lights[id].light;
+    // a dark light or one staying in its cell lights exactly the same cells
+    bool sameCell = static_cast<int>(light.x * LIGHT_SUBDIVISION) == static_cast<int>(x * LIGHT_SUBDIVISION) &&
+        static_cast<int>(light.y * LIGHT_SUBDIVISION) == static_cast<int>(y * LIGHT_SUBDIVISION);
+    if (sameCell || light.intensity <= ambient)
+    {
+        light.x = x;
+        light.y = y;
+        return;
+    }
+
+    MarkDirty(LightArea(light));
+    light.x = x;
+    light.y = y;
+    MarkDirty(LightArea(light));
+}
+
+void LightMap::SetIntensity(LightId id, int intensity)
+{
+    PointLight& light = lights[id].light;
+    if (light.intensity == intensity || (light.intensity <= ambient && intensity <= ambient))
+        return;
+
+    light.intensity = intensity;
+    MarkDirty(LightArea(light));
+}
+
+void LightMap::RemoveLight(LightId id)
+{
+    lights[id].active = false;
+    MarkDirty(LightArea(lights[id].light));
+}
+
+void LightMap::OnTilesChanged(const GridView& gridView, const TileRect& tiles)
+{
+    grid = gridView;
+    Area changed = {
+        tiles.x * LIGHT_SUBDIVISION, tiles.y * LIGHT_SUBDIVISION,
+        (tiles.x + tiles.w) * LIGHT_SUBDIVISION - 1, (tiles.y + tiles.h) * LIGHT_SUBDIVISION - 1
+    };
+    // an opened tile lets light further into the area of any light that can reach it
+    for (const LightSlot& slot : lights)
+    {
+        if (!slot.active)
+            continue;
+
+        Area area = LightArea(slot.light);
+        if (Overlapping(area, changed))
+            MarkDirty(area);
+    }
+}
+
+LightMap::Area LightMap::LightArea(const PointLight& light) const
+{
+    int cx = static_cast<int>(light.x * LIGHT_SUBDIVISION);
+    int cy = static_cast<int>(light.y * LIGHT_SUBDIVISION);
+    int reach = static_cast<int>(std::ceil(light.radius * LIGHT_SUBDIVISION));
+    return Area{cx - reach, cy - reach, cx + reach, cy + reach};
+}
+
+LightMap::Area LightMap::ClipArea(Area area) const
+{
+    area.x0 = std::max(area.x0, 0);
+    area.y0 = std::max(area.y0, 0);
+    area.x1 = std::min(area.x1, width - 1);
+    area.y1 = std::min(area.y1, height - 1);
+    return area;
+}
+
+void LightMap::MarkDirty(const Area& area)
+{
+    Area clipped = ClipArea(area);
+    if (clipped.x0 <= clipped.x1 && clipped.y0 <= clipped.y1)
+        dirty.push_back(clipped);
+}
+
+bool LightMap::Overlapping(const Area& a, const Area& b)
+{
+    return a.x0 <= b.x1 && a.x1 >= b.x0 && a.y0 <= b.y1 && a.y1 >= b.y0;
+}
+
+// overlapping or sharing an edge
+bool LightMap::Touching(const Area& a, const Area& b)
+{
+    return a.x0 <= b.x1 + 1 && a.x1 + 1 >= b.x0 && a.y0 <= b.y1 + 1 && a.y1 + 1 >= b.y0;
+}
+
+bool LightMap::Solid(int lx, int ly) const
+{
+    return grid.Solid(lx / LIGHT_SUBDIVISION, ly / LIGHT_SUBDIVISION);
+}
+
+void LightMap::Update()
+{
+    lastUpdateCells = 0;
+    if (dirty.empty())
+        return;
+
+    // a light moving by a cell dirties two overlapping areas, those are
+    // merged so no cell is filled twice, areas apart from each other stay
+    // separate and the cells between them are left alone
+    bool merged = true;
+    while (merged)
+    {
+        // a grown area may touch one it was already checked against
+        merged = false;
+        for (size_t i = 0; i < dirty.size(); i++)
+        {
+            for (size_t j = i + 1; j < dirty.size();)
+            {
+                if (!Touching(dirty[i], dirty[j]))
+                {
+                    j++;
+                    continue;
+                }
+
+                dirty[i].x0 = std::min(dirty[i].x0, dirty[j].x0);
+                dirty[i].y0 = std::min(dirty[i].y0, dirty[j].y0);
+                dirty[i].x1 = std::max(dirty[i].x1, dirty[j].x1);
+                dirty[i].y1 = std::max(dirty[i].y1, dirty[j].y1);
+                dirty[j] = dirty.back();
+                dirty.pop_back();
+                merged = true;
+            }
+        }
+    }
+
+    for (const Area& dirtyArea : dirty)
+    {
+        for (int y = dirtyArea.y0; y <= dirtyArea.y1; y++)
+        {
+            std::fill(cells.begin() + y * width + dirtyArea.x0, cells.begin() + y * width + dirtyArea.x1 + 1, static_cast<uint8_t>(ambient));
+        }
+        lastUpdateCells += (dirtyArea.x1 - dirtyArea.x0 + 1) * (dirtyArea.y1 - dirtyArea.y0 + 1);
+
+        for (const LightSlot& slot : lights)
+        {
+            if (slot.active && Overlapping(LightArea(slot.light), dirtyArea))
+                Propagate(slot.light, dirtyArea);
+        }
+    }
+    dirty.clear();
+}
+
+// breadth first flood fill, every step away from the light loses the same
+// amount so the first visit of a cell is its brightest one
+void LightMap::Propagate(const PointLight& light, const Area& area)
+{
+    int cx = static_cast<int>(light.x * LIGHT_SUBDIVISION);
+    int cy = static_cast<int>(light.y * LIGHT_SUBDIVISION);
+    if (cx < 0 || cy < 0 || cx >= width || cy >= height || Solid(cx, cy) || light.intensity <= ambient)
+        return;
+
+    int reach = static_cast<int>(std::ceil(light.radius * LIGHT_SUBDIVISION));
+    float falloff = reach > 0 ? float(light.intensity) / reach : float(light.intensity);
+
+    queue.clear();
+    visitedList.clear();
+    queue.push_back(cy * width + cx);
+    visited[cy * width + cx] = 1;
+    visitedList.push_back(cy * width + cx);
+
+    // queue holds one ring after another, ring index is the step count
+    size_t ringStart = 0;
+    for (int step = 0; ringStart < queue.size() && step <= reach; step++)
+    {
+        int value = static_cast<int>(light.intensity - falloff * step);
+        if (value <= ambient)
+            break;
+
+        size_t ringEnd = queue.size();
+        for (size_t i = ringStart; i < ringEnd; i++)
+        {
+            int index = queue[i];
+            int lx = index % width;
+            int ly = index / width;
+
+            if (lx >= area.x0 && lx <= area.x1 && ly >= area.y0 && ly <= area.y1 && cells[index] < value)
+                cells[index] = static_cast<uint8_t>(value);
+
+            const int neighbours[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+            for (const auto& n : neighbours)
+            {
+                int nx = lx + n[0];
+                int ny = ly + n[1];
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                    continue;
+
+                int next = ny * width + nx;
+                if (visited[next] || Solid(nx, ny))
+                    continue;
+
+                visited[next] = 1;
+                visitedList.push_back(next);
+                queue.push_back(next);
+            }
+        }
+        ringStart = ringEnd;
+    }
+
+    for (int index : visitedList)
+    {
+        visited[index] = 0;
+    }
+}
+
+void LightMap::CopySamples(const LightMap& other)
+{
+    width = other.width;
+    height = other.height;
+    ambient = other.ambient;
+    cells = other.cells;
+}
+
+size_t LightMap::MemoryBytes() const
+{
+    return cells.capacity() + lights.capacity() * sizeof(LightSlot) + dirty.capacity() * sizeof(Area) +
+        queue.capacity() * sizeof(int) + visited.capacity() + visitedList.capacity() * sizeof(int);
+}
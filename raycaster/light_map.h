@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "level.h"
+#include "types.h"
+
+// light cells per tile side
+const int LIGHT_SUBDIVISION = 4;
+const int MAX_LIGHT = 255;
+
+typedef int LightId;
+
+struct PointLight
+{
+    float x, y;
+    int intensity;  // 0..MAX_LIGHT at the light cell
+    float radius;   // in tiles, light falls off linearly to zero over it
+};
+
+// Light map over the tile grid, LIGHT_SUBDIVISION^2 cells per tile.
+// Every light is flood filled from its cell through non-solid tiles, cells
+// keep the brightest contribution. Moving a light or changing a tile only
+// re-propagates the lights whose area overlaps the change, and only writes
+// inside the changed area. Sampling is a single byte lookup.
+class LightMap
+{
+public:
+    void Reset(const GridView& grid, int ambient);
+
+    LightId AddLight(const PointLight& light);
+    void MoveLight(LightId id, float x, float y);
+    void SetIntensity(LightId id, int intensity);
+    void RemoveLight(LightId id);
+
+    // tiles changed in the level, the grid view must already show them
+    void OnTilesChanged(const GridView& grid, const TileRect& tiles);
+
+    // re-propagates everything dirtied since the last update
+    void Update();
+
+    int Sample(float x, float y) const
+    {
+        int lx = static_cast<int>(x * LIGHT_SUBDIVISION);
+        int ly = static_cast<int>(y * LIGHT_SUBDIVISION);
+        if (lx < 0 || ly < 0 || lx >= width || ly >= height)
+            return ambient;
+        return cells[ly * width + lx];
+    }
+
+    // only what Sample reads, for drawing from while the original changes
+    void CopySamples(const LightMap& other);
+
+    // light cells re-propagated by the last Update
+    int LastUpdateCells() const { return lastUpdateCells; }
+
+    // cells, lights and the flood fill scratch
+    size_t MemoryBytes() const;
+
+private:
+    struct Area
+    {
+        int x0, y0, x1, y1; // light cells, inclusive
+    };
+
+    struct LightSlot
+    {
+        PointLight light;
+        bool active;
+    };
+
+    Area LightArea(const PointLight& light) const;
+    Area ClipArea(Area area) const;
+    void MarkDirty(const Area& area);
+    static bool Overlapping(const Area& a, const Area& b);
+    static bool Touching(const Area& a, const Area& b);
+    void Propagate(const PointLight& light, const Area& area);
+    bool Solid(int lx, int ly) const;
+
+    GridView grid = {nullptr, 0, 0};
+    int width = 0;
+    int height = 0;
+    int ambient = MAX_LIGHT;
+    std::vector<uint8_t> cells;
+
+    std::vector<LightSlot> lights;
+    std::vector<Area> dirty;
+
+    // flood fill scratch, reused between updates
+    std::vector<int> queue;
+    std::vector<uint8_t> visited;
+    std::vector<int> visitedList;
+
+    int lastUpdateCells = 0;
+};
@@ -1,8 +1,13 @@
+#include <future>
 #include <iostream>
+#include <string>
 
 #include "libs/SDL2/include/SDL.h"
 #include "SDL2wrapper/include/SDL2wrapper.h"
 
+#include "asset_loader.h"
+#include "asset_pack.h"
+
 struct vector2d
 {
     double x, y;
@@ -189,6 +194,21 @@ double DistanceToPoint(vector2f startPoint, vector2f endPoint)
     return std::sqrt(squaredDistance);
 }
 
+void DrawText(sdl2::Renderer& renderer, sdl2::Texture& glyphTexture, const GlyphAtlas& atlas, const std::string& text, int x, int y)
+{
+    for (char ch : text)
+    {
+        int index = ch - GLYPH_FIRST;
+        if (index < 0 || index >= GLYPH_COUNT)
+            continue;
+
+        const GlyphMetrics& glyph = atlas.glyphs[index];
+        if (glyph.w > 0)
+            renderer.Copy(glyphTexture, sdl2::Rect(glyph.x, glyph.y, glyph.w, glyph.h), sdl2::Rect(x, y, glyph.w, glyph.h));
+        x += glyph.advance;
+    }
+}
+
 int main(int argc, char* argv[])
 {
     InitPlayer();
@@ -216,19 +236,40 @@ int main(int argc, char* argv[])
             WINDOW_WIDTH*2, WINDOW_HEIGHT*2
         );
 
-        sdl2::Surface wolf("data/wolftextures.png");
-        sdl2::Texture wolfTextures = sdl2::CreateTexture(renderer, 
-            SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
-            wolf.Width(), wolf.Height()
-        );
-        wolfTextures.Update(std::nullopt, wolf);
+        // uploaded straight from the mapped pack, the sources are only decoded without one,
+        // on worker threads, textures are created here once everything is in memory
+        AssetPack pack;
+        pack.Open(ASSET_PACK_PATH);
+
+        Image wolf;
+        Image entity;
+        GlyphAtlas glyphs;
+        std::future<bool> wolfLoaded = std::async(std::launch::async, [&]() {
+            return LoadImageAsset(pack, "data/wolftextures.png", wolf);
+        });
+        std::future<bool> entityLoaded = std::async(std::launch::async, [&]() {
+            return LoadImageAsset(pack, "data/entity.png", entity);
+        });
+        std::future<bool> glyphsLoaded = std::async(std::launch::async, [&]() {
+            return LoadGlyphAsset(pack, "data/fonts/Vera.ttf", 20, glyphs);
+        });
+        bool assetsLoaded = wolfLoaded.get();
+        assetsLoaded = entityLoaded.get() && assetsLoaded;
+        assetsLoaded = glyphsLoaded.get() && assetsLoaded;
+        if (!assetsLoaded)
+        {
+            std::cerr << "failed to load assets: " << SDL_GetError() << std::endl;
+            return 1;
+        }
+
+        sdl2::Texture wolfTextures = CreateTexture(renderer, wolf, SDL_TEXTUREACCESS_STREAMING);
         wolfTextures.BlendMode(SDL_BLENDMODE_BLEND);
 
-        sdl2::Texture entityTexture = sdl2::CreateTexture(renderer, "data/entity.png");
+        sdl2::Texture entityTexture = CreateTexture(renderer, entity);
 
-        sdl2::Font font("data/fonts/Vera.ttf", 20);
-        sdl2::Surface text_surface = font.RenderText_Solid("00.00", {255, 255, 255});
-        sdl2::Texture text = CreateTexture(renderer, text_surface);
+        sdl2::Texture glyphTexture = CreateTexture(renderer, glyphs.image);
+        glyphTexture.BlendMode(SDL_BLENDMODE_BLEND);
+        std::string text = "00.00";
 
         int rectWidth = SCREEN_WIDTH / PLANE_WIDTH;
 
@@ -497,7 +538,7 @@ int main(int argc, char* argv[])
                 }
                 if (i == PLANE_WIDTH/2)
                 {
-                    text.Update(std::nullopt, font.RenderText_Solid(std::to_string(wall.distance), {255, 255, 255}));
+                    text = std::to_string(wall.distance);
                 }
 
                 wallX += map[wall.x][wall.y] * TILE_SIZE - TILE_SIZE; // get proper texture according on what wall on map
@@ -571,7 +612,7 @@ int main(int argc, char* argv[])
             );
             renderer.Target();
 
-            renderer.Copy(text, std::nullopt, {0, 0});
+            DrawText(renderer, glyphTexture, glyphs, text, 0, 0);
 
             renderer.Present();
         }
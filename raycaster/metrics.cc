@@ -0,0 +1,254 @@
+#include "metrics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+struct MetricDesc
+{
+    const char* name;
+    const char* help;
+};
+
+const MetricDesc METRIC_DESCS[METRIC_COUNT] = {
+    {"raycaster_rays_cast_total", "Rays cast for screen columns."},
+    {"raycaster_dda_steps_total", "Grid cells stepped through by column rays."},
+    {"raycaster_cells_hit_total", "Non-empty cells column rays entered and drew."},
+    {"raycaster_columns_drawn_total", "Screen columns drawn."},
+    {"raycaster_floor_pixels_total", "Floor and ceiling pixels drawn."},
+    {"raycaster_see_through_hits_total", "Masked and translucent walls column rays went on behind."},
+    {"raycaster_see_through_pixels_total", "Masked and translucent wall pixels blended over what is behind."},
+    {"raycaster_see_through_capped_total", "See-through walls drawn solid because the column had no room left."},
+    {"raycaster_sprites_visible_total", "Sprites drawn on screen."},
+    {"raycaster_sprites_culled_total", "Sprites skipped outside the view."},
+    {"raycaster_sprites_occluded_total", "Sprites rejected whole by the depth hierarchy."},
+    {"raycaster_draw_calls_total", "Renderer copy calls."},
+    {"raycaster_texture_uploads_total", "Streaming texture uploads."},
+    {"raycaster_frames_total", "Frames presented."},
+    {"raycaster_frames_shared_total", "Frames published to the shared memory ring."},
+    {"raycaster_frames_overwritten_total", "Ring frames replaced before the reader took them."},
+    {"raycaster_flow_updates_total", "Ticks the enemy flow field was updated in."},
+    {"raycaster_flow_cells_settled_total", "Cells settled by flow field rebuilds."},
+    {"raycaster_flow_update_us_total", "Time spent updating the flow field, in microseconds."},
+    {"raycaster_agents_tracking_total", "Enemies steered by the flow field, summed over ticks."},
+};
+
+const double FRAME_PERCENTILES[] = {.5, .9, .99};
+
+// blocks are never freed, counts of finished threads stay in the sums
+std::mutex blocksMutex;
+std::vector<std::unique_ptr<MetricBlock>> blocks;
+
+MetricBlock* RegisterBlock()
+{
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    blocks.push_back(std::make_unique<MetricBlock>());
+    return blocks.back().get();
+}
+
+void Append(std::string& out, const char* name, const char* labels, double value)
+{
+    char line[160];
+    std::snprintf(line, sizeof(line), "%s%s %.17g\n", name, labels, value);
+    out += line;
+}
+
+void AppendHeader(std::string& out, const char* name, const char* help, const char* type)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+} // namespace
+
+MetricBlock& ThreadMetrics()
+{
+    thread_local MetricBlock* block = RegisterBlock();
+    return *block;
+}
+
+void RecordFrameTime(double ms)
+{
+    int bucket = 0;
+    while (bucket < FRAME_TIME_BUCKETS - 1 && ms > FRAME_TIME_BOUNDS_MS[bucket])
+    {
+        bucket++;
+    }
+    MetricBlock& block = ThreadMetrics();
+    AddRelaxed(block.frameBuckets[bucket], 1);
+    AddRelaxed(block.frameTimeUs, static_cast<uint64_t>(ms * 1000));
+}
+
+MetricsSnapshot ReadMetrics()
+{
+    MetricsSnapshot snapshot = {};
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    for (const std::unique_ptr<MetricBlock>& block : blocks)
+    {
+        for (int i = 0; i < METRIC_COUNT; i++)
+        {
+            snapshot.values[i] += block->values[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < FRAME_TIME_BUCKETS; i++)
+        {
+            snapshot.frameBuckets[i] += block->frameBuckets[i].load(std::memory_order_relaxed);
+        }
+        snapshot.frameTimeUs += block->frameTimeUs.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+double FrameTimePercentile(const MetricsSnapshot& now, const MetricsSnapshot& before, double q)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < FRAME_TIME_BUCKETS; i++)
+    {
+        total += now.frameBuckets[i] - before.frameBuckets[i];
+    }
+    if (total == 0)
+        return 0;
+
+    double rank = q * total;
+    uint64_t below = 0;
+    for (int i = 0; i < FRAME_TIME_BUCKETS; i++)
+    {
+        uint64_t count = now.frameBuckets[i] - before.frameBuckets[i];
+        if (count > 0 && below + count >= rank)
+        {
+            // the open last bucket reports its lower bound
+            double lower = i > 0 ? FRAME_TIME_BOUNDS_MS[i - 1] : 0;
+            if (i == FRAME_TIME_BUCKETS - 1)
+                return lower;
+            double upper = FRAME_TIME_BOUNDS_MS[i];
+            return lower + (upper - lower) * (rank - below) / count;
+        }
+        below += count;
+    }
+    return FRAME_TIME_BOUNDS_MS[FRAME_TIME_BUCKETS - 2];
+}
+
+std::string FormatMetrics(const MetricsSnapshot& now, const MetricsSnapshot& before)
+{
+    std::string out;
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        AppendHeader(out, METRIC_DESCS[i].name, METRIC_DESCS[i].help, "counter");
+        Append(out, METRIC_DESCS[i].name, "", double(now.values[i]));
+    }
+
+    uint64_t rays = now[Metric::RaysCast];
+    AppendHeader(out, "raycaster_dda_steps_per_ray", "Average grid cells stepped through per column ray.", "gauge");
+    Append(out, "raycaster_dda_steps_per_ray", "", rays > 0 ? double(now[Metric::DdaSteps]) / rays : 0);
+
+    // what see-through walls add to a frame, per frame since before
+    uint64_t frames = now[Metric::Frames] - before[Metric::Frames];
+    AppendHeader(out, "raycaster_see_through_hits_per_frame", "Recent masked and translucent wall hits per frame.", "gauge");
+    Append(out, "raycaster_see_through_hits_per_frame", "",
+        frames > 0 ? double(now[Metric::SeeThroughHits] - before[Metric::SeeThroughHits]) / frames : 0);
+
+    // flow field cost and the agents it served, per tick since before
+    uint64_t flowTicks = now[Metric::FlowUpdates] - before[Metric::FlowUpdates];
+    AppendHeader(out, "raycaster_flow_update_us_per_tick", "Recent flow field update time per tick, in microseconds.", "gauge");
+    Append(out, "raycaster_flow_update_us_per_tick", "",
+        flowTicks > 0 ? double(now[Metric::FlowUpdateUs] - before[Metric::FlowUpdateUs]) / flowTicks : 0);
+    AppendHeader(out, "raycaster_agents_tracking_per_tick", "Recent enemies steered by the flow field per tick.", "gauge");
+    Append(out, "raycaster_agents_tracking_per_tick", "",
+        flowTicks > 0 ? double(now[Metric::AgentsTracking] - before[Metric::AgentsTracking]) / flowTicks : 0);
+
+    const char* histogram = "raycaster_frame_time_ms";
+    AppendHeader(out, histogram, "Frame time in milliseconds.", "histogram");
+    uint64_t cumulative = 0;
+    for (int i = 0; i < FRAME_TIME_BUCKETS; i++)
+    {
+        cumulative += now.frameBuckets[i];
+        char labels[32];
+        if (i < FRAME_TIME_BUCKETS - 1)
+            std::snprintf(labels, sizeof(labels), "{le=\"%g\"}", FRAME_TIME_BOUNDS_MS[i]);
+        else
+            std::snprintf(labels, sizeof(labels), "{le=\"+Inf\"}");
+        Append(out, "raycaster_frame_time_ms_bucket", labels, double(cumulative));
+    }
+    Append(out, "raycaster_frame_time_ms_sum", "", now.frameTimeUs / 1000.);
+    Append(out, "raycaster_frame_time_ms_count", "", double(cumulative));
+
+    const char* recent = "raycaster_frame_time_ms_recent";
+    AppendHeader(out, recent, "Frame time percentiles since the previous export.", "gauge");
+    for (double q : FRAME_PERCENTILES)
+    {
+        char labels[32];
+        std::snprintf(labels, sizeof(labels), "{quantile=\"%g\"}", q);
+        Append(out, recent, labels, FrameTimePercentile(now, before, q));
+    }
+    return out;
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    Stop();
+}
+
+void MetricsExporter::Start(const std::string& path, int intervalMs)
+{
+    this->path = path;
+    this->intervalMs = intervalMs;
+    stopping = false;
+    thread = std::thread([this]() { ExportLoop(); });
+}
+
+void MetricsExporter::Stop()
+{
+    if (!thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+void MetricsExporter::ExportLoop()
+{
+    MetricsSnapshot before = ReadMetrics();
+    bool done = false;
+    while (!done)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done = wake.wait_for(lock, std::chrono::milliseconds(intervalMs), [this]() { return stopping; });
+        }
+        MetricsSnapshot now = ReadMetrics();
+        Write(now, before);
+        before = now;
+    }
+}
+
+bool MetricsExporter::Write(const MetricsSnapshot& now, const MetricsSnapshot& before)
+{
+    std::string text = FormatMetrics(now, before);
+    std::string tempPath = path + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "w");
+    if (!file)
+        return false;
+    bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    written = std::fclose(file) == 0 && written;
+    if (!written)
+        return false;
+
+    // replaces the old file in one step, scrapers see one or the other
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    return !error;
+}
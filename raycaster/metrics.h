@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Always-on runtime counters.
+// Every thread counts into its own block of relaxed atomics which only that
+// thread writes, so counting is an uncontended load and store. Readers sum
+// the blocks of every thread that ever counted, a block outlives its thread.
+// Hot loops should add up locally and count once per column or frame.
+
+enum class Metric : int
+{
+    RaysCast,
+    DdaSteps,       // cells a ray stepped through
+    CellsHit,       // non-empty cells a ray entered and drew
+    ColumnsDrawn,
+    FloorPixels,    // floor and ceiling
+    SeeThroughHits,   // masked and translucent walls kept to draw over what is behind
+    SeeThroughPixels,
+    SeeThroughCapped, // see-through walls drawn solid past MAX_SEE_THROUGH_HITS
+    SpritesVisible,
+    SpritesCulled,
+    SpritesOccluded, // on screen but behind walls, rejected as a whole
+    DrawCalls,
+    TextureUploads,
+    Frames,
+    FramesShared,      // published to the frame ring
+    FramesOverwritten, // replaced in the frame ring before its reader took them
+    FlowUpdates,       // simulation ticks the flow field was updated in
+    FlowCellsSettled,
+    FlowUpdateUs,
+    AgentsTracking,    // enemies steered by the flow field, summed over ticks
+    Count
+};
+
+const int METRIC_COUNT = static_cast<int>(Metric::Count);
+
+// frame time histogram, upper bounds in ms, the last bucket takes the rest
+const float FRAME_TIME_BOUNDS_MS[] = {1, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 25, 33, 50, 66, 100, 200};
+const int FRAME_TIME_BUCKETS = sizeof(FRAME_TIME_BOUNDS_MS) / sizeof(FRAME_TIME_BOUNDS_MS[0]) + 1;
+
+struct MetricBlock
+{
+    std::atomic<uint64_t> values[METRIC_COUNT] = {};
+    std::atomic<uint64_t> frameBuckets[FRAME_TIME_BUCKETS] = {};
+    std::atomic<uint64_t> frameTimeUs{0};
+};
+
+// the calling thread's block, registered on first use
+MetricBlock& ThreadMetrics();
+
+inline void AddRelaxed(std::atomic<uint64_t>& value, uint64_t n)
+{
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void CountMetric(Metric metric, uint64_t n = 1)
+{
+    AddRelaxed(ThreadMetrics().values[static_cast<int>(metric)], n);
+}
+
+void RecordFrameTime(double ms);
+
+// sums over every thread, may be a little behind what is being counted
+struct MetricsSnapshot
+{
+    uint64_t values[METRIC_COUNT];
+    uint64_t frameBuckets[FRAME_TIME_BUCKETS];
+    uint64_t frameTimeUs;
+
+    uint64_t operator[](Metric metric) const { return values[static_cast<int>(metric)]; }
+};
+
+MetricsSnapshot ReadMetrics();
+
+// q in [0, 1] of the frames between two snapshots, interpolated in the bucket
+double FrameTimePercentile(const MetricsSnapshot& now, const MetricsSnapshot& before, double q);
+
+// Prometheus text exposition format. Percentiles cover the frames since before.
+std::string FormatMetrics(const MetricsSnapshot& now, const MetricsSnapshot& before);
+
+// Rewrites a file in the text format every interval from its own thread, for
+// a local collector to scrape. The file is replaced whole, never seen half written.
+class MetricsExporter
+{
+public:
+    MetricsExporter() = default;
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    void Start(const std::string& path, int intervalMs);
+    // writes a last time and stops
+    void Stop();
+
+private:
+    void ExportLoop();
+    bool Write(const MetricsSnapshot& now, const MetricsSnapshot& before);
+
+    std::string path;
+    int intervalMs = 1000;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
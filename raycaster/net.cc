@@ -0,0 +1,183 @@
+#include "net.h"
+
+#include <cstdio>
+#include <mutex>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+typedef SOCKET NativeSocket;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int NativeSocket;
+#endif
+
+namespace
+{
+
+NativeSocket Native(intptr_t handle)
+{
+    return static_cast<NativeSocket>(handle);
+}
+
+#ifdef _WIN32
+// winsock is started with the first socket and left running until exit
+bool StartNetworking()
+{
+    static std::once_flag once;
+    static bool started = false;
+    std::call_once(once, []() {
+        WSADATA data;
+        started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    });
+    return started;
+}
+
+void CloseSocket(intptr_t handle)
+{
+    closesocket(Native(handle));
+}
+
+bool SetNonBlocking(intptr_t handle)
+{
+    u_long nonBlocking = 1;
+    return ioctlsocket(Native(handle), FIONBIO, &nonBlocking) == 0;
+}
+#else
+bool StartNetworking()
+{
+    return true;
+}
+
+void CloseSocket(intptr_t handle)
+{
+    close(Native(handle));
+}
+
+bool SetNonBlocking(intptr_t handle)
+{
+    int flags = fcntl(Native(handle), F_GETFL, 0);
+    return flags != -1 && fcntl(Native(handle), F_SETFL, flags | O_NONBLOCK) == 0;
+}
+#endif
+
+sockaddr_in ToSockaddr(const NetAddress& address)
+{
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(address.ip);
+    addr.sin_port = htons(address.port);
+    return addr;
+}
+
+} // namespace
+
+bool ParseAddress(const std::string& text, uint16_t defaultPort, NetAddress& out)
+{
+    unsigned a, b, c, d;
+    unsigned port = defaultPort;
+    int fields = std::sscanf(text.c_str(), "%u.%u.%u.%u:%u", &a, &b, &c, &d, &port);
+    if (fields < 4 || a > 255 || b > 255 || c > 255 || d > 255 || port > 65535)
+        return false;
+
+    out.ip = (a << 24) | (b << 16) | (c << 8) | d;
+    out.port = static_cast<uint16_t>(port);
+    return true;
+}
+
+std::string AddressToString(const NetAddress& address)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%u.%u.%u.%u:%u",
+        address.ip >> 24, (address.ip >> 16) & 0xFF, (address.ip >> 8) & 0xFF, address.ip & 0xFF,
+        unsigned(address.port));
+    return text;
+}
+
+UdpSocket::~UdpSocket()
+{
+    Close();
+}
+
+bool UdpSocket::Open(uint16_t port)
+{
+    Close();
+    if (!StartNetworking())
+        return false;
+
+    intptr_t s = static_cast<intptr_t>(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+#ifdef _WIN32
+    if (Native(s) == INVALID_SOCKET)
+        return false;
+#else
+    if (s < 0)
+        return false;
+#endif
+
+    sockaddr_in addr = ToSockaddr(NetAddress{INADDR_ANY, port});
+    if (bind(Native(s), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || !SetNonBlocking(s))
+    {
+        CloseSocket(s);
+        return false;
+    }
+
+    socklen_t length = sizeof(addr);
+    getsockname(Native(s), reinterpret_cast<sockaddr*>(&addr), &length);
+    boundPort = ntohs(addr.sin_port);
+    handle = s;
+    return true;
+}
+
+void UdpSocket::Close()
+{
+    if (IsOpen())
+    {
+        CloseSocket(handle);
+        handle = -1;
+    }
+}
+
+bool UdpSocket::IsOpen() const
+{
+    return handle != -1;
+}
+
+bool UdpSocket::Send(const NetAddress& to, const uint8_t* data, int size)
+{
+    if (!IsOpen())
+        return false;
+
+    sockaddr_in addr = ToSockaddr(to);
+    int sent = sendto(Native(handle), reinterpret_cast<const char*>(data), size, 0,
+        reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    if (sent != size)
+        return false;
+
+    bytesSent += size;
+    return true;
+}
+
+int UdpSocket::Receive(NetAddress& from, uint8_t* data, int capacity)
+{
+    if (!IsOpen())
+        return 0;
+
+    sockaddr_in addr = {};
+    socklen_t length = sizeof(addr);
+    int received = recvfrom(Native(handle), reinterpret_cast<char*>(data), capacity, 0,
+        reinterpret_cast<sockaddr*>(&addr), &length);
+    // would block, or an icmp error from an earlier send
+    if (received <= 0)
+        return 0;
+
+    from.ip = ntohl(addr.sin_addr.s_addr);
+    from.port = ntohs(addr.sin_port);
+    bytesReceived += received;
+    return received;
+}
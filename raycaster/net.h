@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// ipv4 address and port, both in host byte order
+struct NetAddress
+{
+    uint32_t ip = 0;
+    uint16_t port = 0;
+
+    bool operator==(const NetAddress& other) const { return ip == other.ip && port == other.port; }
+    bool operator!=(const NetAddress& other) const { return !(*this == other); }
+};
+
+// "a.b.c.d:port", the port may be left out to use defaultPort
+bool ParseAddress(const std::string& text, uint16_t defaultPort, NetAddress& out);
+std::string AddressToString(const NetAddress& address);
+
+// Non-blocking UDP socket over winsock or bsd sockets.
+class UdpSocket
+{
+public:
+    UdpSocket() = default;
+    ~UdpSocket();
+
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    // port 0 binds an ephemeral port
+    bool Open(uint16_t port);
+    void Close();
+    bool IsOpen() const;
+    uint16_t Port() const { return boundPort; }
+
+    bool Send(const NetAddress& to, const uint8_t* data, int size);
+    // size of the received datagram, 0 when nothing is waiting
+    int Receive(NetAddress& from, uint8_t* data, int capacity);
+
+    // payload bytes, headers are not counted
+    uint64_t BytesSent() const { return bytesSent; }
+    uint64_t BytesReceived() const { return bytesReceived; }
+
+private:
+    intptr_t handle = -1;
+    uint16_t boundPort = 0;
+    uint64_t bytesSent = 0;
+    uint64_t bytesReceived = 0;
+};
@@ -0,0 +1,38 @@
+#include "occupancy.h"
+
+#include <algorithm>
+
+void OccupancyGrid::Build(const GridView& grid)
+{
+    width = grid.width;
+    height = grid.height;
+    superBlocksX = (width + OCCUPANCY_SUPER_CELLS - 1) / OCCUPANCY_SUPER_CELLS;
+    int superBlocksY = (height + OCCUPANCY_SUPER_CELLS - 1) / OCCUPANCY_SUPER_CELLS;
+    blocks.assign(size_t(superBlocksX) * superBlocksY * 64, 0);
+    Update(grid, 0, 0, width, height);
+}
+
+void OccupancyGrid::Update(const GridView& grid, int x, int y, int w, int h)
+{
+    if (grid.width != width || grid.height != height)
+    {
+        Build(grid);
+        return;
+    }
+
+    int x1 = std::min(x + w, width);
+    int y1 = std::min(y + h, height);
+    OccupancyView view = View();
+    for (int cy = std::max(y, 0); cy < y1; cy++)
+    {
+        for (int cx = std::max(x, 0); cx < x1; cx++)
+        {
+            uint64_t& block = blocks[view.BlockIndex(cx, cy)];
+            uint64_t bit = uint64_t(1) << ((cy & 7) * 8 + (cx & 7));
+            if (grid.cells[cy * width + cx])
+                block |= bit;
+            else
+                block &= ~bit;
+        }
+    }
+}
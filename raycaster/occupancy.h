@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+// Solid/empty bit per cell, derived from a wall layer.
+// Cells are packed 8x8 into one 64-bit block (bit (y & 7) * 8 + (x & 7)),
+// 8x8 blocks form a 64x64 cell super block stored in Morton order, super
+// blocks are row-major. A ray stays inside one 512 byte super block for up
+// to 64 cells, a 4096x4096 map is 2 MiB. See OccupancyView for lookups.
+class OccupancyGrid
+{
+public:
+    void Build(const GridView& grid);
+    // refreshes the bits of a rect of cells after the wall layer changed
+    void Update(const GridView& grid, int x, int y, int w, int h);
+
+    OccupancyView View() const { return OccupancyView{blocks.data(), superBlocksX}; }
+    size_t MemoryBytes() const { return blocks.size() * sizeof(uint64_t); }
+
+private:
+    int width = 0;
+    int height = 0;
+    int superBlocksX = 0;
+    std::vector<uint64_t> blocks;
+};
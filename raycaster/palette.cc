@@ -0,0 +1,162 @@
+#include "palette.h"
+
+#include <algorithm>
+
+namespace
+{
+
+int Channel(uint32_t color, int c)
+{
+    return (color >> (24 - c * 8)) & 0xFF;
+}
+
+// a range of texels with the channel it spreads most along
+struct ColorBox
+{
+    size_t begin;
+    size_t end;
+    int channel;
+    int range;
+};
+
+ColorBox MakeBox(const std::vector<uint32_t>& texels, size_t begin, size_t end)
+{
+    int low[3] = {255, 255, 255};
+    int high[3] = {0, 0, 0};
+    for (size_t i = begin; i < end; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            low[c] = std::min(low[c], Channel(texels[i], c));
+            high[c] = std::max(high[c], Channel(texels[i], c));
+        }
+    }
+
+    ColorBox box = {begin, end, 0, high[0] - low[0]};
+    for (int c = 1; c < 3; c++)
+    {
+        if (high[c] - low[c] > box.range)
+        {
+            box.channel = c;
+            box.range = high[c] - low[c];
+        }
+    }
+    return box;
+}
+
+int DistanceSquared(uint32_t a, uint32_t b)
+{
+    int distance = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        int d = Channel(a, c) - Channel(b, c);
+        distance += d * d;
+    }
+    return distance;
+}
+
+} // namespace
+
+void CollectOpaqueTexels(const Image& image, std::vector<uint32_t>& out)
+{
+    for (int y = 0; y < image.height; y++)
+    {
+        for (int x = 0; x < image.width; x++)
+        {
+            uint32_t texel = image.At(x, y);
+            if ((texel & 0xFF) >= 128)
+                out.push_back(texel);
+        }
+    }
+}
+
+int MedianCut(std::vector<uint32_t> texels, int count, uint32_t* out)
+{
+    if (texels.empty() || count <= 0)
+        return 0;
+
+    std::vector<ColorBox> boxes = {MakeBox(texels, 0, texels.size())};
+    while (static_cast<int>(boxes.size()) < count)
+    {
+        auto widest = std::max_element(boxes.begin(), boxes.end(),
+            [](const ColorBox& a, const ColorBox& b) { return a.range < b.range; });
+        // every box is a single colour
+        if (widest->range == 0)
+            break;
+
+        ColorBox box = *widest;
+        size_t median = box.begin + (box.end - box.begin) / 2;
+        int channel = box.channel;
+        std::nth_element(texels.begin() + box.begin, texels.begin() + median, texels.begin() + box.end,
+            [channel](uint32_t a, uint32_t b) { return Channel(a, channel) < Channel(b, channel); });
+
+        *widest = MakeBox(texels, box.begin, median);
+        boxes.push_back(MakeBox(texels, median, box.end));
+    }
+
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        uint64_t sum[3] = {0, 0, 0};
+        for (size_t t = boxes[i].begin; t < boxes[i].end; t++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                sum[c] += Channel(texels[t], c);
+            }
+        }
+        uint64_t n = boxes[i].end - boxes[i].begin;
+        out[i] = uint32_t(sum[0] / n) << 24 | uint32_t(sum[1] / n) << 16 | uint32_t(sum[2] / n) << 8 | 0xFF;
+    }
+    return static_cast<int>(boxes.size());
+}
+
+void PaletteLookup::Build(const Palette& palette)
+{
+    table.resize(32 * 32 * 32);
+    for (int r = 0; r < 32; r++)
+    {
+        for (int g = 0; g < 32; g++)
+        {
+            for (int b = 0; b < 32; b++)
+            {
+                // centre of the 5:5:5 cell
+                uint32_t color = uint32_t(r * 8 + 4) << 24 | uint32_t(g * 8 + 4) << 16 | uint32_t(b * 8 + 4) << 8;
+                int best = 0;
+                int bestDistance = DistanceSquared(color, palette.colors[0]);
+                for (int i = 1; i < PALETTE_SIZE && bestDistance > 0; i++)
+                {
+                    int distance = DistanceSquared(color, palette.colors[i]);
+                    if (distance < bestDistance)
+                    {
+                        best = i;
+                        bestDistance = distance;
+                    }
+                }
+                table[(r << 10) | (g << 5) | b] = uint8_t(best);
+            }
+        }
+    }
+}
+
+void PaletteLookup::Quantize(const uint32_t* texels, size_t count, uint8_t* out) const
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i] = Nearest(texels[i]);
+    }
+}
+
+void Colormap::Build(const Palette& palette, const PaletteLookup& lookup, int levels,
+    const std::function<uint32_t(int level, uint32_t color)>& shade)
+{
+    this->levels = levels;
+    table.resize(size_t(levels) * PALETTE_SIZE);
+    for (int level = 0; level < levels; level++)
+    {
+        uint8_t* row = table.data() + size_t(level) * PALETTE_SIZE;
+        for (int i = 0; i < PALETTE_SIZE; i++)
+        {
+            row[i] = lookup.Nearest(shade(level, palette.colors[i]));
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "asset_pack.h"
+
+// 8-bit indexed colour.
+// Textures are quantized to one shared palette when they are loaded, the
+// renderer then writes palette indices and does fog and light with a table,
+// shade[level][index], instead of per channel maths. Indices go through the
+// palette once, when the frame is presented.
+
+const int PALETTE_SIZE = 256;
+
+struct Palette
+{
+    uint32_t colors[PALETTE_SIZE]; // RGBA8888
+};
+
+// appends the texels of an image which are not transparent
+void CollectOpaqueTexels(const Image& image, std::vector<uint32_t>& out);
+
+// Median cut: the box of colours with the widest channel is split at its
+// median until there are count boxes, each box becomes its average colour.
+// Returns how many colours were written, fewer when there are fewer distinct
+// colours than asked for.
+int MedianCut(std::vector<uint32_t> texels, int count, uint32_t* out);
+
+// nearest palette entry of any colour, through a table over 5:5:5 colours
+class PaletteLookup
+{
+public:
+    void Build(const Palette& palette);
+
+    uint8_t Nearest(uint32_t color) const
+    {
+        return table[((color >> 27) << 10) | (((color >> 19) & 31) << 5) | ((color >> 11) & 31)];
+    }
+
+    void Quantize(const uint32_t* texels, size_t count, uint8_t* out) const;
+
+private:
+    std::vector<uint8_t> table;
+};
+
+// Row(level)[index] is the palette entry closest to colour index shaded to level.
+class Colormap
+{
+public:
+    // shade turns a level and an RGBA8888 colour into the shaded colour
+    void Build(const Palette& palette, const PaletteLookup& lookup, int levels,
+        const std::function<uint32_t(int level, uint32_t color)>& shade);
+
+    int Levels() const { return levels; }
+    const uint8_t* Row(int level) const { return table.data() + size_t(level) * PALETTE_SIZE; }
+
+private:
+    int levels = 0;
+    std::vector<uint8_t> table;
+};
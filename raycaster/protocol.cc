@@ -0,0 +1,288 @@
+#include "protocol.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+const double TWO_PI = 6.283185307179586;
+
+// position changes below this many steps are sent as 8 bit deltas
+const int SMALL_DELTA = 128;
+
+void WritePositionDelta(BitWriter& writer, uint16_t value, uint16_t base)
+{
+    int delta = int(value) - int(base);
+    writer.WriteBool(delta != 0);
+    if (delta == 0)
+        return;
+
+    bool small = delta >= -SMALL_DELTA && delta < SMALL_DELTA;
+    writer.WriteBool(small);
+    if (small)
+        writer.Write(uint32_t(delta + SMALL_DELTA), 8);
+    else
+        writer.Write(value, 16);
+}
+
+uint16_t ReadPositionDelta(BitReader& reader, uint16_t base)
+{
+    if (!reader.ReadBool())
+        return base;
+    if (reader.ReadBool())
+        return uint16_t(int(base) + int(reader.Read(8)) - SMALL_DELTA);
+    return uint16_t(reader.Read(16));
+}
+
+const EntityState* FindEntity(const Snapshot* snapshot, uint16_t id)
+{
+    if (!snapshot)
+        return nullptr;
+
+    auto it = std::lower_bound(snapshot->entities.begin(), snapshot->entities.end(), id,
+        [](const EntityState& entity, uint16_t value) { return entity.id < value; });
+    return it != snapshot->entities.end() && it->id == id ? &*it : nullptr;
+}
+
+void WriteHeader(BitWriter& writer, uint8_t type)
+{
+    writer.Write(type, 8);
+}
+
+bool ReadHeader(BitReader& reader, SnapshotHeader& out)
+{
+    if (reader.Read(8) != MSG_SNAPSHOT)
+        return false;
+
+    out.tick = reader.Read(32);
+    out.baseTick = reader.Read(32);
+    out.clientId = uint8_t(reader.Read(8));
+    return !reader.Overflow();
+}
+
+} // namespace
+
+BitWriter::BitWriter(uint8_t* data, int capacity)
+    : data(data), capacity(capacity)
+{
+}
+
+void BitWriter::Write(uint32_t value, int bits)
+{
+    if (bitCount + bits > uint64_t(capacity) * 8)
+    {
+        overflow = true;
+        return;
+    }
+
+    for (int i = 0; i < bits; i++)
+    {
+        size_t byte = size_t(bitCount >> 3);
+        int shift = int(bitCount & 7);
+        if (shift == 0)
+            data[byte] = 0;
+        data[byte] |= uint8_t(((value >> i) & 1) << shift);
+        bitCount++;
+    }
+}
+
+BitReader::BitReader(const uint8_t* data, int size)
+    : data(data), size(size)
+{
+}
+
+uint32_t BitReader::Read(int bits)
+{
+    if (bitCount + bits > uint64_t(size) * 8)
+    {
+        overflow = true;
+        return 0;
+    }
+
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++)
+    {
+        uint32_t bit = (data[bitCount >> 3] >> (bitCount & 7)) & 1;
+        value |= bit << i;
+        bitCount++;
+    }
+    return value;
+}
+
+uint16_t QuantizePosition(float value)
+{
+    return uint16_t(std::clamp(int(std::lround(value * POSITION_SCALE)), 0, 0xFFFF));
+}
+
+float DequantizePosition(uint16_t value)
+{
+    return value / POSITION_SCALE;
+}
+
+uint16_t QuantizeAngle(double angle)
+{
+    double turns = angle / TWO_PI;
+    turns -= std::floor(turns);
+    return uint16_t(uint32_t(std::lround(turns * 65536)) & 0xFFFF);
+}
+
+double DequantizeAngle(uint16_t angle)
+{
+    return angle * TWO_PI / 65536;
+}
+
+int WriteConnect(uint8_t* buffer, int capacity)
+{
+    BitWriter writer(buffer, capacity);
+    WriteHeader(writer, MSG_CONNECT);
+    writer.Write(PROTOCOL_VERSION, 8);
+    return writer.Overflow() ? 0 : writer.Bytes();
+}
+
+int WriteDisconnect(uint8_t* buffer, int capacity)
+{
+    BitWriter writer(buffer, capacity);
+    WriteHeader(writer, MSG_DISCONNECT);
+    return writer.Overflow() ? 0 : writer.Bytes();
+}
+
+int WriteInput(uint8_t* buffer, int capacity, const InputMessage& input)
+{
+    BitWriter writer(buffer, capacity);
+    WriteHeader(writer, MSG_INPUT);
+    writer.Write(input.sequence, 32);
+    writer.Write(input.ackTick, 32);
+    writer.Write(input.buttons, 8);
+    writer.Write(input.angle, 16);
+    return writer.Overflow() ? 0 : writer.Bytes();
+}
+
+int WriteSnapshot(uint8_t* buffer, int capacity, uint8_t clientId, const Snapshot& current, const Snapshot* baseline)
+{
+    BitWriter writer(buffer, capacity);
+    WriteHeader(writer, MSG_SNAPSHOT);
+    writer.Write(current.tick, 32);
+    writer.Write(baseline ? baseline->tick : 0, 32);
+    writer.Write(clientId, 8);
+
+    int previousId = -1;
+    for (const EntityState& entity : current.entities)
+    {
+        // every entity is preceded by a continue bit
+        writer.WriteBool(true);
+
+        // ids are sorted, runs of consecutive ids cost a single bit
+        bool next = entity.id == previousId + 1;
+        writer.WriteBool(next);
+        if (!next)
+            writer.Write(entity.id, 16);
+        previousId = entity.id;
+
+        const EntityState* base = FindEntity(baseline, entity.id);
+        if (base)
+        {
+            bool changed = entity.x != base->x || entity.y != base->y ||
+                entity.angle != base->angle || entity.frame != base->frame;
+            writer.WriteBool(changed);
+            if (!changed)
+                continue;
+
+            WritePositionDelta(writer, entity.x, base->x);
+            WritePositionDelta(writer, entity.y, base->y);
+            writer.WriteBool(entity.angle != base->angle);
+            if (entity.angle != base->angle)
+                writer.Write(entity.angle, 16);
+            writer.WriteBool(entity.frame != base->frame);
+            if (entity.frame != base->frame)
+                writer.Write(entity.frame, 8);
+        }
+        else
+        {
+            writer.Write(uint32_t(entity.kind), 2);
+            writer.Write(entity.x, 16);
+            writer.Write(entity.y, 16);
+            writer.Write(entity.angle, 16);
+            writer.Write(entity.frame, 8);
+        }
+    }
+    writer.WriteBool(false);
+
+    return writer.Overflow() ? 0 : writer.Bytes();
+}
+
+uint8_t PeekMessageType(const uint8_t* data, int size)
+{
+    return size > 0 ? data[0] : 0;
+}
+
+bool ReadInput(const uint8_t* data, int size, InputMessage& out)
+{
+    BitReader reader(data, size);
+    if (reader.Read(8) != MSG_INPUT)
+        return false;
+
+    out.sequence = reader.Read(32);
+    out.ackTick = reader.Read(32);
+    out.buttons = uint8_t(reader.Read(8));
+    out.angle = uint16_t(reader.Read(16));
+    return !reader.Overflow();
+}
+
+bool ReadSnapshotHeader(const uint8_t* data, int size, SnapshotHeader& out)
+{
+    BitReader reader(data, size);
+    return ReadHeader(reader, out);
+}
+
+bool ReadSnapshot(const uint8_t* data, int size, const Snapshot* baseline, Snapshot& out)
+{
+    BitReader reader(data, size);
+    SnapshotHeader header;
+    if (!ReadHeader(reader, header))
+        return false;
+    // a delta is useless without the snapshot it was made against
+    if (header.baseTick != 0 && (!baseline || baseline->tick != header.baseTick))
+        return false;
+    if (header.baseTick == 0)
+        baseline = nullptr;
+
+    out.tick = header.tick;
+    out.entities.clear();
+
+    int previousId = -1;
+    while (reader.ReadBool())
+    {
+        EntityState entity;
+        entity.id = reader.ReadBool() ? uint16_t(previousId + 1) : uint16_t(reader.Read(16));
+        previousId = entity.id;
+
+        const EntityState* base = FindEntity(baseline, entity.id);
+        if (base)
+        {
+            entity = *base;
+            if (reader.ReadBool())
+            {
+                entity.x = ReadPositionDelta(reader, base->x);
+                entity.y = ReadPositionDelta(reader, base->y);
+                if (reader.ReadBool())
+                    entity.angle = uint16_t(reader.Read(16));
+                if (reader.ReadBool())
+                    entity.frame = uint8_t(reader.Read(8));
+            }
+        }
+        else
+        {
+            entity.kind = EntityKind(reader.Read(2));
+            entity.x = uint16_t(reader.Read(16));
+            entity.y = uint16_t(reader.Read(16));
+            entity.angle = uint16_t(reader.Read(16));
+            entity.frame = uint8_t(reader.Read(8));
+        }
+
+        if (reader.Overflow())
+            return false;
+        out.entities.push_back(entity);
+    }
+    return !reader.Overflow();
+}
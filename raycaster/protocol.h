@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Wire format shared by the server and its clients. Every datagram starts
+// with a message type byte, the rest is a little endian bit stream.
+
+const uint8_t PROTOCOL_VERSION = 1;
+const uint16_t DEFAULT_SERVER_PORT = 27960;
+
+// the server simulates at a fixed rate
+const int SERVER_TICK_MS = 33;
+
+const int MAX_CLIENTS = 64;
+const int MAX_PACKET_SIZE = 1200;
+// nearest entities first, at most this many per snapshot so a full one fits a packet
+const int MAX_SNAPSHOT_ENTITIES = 96;
+// snapshots kept by both ends as delta baselines
+const int SNAPSHOT_HISTORY = 32;
+
+// positions are sent in 1/256 tile steps, levels can be up to 256 tiles wide
+const float POSITION_SCALE = 256;
+
+enum MessageType : uint8_t
+{
+    MSG_CONNECT = 1,
+    MSG_INPUT,
+    MSG_SNAPSHOT,
+    MSG_DISCONNECT,
+};
+
+// Writes values of up to 32 bits into a fixed buffer, writes past the end
+// are dropped and flagged.
+class BitWriter
+{
+public:
+    BitWriter(uint8_t* data, int capacity);
+
+    void Write(uint32_t value, int bits);
+    void WriteBool(bool value) { Write(value ? 1 : 0, 1); }
+
+    // bytes used so far, the last one may be partly filled
+    int Bytes() const { return int((bitCount + 7) / 8); }
+    int Bits() const { return int(bitCount); }
+    bool Overflow() const { return overflow; }
+
+private:
+    uint8_t* data;
+    int capacity;
+    uint64_t bitCount = 0;
+    bool overflow = false;
+};
+
+// Reads what BitWriter wrote, reading past the end returns zeroes and flags.
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, int size);
+
+    uint32_t Read(int bits);
+    bool ReadBool() { return Read(1) != 0; }
+
+    bool Overflow() const { return overflow; }
+
+private:
+    const uint8_t* data;
+    int size;
+    uint64_t bitCount = 0;
+    bool overflow = false;
+};
+
+enum class EntityKind : uint8_t
+{
+    Player,
+    Enemy,
+};
+
+// quantized state of one entity as it goes over the wire, an id never
+// changes its kind
+struct EntityState
+{
+    uint16_t id;
+    EntityKind kind;
+    uint16_t x, y;
+    uint16_t angle; // full turn is 65536
+    uint8_t frame;
+};
+
+// entities sorted by id
+struct Snapshot
+{
+    uint32_t tick = 0;
+    std::vector<EntityState> entities;
+};
+
+uint16_t QuantizePosition(float value);
+float DequantizePosition(uint16_t value);
+uint16_t QuantizeAngle(double angle);
+double DequantizeAngle(uint16_t angle);
+
+struct InputMessage
+{
+    uint32_t sequence;
+    uint32_t ackTick; // newest snapshot the client holds, 0 for none
+    uint8_t buttons;
+    uint16_t angle;
+};
+
+struct SnapshotHeader
+{
+    uint32_t tick;
+    uint32_t baseTick; // 0 when the snapshot is not a delta
+    uint8_t clientId;
+};
+
+int WriteConnect(uint8_t* buffer, int capacity);
+int WriteDisconnect(uint8_t* buffer, int capacity);
+int WriteInput(uint8_t* buffer, int capacity, const InputMessage& input);
+
+// Writes current as a delta against baseline (or in full without one).
+// Entities missing from current are gone, only changed fields of entities
+// present in both are sent. Returns the packet size.
+int WriteSnapshot(uint8_t* buffer, int capacity, uint8_t clientId, const Snapshot& current, const Snapshot* baseline);
+
+// the message type, 0 for an empty packet
+uint8_t PeekMessageType(const uint8_t* data, int size);
+
+bool ReadInput(const uint8_t* data, int size, InputMessage& out);
+
+// header first, the caller then looks up the baseline for baseTick
+bool ReadSnapshotHeader(const uint8_t* data, int size, SnapshotHeader& out);
+bool ReadSnapshot(const uint8_t* data, int size, const Snapshot* baseline, Snapshot& out);
@@ -0,0 +1,206 @@
+#include "ray_query.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// DDA state of RAY_LANES rays, lane l of every array belongs to ray query[l]
+struct RayLanes
+{
+    float rayX[RAY_LANES];
+    float rayY[RAY_LANES];
+    float originX[RAY_LANES];
+    float originY[RAY_LANES];
+    float deltaX[RAY_LANES]; // signed, stepX * |1 / dirX|
+    float deltaY[RAY_LANES];
+    float distance[RAY_LANES];
+    float maxDistance[RAY_LANES];
+    int mapX[RAY_LANES];
+    int mapY[RAY_LANES];
+    int stepX[RAY_LANES];
+    int stepY[RAY_LANES];
+    int lineX[RAY_LANES]; // 1 when the next grid line is on the far side of the cell
+    int lineY[RAY_LANES];
+    int side[RAY_LANES];
+    int query[RAY_LANES]; // -1 once the lane ran out of rays
+};
+
+void StartLane(RayLanes& lanes, int l, const RayQueries& queries, int q)
+{
+    float originX = queries.originX[q];
+    float originY = queries.originY[q];
+    float dirX = queries.dirX[q];
+    float dirY = queries.dirY[q];
+
+    // distances to grid lines are computed the way GridTraversal does, from
+    // the line every step, so both give the same bits
+    lanes.originX[l] = originX;
+    lanes.originY[l] = originY;
+    lanes.mapX[l] = static_cast<int>(originX);
+    lanes.mapY[l] = static_cast<int>(originY);
+    lanes.stepX[l] = dirX > 0 ? 1 : -1;
+    lanes.stepY[l] = dirY > 0 ? 1 : -1;
+    lanes.lineX[l] = dirX > 0 ? 1 : 0;
+    lanes.lineY[l] = dirY > 0 ? 1 : 0;
+    lanes.deltaX[l] = lanes.stepX[l] * ((dirX == 0) ? 1e30f : std::abs(1 / dirX));
+    lanes.deltaY[l] = lanes.stepY[l] * ((dirY == 0) ? 1e30f : std::abs(1 / dirY));
+    lanes.rayX[l] = (lanes.mapX[l] + lanes.lineX[l] - originX) * lanes.deltaX[l];
+    lanes.rayY[l] = (lanes.mapY[l] + lanes.lineY[l] - originY) * lanes.deltaY[l];
+    lanes.maxDistance[l] = queries.maxDistance[q];
+    lanes.query[l] = q;
+}
+
+void WriteResult(const RayResults& results, int index, bool hit, int x, int y, int side, float distance)
+{
+    results.hit[index] = hit ? 1 : 0;
+    if (results.cellX)
+        results.cellX[index] = x;
+    if (results.cellY)
+        results.cellY[index] = y;
+    if (results.side)
+        results.side[index] = static_cast<uint8_t>(side);
+    if (results.distance)
+        results.distance[index] = distance;
+}
+
+} // namespace
+
+void TraceRays(const GridView& grid, const RayQueries& queries, const RayResults& results, int begin, int end)
+{
+    if (begin >= end)
+        return;
+
+    // A lane which finishes takes the next query right away, so short and
+    // long rays mixed in one batch do not leave lanes idle. Lanes without a
+    // query step a copy of the first ray and are never looked at.
+    RayLanes lanes;
+    int next = begin;
+    int active = 0;
+    for (int l = 0; l < RAY_LANES; l++)
+    {
+        StartLane(lanes, l, queries, next < end ? next : begin);
+        if (next < end)
+        {
+            next++;
+            active++;
+        }
+        else
+        {
+            lanes.query[l] = -1;
+        }
+    }
+
+    while (active > 0)
+    {
+        // one DDA step on every lane
+        for (int l = 0; l < RAY_LANES; l++)
+        {
+            bool stepX = lanes.rayX[l] < lanes.rayY[l];
+            lanes.distance[l] = stepX ? lanes.rayX[l] : lanes.rayY[l];
+            lanes.mapX[l] += stepX ? lanes.stepX[l] : 0;
+            lanes.mapY[l] += stepX ? 0 : lanes.stepY[l];
+            lanes.rayX[l] = (lanes.mapX[l] + lanes.lineX[l] - lanes.originX[l]) * lanes.deltaX[l];
+            lanes.rayY[l] = (lanes.mapY[l] + lanes.lineY[l] - lanes.originY[l]) * lanes.deltaY[l];
+            lanes.side[l] = stepX ? X : Y;
+        }
+
+        for (int l = 0; l < RAY_LANES; l++)
+        {
+            int q = lanes.query[l];
+            if (q < 0)
+                continue;
+
+            int x = lanes.mapX[l];
+            int y = lanes.mapY[l];
+            bool missed = lanes.distance[l] >= lanes.maxDistance[l] || !grid.Inside(x, y);
+            bool hit = !missed && grid.Solid(x, y);
+            if (!missed && !hit)
+                continue;
+
+            WriteResult(results, q, hit, x, y, lanes.side[l], hit ? lanes.distance[l] : lanes.maxDistance[l]);
+            if (next < end)
+            {
+                StartLane(lanes, l, queries, next++);
+            }
+            else
+            {
+                lanes.query[l] = -1;
+                active--;
+            }
+        }
+    }
+}
+
+void RayBatch::Clear()
+{
+    originX.clear();
+    originY.clear();
+    dirX.clear();
+    dirY.clear();
+    maxDistance.clear();
+}
+
+void RayBatch::Reserve(int count)
+{
+    originX.reserve(count);
+    originY.reserve(count);
+    dirX.reserve(count);
+    dirY.reserve(count);
+    maxDistance.reserve(count);
+    hit.reserve(count);
+    cellX.reserve(count);
+    cellY.reserve(count);
+    side.reserve(count);
+    distance.reserve(count);
+}
+
+int RayBatch::AddRay(vector2f origin, vector2f dir, float maxDistance)
+{
+    float length = std::sqrt(dir.x * dir.x + dir.y * dir.y);
+    if (length > 0)
+    {
+        dir.x /= length;
+        dir.y /= length;
+    }
+
+    originX.push_back(origin.x);
+    originY.push_back(origin.y);
+    dirX.push_back(dir.x);
+    dirY.push_back(dir.y);
+    this->maxDistance.push_back(length > 0 ? maxDistance : 0);
+    return Size() - 1;
+}
+
+int RayBatch::AddSegment(vector2f from, vector2f to)
+{
+    vector2f dir = {to.x - from.x, to.y - from.y};
+    return AddRay(from, dir, std::sqrt(dir.x * dir.x + dir.y * dir.y));
+}
+
+RayQueries RayBatch::Queries() const
+{
+    return RayQueries{originX.data(), originY.data(), dirX.data(), dirY.data(), maxDistance.data()};
+}
+
+RayResults RayBatch::Results()
+{
+    return RayResults{hit.data(), cellX.data(), cellY.data(), side.data(), distance.data()};
+}
+
+void TraceRays(const GridView& grid, RayBatch& batch, JobSystem& jobs)
+{
+    int count = batch.Size();
+    batch.hit.resize(count);
+    batch.cellX.resize(count);
+    batch.cellY.resize(count);
+    batch.side.resize(count);
+    batch.distance.resize(count);
+
+    RayQueries queries = batch.Queries();
+    RayResults results = batch.Results();
+    jobs.ParallelFor(count, RAY_CHUNK_SIZE, [&](int begin, int end) {
+        TraceRays(grid, queries, results, begin, end);
+    });
+}
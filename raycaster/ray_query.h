@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "job_system.h"
+#include "types.h"
+
+// Batched grid ray queries for gameplay: line of sight, hitscan, sound
+// occlusion. Queries and results are separate arrays (SoA). Rays are walked
+// RAY_LANES at a time, the DDA stepping of all lanes is one branch-free loop
+// the compiler turns into SIMD, only the cell lookups are per lane.
+
+const int RAY_LANES = 8;
+const int RAY_CHUNK_SIZE = 1024;
+
+// dir has to be normalized, distances are in cells
+struct RayQueries
+{
+    const float* originX;
+    const float* originY;
+    const float* dirX;
+    const float* dirY;
+    const float* maxDistance;
+};
+
+// hit is required, the other arrays may be null when they are not needed.
+// A ray which hits nothing before maxDistance or the map edge reports
+// maxDistance. side is a TILE_SIDE.
+struct RayResults
+{
+    uint8_t* hit;
+    int* cellX;
+    int* cellY;
+    uint8_t* side;
+    float* distance;
+};
+
+// traces queries [begin, end) on the calling thread
+void TraceRays(const GridView& grid, const RayQueries& queries, const RayResults& results, int begin, int end);
+
+// Owning batch, filled once per tick and traced on the job system.
+class RayBatch
+{
+public:
+    void Clear();
+    void Reserve(int count);
+    int Size() const { return static_cast<int>(originX.size()); }
+
+    // ray from origin along dir (normalized here), returns the query index
+    int AddRay(vector2f origin, vector2f dir, float maxDistance);
+    // segment between two points, visible when it does not hit
+    int AddSegment(vector2f from, vector2f to);
+
+    RayQueries Queries() const;
+    RayResults Results();
+
+    // queries
+    std::vector<float> originX, originY;
+    std::vector<float> dirX, dirY;
+    std::vector<float> maxDistance;
+    // results, sized by the trace
+    std::vector<uint8_t> hit;
+    std::vector<int> cellX, cellY;
+    std::vector<uint8_t> side;
+    std::vector<float> distance;
+};
+
+void TraceRays(const GridView& grid, RayBatch& batch, JobSystem& jobs);
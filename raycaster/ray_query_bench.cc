@@ -0,0 +1,164 @@
+// Traces a tick's worth of gameplay rays, one GridTraversal per ray against
+// the lane batch on one thread and on the job system, reading tile ids and
+// reading occupancy bits, on a small dense map and a big open one. Checks
+// that every variant agrees.
+//   ray_query_bench [queries] [ticks]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "grid_traversal.h"
+#include "job_system.h"
+#include "occupancy.h"
+#include "ray_query.h"
+
+namespace
+{
+
+struct BenchMap
+{
+    int size;
+    float wallChance;
+    float maxDistance;
+};
+
+const BenchMap MAPS[] = {
+    {64, .2f, 24},
+    {4096, .01f, 256},
+};
+
+// border walls, random pillars inside
+std::vector<int> MakeGrid(std::mt19937& random, const BenchMap& map)
+{
+    std::uniform_real_distribution<float> chance(0, 1);
+    std::vector<int> cells(size_t(map.size) * map.size);
+    for (int y = 0; y < map.size; y++)
+    {
+        for (int x = 0; x < map.size; x++)
+        {
+            bool border = x == 0 || y == 0 || x == map.size - 1 || y == map.size - 1;
+            cells[size_t(y) * map.size + x] = border || chance(random) < map.wallChance ? 1 : 0;
+        }
+    }
+    return cells;
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int CountMismatches(const RayBatch& batch, const std::vector<uint8_t>& hit, const std::vector<float>& distance)
+{
+    int mismatches = 0;
+    for (int i = 0; i < batch.Size(); i++)
+    {
+        if (batch.hit[i] != hit[i] || batch.distance[i] != distance[i])
+            mismatches++;
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int queryCount = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int ticks = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    JobSystem jobs;
+    int mismatches = 0;
+    for (const BenchMap& map : MAPS)
+    {
+        std::mt19937 random(1234);
+        std::vector<int> cells = MakeGrid(random, map);
+        GridView tiles = {cells.data(), map.size, map.size};
+        OccupancyGrid occupancy;
+        occupancy.Build(tiles);
+        GridView bits = tiles;
+        bits.occupancy = occupancy.View();
+
+        // half line of sight segments, half hitscan rays, all from open cells
+        std::uniform_real_distribution<float> coord(1, map.size - 1.f);
+        std::uniform_real_distribution<float> angle(0, 6.2831853f);
+        RayBatch batch;
+        batch.Reserve(queryCount);
+        while (batch.Size() < queryCount)
+        {
+            vector2f from = {coord(random), coord(random)};
+            if (tiles.At(int(from.x), int(from.y)))
+                continue;
+            float a = angle(random);
+            if (batch.Size() % 2 == 0)
+                batch.AddSegment(from, {from.x + std::cos(a) * map.maxDistance * .5f, from.y + std::sin(a) * map.maxDistance * .5f});
+            else
+                batch.AddRay(from, {std::cos(a), std::sin(a)}, map.maxDistance);
+        }
+
+        // reference, one incremental walk per ray over the tile ids
+        std::vector<uint8_t> scalarHit(queryCount);
+        std::vector<float> scalarDistance(queryCount);
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < ticks; t++)
+        {
+            for (int i = 0; i < queryCount; i++)
+            {
+                GridTraversal traversal(tiles, {batch.originX[i], batch.originY[i]}, {batch.dirX[i], batch.dirY[i]}, batch.maxDistance[i]);
+                GridHit hit;
+                scalarHit[i] = traversal.Next(hit) ? 1 : 0;
+                scalarDistance[i] = scalarHit[i] ? hit.distance : batch.maxDistance[i];
+            }
+        }
+        double scalarMs = ElapsedMs(start) / ticks;
+
+        batch.hit.resize(queryCount);
+        batch.cellX.resize(queryCount);
+        batch.cellY.resize(queryCount);
+        batch.side.resize(queryCount);
+        batch.distance.resize(queryCount);
+
+        start = std::chrono::steady_clock::now();
+        for (int t = 0; t < ticks; t++)
+        {
+            TraceRays(tiles, batch.Queries(), batch.Results(), 0, queryCount);
+        }
+        double lanesMs = ElapsedMs(start) / ticks;
+        mismatches += CountMismatches(batch, scalarHit, scalarDistance);
+
+        start = std::chrono::steady_clock::now();
+        for (int t = 0; t < ticks; t++)
+        {
+            TraceRays(bits, batch.Queries(), batch.Results(), 0, queryCount);
+        }
+        double bitsMs = ElapsedMs(start) / ticks;
+        mismatches += CountMismatches(batch, scalarHit, scalarDistance);
+
+        start = std::chrono::steady_clock::now();
+        for (int t = 0; t < ticks; t++)
+        {
+            TraceRays(bits, batch, jobs);
+        }
+        double parallelMs = ElapsedMs(start) / ticks;
+        mismatches += CountMismatches(batch, scalarHit, scalarDistance);
+
+        int hits = 0;
+        for (uint8_t hit : batch.hit)
+        {
+            hits += hit;
+        }
+
+        std::printf("%dx%d map, %d queries, %d hit, tile ids %.1f MiB, occupancy %.1f MiB\n", map.size, map.size,
+            queryCount, hits, cells.size() * sizeof(int) / 1048576., occupancy.MemoryBytes() / 1048576.);
+        std::printf("  %-28s %10.3f ms\n", "GridTraversal per ray", scalarMs);
+        std::printf("  %-28s %10.3f ms\n", "lanes, tile ids", lanesMs);
+        std::printf("  %-28s %10.3f ms\n", "lanes, occupancy", bitsMs);
+        std::printf("  %-28s %10.3f ms  (%d workers)\n", "lanes, occupancy, job system", parallelMs, jobs.WorkerCount());
+    }
+
+    std::printf("%d mismatches\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -2,85 +2,64 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <future>
+#include <string>
+#include <chrono>
+#include <cstdlib>
 
 
 #include "SDL2/include/SDL.h"
 #include "SDL2wrapper/include/SDL2wrapper.h"
 
+#include "asset_loader.h"
+#include "asset_pack.h"
+#include "demo.h"
+#include "entities.h"
+#include "flow_field.h"
+#include "frame_pipeline.h"
+#include "frame_ring.h"
+#include "framebuffer.h"
+#include "game_client.h"
+#include "hot_reload.h"
+#include "job_system.h"
+#include "level.h"
+#include "light_map.h"
+#include "metrics.h"
+#include "net.h"
+#include "palette.h"
+#include "protocol.h"
+#include "simulation.h"
+#include "types.h"
+#include "virtual_texture.h"
+#include "world_renderer.h"
+#include "world_session.h"
 
-struct vector2d
-{
-    double x, y;
-};
-
-struct vector2f 
-{
-    float x, y;
-};
-
-struct Sprite
-{
-    float x, y;
-    int texture;
-};
-
-enum TILE_SIDE
-{
-    X, Y
-};
-
-struct Intersection
-{
-    int x, y;
-    double fx, fy;
-    double distance;
-    TILE_SIDE side;
-    float rayDistance;
-};
-
-struct Player
-{
-    vector2f pos;
-    double angle;
-    int fov;
-};
-
-const float PI = 3.1415;
 
 // Screen and plane constants
 const int SCREEN_WIDTH = 1280;
 const int SCREEN_HEIGHT = 720;
 
-const int PLANE_WIDTH = 200;
-const int PLANE_HEIGHT = 112;
-
 const int HALF_PLANE_WIDTH = PLANE_WIDTH/2;
 
-const int TILE_SIZE = 64;
-
-const int PLAYER_FOV = 60;
 const int PLAYER_HEIGHT = 32;
 
-const int DISTANCE_TO_PLANE = PLANE_WIDTH / 2;
-
-constexpr int MAP_TEXTURE_WIDTH = SCREEN_WIDTH * 2;
-constexpr int MAP_TEXTURE_HEIGHT = SCREEN_HEIGHT * 2;
-
 const int MAP_WIDTH = 16;
 const int MAP_HEIGHT = 16;
 
 // Framerate constants
 int fpsCap = 200;   // maximum framerate
-int tickRate = 120; // desired framerate
-
-const int MAX_RAY_DISTANCE = 24;
+int tickRate = 120; // simulation ticks per second
 
-const int PLAYER_SPEED = 10.;
+const char LEVEL_PATH[] = "data/level.txt";
+const char WALL_TEXTURES_PATH[] = "data/wolftextures.png";
+// baked by vtex_baker, the atlas is paged in place when it is missing
+const char VIRTUAL_TEXTURES_PATH[] = "data/textures.vt";
 
-const int MOUSE_MOTION_SPEED = 6.1;
-const int MOUSE_MOTION_MULTIPLIER = 2.5;
+// counters for a local collector to scrape, rewritten every interval
+const char METRICS_PATH[] = "raycaster.prom";
+const int METRICS_INTERVAL_MS = 1000;
 
-// World map
+// World map, built in level
 int map[MAP_HEIGHT][MAP_WIDTH] = {
     {1, 2, 1, 2, 1, 1, 1, 2, 2, 1, 2, 1, 2, 1, 2, 1},
     {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
@@ -139,179 +118,274 @@ int ceilMap[MAP_HEIGHT][MAP_WIDTH] = {
 };
 
 
-const int SPRITE_COUNT = 7;
-
-Sprite sprites[SPRITE_COUNT] = {
-    {1.5, 1.5, 1},
-    {6.5, 1.5, 1},
-    {1.5, 6.5, 1},
-    {10.5, 8.5, 1},
-    {9.5, 9.5, 1},
-    {10.5, 10.5, 1},
-    {12.5, 11.5, 1}
-};
-
-
 Player player;
 
-float DegToRad(float angle)
+// live level, starts as the built in maps above unless LEVEL_PATH exists
+Level level;
+
+Level BuiltinLevel()
 {
-    return angle * PI / 180.;
+    Level builtin;
+    builtin.Resize(MAP_WIDTH, MAP_HEIGHT);
+    for (int y = 0; y < MAP_HEIGHT; y++)
+    {
+        for (int x = 0; x < MAP_WIDTH; x++)
+        {
+            builtin.walls[y * MAP_WIDTH + x] = map[y][x];
+            builtin.floors[y * MAP_WIDTH + x] = floorMap[y][x];
+            builtin.ceils[y * MAP_WIDTH + x] = ceilMap[y][x];
+        }
+    }
+    builtin.SyncOccupancy();
+    return builtin;
 }
 
-
 void InitPlayer()
 {
-    player.pos = {2, 3};
+    player = SpawnPlayer();
+}
+
+void HandleMouseInput(int delta, SDL_Event e, PlayerInput& input)
+{
+    if (e.type == SDL_MOUSEMOTION)
+    {
+        input.angle += MouseTurn(e.motion.xrel, delta);
+    }
+}
 
-    vector2f direction = { 1., -1. };
-    player.angle = std::atan2(direction.y, direction.x);
+void HandleKeyInput(PlayerInput& input)
+{
+    const Uint8* keyStates = SDL_GetKeyboardState(nullptr);
 
-    player.fov = DegToRad(PLAYER_FOV);
+    input.buttons &= INPUT_FIRE;
+    if (keyStates[SDL_SCANCODE_W])
+        input.buttons |= INPUT_FORWARD;
+    if (keyStates[SDL_SCANCODE_S])
+        input.buttons |= INPUT_BACK;
+    if (keyStates[SDL_SCANCODE_A])
+        input.buttons |= INPUT_LEFT;
+    if (keyStates[SDL_SCANCODE_D])
+        input.buttons |= INPUT_RIGHT;
 }
 
-float depthBuffer[PLANE_WIDTH];
+int DeltaTime(int previous, int offset)
+{
+    return (clock() - previous) + offset;
+}
 
-Intersection ClosestHitPoint(double rayAngle, vector2f startPos)
+int64_t NowMs()
 {
-    Intersection i = { 0 };
-    float x = 0;
-    float y = 0;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-    for (float ray = 0; ray < MAX_RAY_DISTANCE; ray += .01)
+// other players and enemies as seen by the server, our own entity moves the camera
+void PackNetSprites(const std::vector<NetEntity>& netEntities, int clientId, std::vector<Sprite>& out)
+{
+    out.clear();
+    for (const NetEntity& entity : netEntities)
     {
-        x = startPos.x + ray * std::cos(rayAngle);
-        y = startPos.y + ray * std::sin(rayAngle);
-
-        if (map[static_cast<int>(y)][static_cast<int>(x)])
+        if (entity.kind == EntityKind::Player && entity.id == clientId)
         {
-            float dist = ray * cos(rayAngle - player.angle);
-
-            i.x = x;
-            i.y = y;
-            i.fx = x;
-            i.fy = y;
-            i.distance = dist;
-            i.rayDistance = ray;
-            break;
+            player.pos = {entity.x, entity.y};
+            continue;
         }
+        out.push_back(Sprite{entity.x, entity.y, 1, entity.frame});
     }
-    return i;
 }
 
-void HandleMouseInput(int delta, SDL_Event e)
+// median cut over every wall and sprite texel, the rest goes from black to fog
+void BuildPalette(const Image& walls, const Image& sprites, Palette& palette)
 {
-    if (e.type == SDL_MOUSEMOTION)
-    {
-        float angle = DegToRad(MOUSE_MOTION_MULTIPLIER * MOUSE_MOTION_SPEED) * (delta/1000.);
+    std::vector<uint32_t> texels;
+    CollectOpaqueTexels(walls, texels);
+    CollectOpaqueTexels(sprites, texels);
+    int count = MedianCut(std::move(texels), PALETTE_SIZE - PALETTE_FOG_RAMP, palette.colors);
 
-        if (e.motion.xrel < 0) // left
-        {
-            player.angle -= angle;
-        }
-        else if (e.motion.xrel > 0) // right
-        {
-            player.angle += angle;
-        }
+    for (int i = count; i < PALETTE_SIZE; i++)
+    {
+        int t = (i - count) * 256 / (PALETTE_SIZE - 1 - count);
+        palette.colors[i] = (uint32_t(fogRed * t >> 8) << 24) | (uint32_t(fogGreen * t >> 8) << 16) | (uint32_t(fogBlue * t >> 8) << 8) | 0xFF;
     }
 }
 
-void HandleKeyInput(int delta)
+// one fixed tick of the local game, demos record and replay exactly these
+void StepSimulation(const PlayerInput& input, int tickMs, EntityStore& enemies, FlowField& flow, JobSystem& jobs, int& flashTime)
 {
-    const Uint8* keyStates = SDL_GetKeyboardState(nullptr);
+    ApplyPlayerInput(player, input, level, tickMs);
 
-    vector2f playerDirection = {
-        static_cast<float>(cos(player.angle)), static_cast<float>(sin(player.angle))
-    };
+    flashTime = std::max(0, flashTime - tickMs);
+    if (input.buttons & INPUT_FIRE)
+        flashTime = FLASH_DURATION;
 
-    float tickSpeed = PLAYER_SPEED/2 * (delta/1000.);
+    flow.SetTarget(player.pos);
+    flow.Update(level.Walls());
 
-    if (keyStates[SDL_SCANCODE_W]) 
-    {
-        if (map[int(player.pos.y)][int(player.pos.x + playerDirection.x * tickSpeed)] == 0)
-            player.pos.x += playerDirection.x * tickSpeed;
-        if (map[int(player.pos.y + playerDirection.y * tickSpeed)][int(player.pos.x)] == 0)
-            player.pos.y += playerDirection.y * tickSpeed;
-    }
-    if (keyStates[SDL_SCANCODE_S])
-    {
-        if (map[int(player.pos.y)][int(player.pos.x - playerDirection.x * tickSpeed)] == 0)
-            player.pos.x -= playerDirection.x * tickSpeed;
-        if (map[int(player.pos.y - playerDirection.y * tickSpeed)][int(player.pos.x)] == 0)
-            player.pos.y -= playerDirection.y * tickSpeed;
-    }
-    if (keyStates[SDL_SCANCODE_A])
+    SimulationContext simulation = {level.Walls(), player.pos, tickMs, &flow};
+    UpdateEntities(enemies, simulation, jobs);
+}
+
+// pushes hot reloaded data into the live structures, only dirty parts are touched.
+// Frames in flight draw the level and the texture cache as they are, those
+// wait for the pipeline to run dry first.
+void ApplyReloads(HotReloader& reloader, VirtualTextures& textures, ImageTileSource* atlasSource, LightMap& lightMap,
+    FlowField& flow, FramePipeline& pipeline)
+{
+    reloader.Poll();
+
+    LevelReload levelReload;
+    if (reloader.TakeLevel(levelReload))
     {
-        if (map[int(player.pos.y)][int(player.pos.x + playerDirection.y * tickSpeed)] == 0 &&
-            map[int(player.pos.y - playerDirection.x * tickSpeed)][int(player.pos.x)] == 0)
+        pipeline.WaitIdle();
+        if (levelReload.resized)
         {
-            player.pos.x += playerDirection.y * tickSpeed;
-            player.pos.y -= playerDirection.x * tickSpeed;
+            level = std::move(levelReload.level);
+            lightMap.Reset(level.Walls(), LIGHT_AMBIENT);
         }
+        else
+        {
+            CopyLevelChunks(level, levelReload.level, levelReload.dirty);
+            for (const TileRect& chunk : levelReload.dirty)
+            {
+                lightMap.OnTilesChanged(level.Walls(), chunk);
+            }
+        }
+        flow.Invalidate();
     }
-    if (keyStates[SDL_SCANCODE_D])
+
+    ImageReload imageReload;
+    while (reloader.TakeImage(imageReload))
     {
-        if (map[int(player.pos.y)][int(player.pos.x - playerDirection.y * tickSpeed)] == 0 &&
-            map[int(player.pos.y + playerDirection.x * tickSpeed)][int(player.pos.x)] == 0)
+        if (imageReload.path != WALL_TEXTURES_PATH || !atlasSource)
+            continue;
+        // the page layout keeps its size, a resized atlas needs a restart
+        if (imageReload.resized)
+        {
+            std::cerr << imageReload.path << " changed size, restart to reload it" << std::endl;
+            continue;
+        }
+
+        atlasSource->SetImage(imageReload.image);
+        pipeline.WaitIdle();
+        for (const TileRect& tile : imageReload.dirty)
         {
-            player.pos.x -= playerDirection.y * tickSpeed;
-            player.pos.y += playerDirection.x * tickSpeed;
+            for (int texture : atlasSource->TexturesIn(tile.x, tile.y, tile.w, tile.h))
+            {
+                textures.Invalidate(texture);
+            }
         }
     }
 }
 
-int DeltaTime(int previous, int offset)
+// one buffer of the frame pipeline, drawn and transposed on the render thread
+// from the camera, sprites and light it was submitted with
+struct FrameSlot
 {
-    return (clock() - previous) + offset;
-}
-
-// fog variables
-bool fogEnabled = true;
-int fogMaxDistance = 12;
-float fogColorStep = 1. / fogMaxDistance;
-int fogRed = 255;
-int fogGreen = 255;
-int fogBlue = 255;
+    Player camera;
+    std::vector<Sprite> sprites;
+    LightMap lightMap;
+
+    ColumnFramebuffer frame{PLANE_WIDTH, PLANE_HEIGHT};
+    IndexedFramebuffer indexedFrame{PLANE_WIDTH, PLANE_HEIGHT};
+    std::vector<uint32_t> pixels = std::vector<uint32_t>(PLANE_WIDTH * PLANE_HEIGHT);
+    RenderScratch scratch;
+};
 
-void SetColorToFog(sdl2::Texture& tex, float distance, bool isEntity = false)
+int main(int argc, char* argv[])
 {
-    if (fogEnabled)
+    // --connect <ip[:port]>  plays on a server instead of simulating locally
+    // --record <demo>         records the input of every tick
+    // --play <demo>           replays a demo instead of reading input
+    // --uncapped              replays one tick per frame, as fast as it renders
+    // --report <csv>          writes the replayed trajectory and frame times
+    // --palette               renders 8-bit palette indices, shaded through colormaps
+    // --pipeline <depth>      frames in flight, 2 or 3 render the next frame on
+    //                         another thread while this one is presented
+    // --metrics <file>        where the counters are exported, METRICS_PATH by default
+    // --adaptive              casts coarse rays and replays coherent columns in between
+    // --fixed                 steps floors and ceilings in fixed point instead of float
+    // --frame-ring <name>     also publishes every presented frame to shared memory, see frame_reader
+    bool online = false;
+    NetAddress serverAddress;
+    std::string recordPath;
+    std::string playPath;
+    std::string reportPath;
+    bool uncapped = false;
+    bool paletteMode = false;
+    int pipelineDepth = 1;
+    std::string metricsPath = METRICS_PATH;
+    bool adaptiveColumns = false;
+    bool fixedPoint = false;
+    std::string frameRingName;
+    for (int i = 1; i < argc; i++)
     {
-        if (distance <= fogMaxDistance)
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--connect" && hasValue)
         {
-            float realColorPart = 1. - distance * fogColorStep;
-            float fogColorPart = (1. - realColorPart);
-            int realColor = realColorPart * 255;
-
-            int r = realColor + fogRed * fogColorPart;
-            int g = realColor + fogGreen * fogColorPart;
-            int b = realColor + fogBlue * fogColorPart;
-            int a = realColor;
-            tex.SetColorMod(r, g, b);
-            if (!isEntity)
-                tex.AlphaMod(a);
-            else
+            online = ParseAddress(argv[++i], DEFAULT_SERVER_PORT, serverAddress);
+            if (!online)
             {
-                if (realColor < 200)
-                    tex.AlphaMod(realColor + 50);
+                std::cerr << "bad server address " << argv[i] << std::endl;
+                return 1;
             }
         }
-        else
-        {
-            tex.SetColorMod(fogRed, fogGreen, fogBlue);
-            tex.AlphaMod(0);
-        }
+        else if (arg == "--record" && hasValue)
+            recordPath = argv[++i];
+        else if (arg == "--play" && hasValue)
+            playPath = argv[++i];
+        else if (arg == "--report" && hasValue)
+            reportPath = argv[++i];
+        else if (arg == "--uncapped")
+            uncapped = true;
+        else if (arg == "--palette")
+            paletteMode = true;
+        else if (arg == "--pipeline" && hasValue)
+            pipelineDepth = std::max(1, std::min(MAX_PIPELINE_DEPTH, std::atoi(argv[++i])));
+        else if (arg == "--metrics" && hasValue)
+            metricsPath = argv[++i];
+        else if (arg == "--adaptive")
+            adaptiveColumns = true;
+        else if (arg == "--fixed")
+            fixedPoint = true;
+        else if (arg == "--frame-ring" && hasValue)
+            frameRingName = argv[++i];
+    }
+
+    bool recording = !recordPath.empty();
+    bool replaying = !playPath.empty();
+    if (online && (recording || replaying))
+    {
+        std::cerr << "demos are local only, they cannot be used with --connect" << std::endl;
+        return 1;
     }
-}
 
-int main(int argc, char* argv[])
-{
     InitPlayer();
 
+    level = BuiltinLevel();
+    LoadLevel(LEVEL_PATH, level);
+
+    int tickMs = 1000 / tickRate;
+    DemoRecorder recorder;
+    DemoPlayer demo;
+    DemoReport report;
+    if (replaying)
+    {
+        if (!demo.Load(playPath))
+        {
+            std::cerr << "failed to load demo " << playPath << std::endl;
+            return 1;
+        }
+        if (demo.Header().levelHash != HashLevel(level))
+            std::cerr << playPath << " was recorded on a different level, playback will diverge" << std::endl;
+        player = demo.StartPlayer();
+        tickMs = demo.Header().tickMs;
+    }
+    if (recording)
+        recorder.Begin(player, level, tickMs);
+
     try
     {
         sdl2::SDL sdl(SDL_INIT_VIDEO);
-        sdl2::SDLTTF sdlttf;
         sdl2::Window window(
             "raycast", 
             SDL_WINDOWPOS_UNDEFINED, 
@@ -319,42 +393,173 @@ int main(int argc, char* argv[])
             SCREEN_WIDTH, SCREEN_HEIGHT,
             SDL_WINDOW_OPENGL
         );
-        sdl2::Renderer renderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+        // uncapped playback must not wait for vsync
+        Uint32 rendererFlags = SDL_RENDERER_ACCELERATED;
+        if (!(replaying && uncapped))
+            rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+        sdl2::Renderer renderer(window, -1, rendererFlags);
 
         sdl2::Texture screen = sdl2::CreateTexture(renderer, 
-            SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, 
+            SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, 
             PLANE_WIDTH, PLANE_HEIGHT
         );
 
-        sdl2::Texture screenMap = sdl2::CreateTexture(renderer,
-            SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
-            MAP_TEXTURE_WIDTH, MAP_TEXTURE_HEIGHT
-        );
+        // map the baked pack (or decode the source files when it is missing)
+        // on worker threads, textures are created here once everything is in memory
+        AssetPack pack;
+        pack.Open(ASSET_PACK_PATH);
+
+        Image wallImage;
+        Image enemyImage;
+        std::future<bool> wallsLoaded = std::async(std::launch::async, [&]() {
+            return LoadImageAsset(pack, WALL_TEXTURES_PATH, wallImage);
+        });
+        std::future<bool> enemyLoaded = std::async(std::launch::async, [&]() {
+            return LoadImageAsset(pack, "data/enemy.png", enemyImage);
+        });
+        bool assetsLoaded = wallsLoaded.get();
+        assetsLoaded = enemyLoaded.get() && assetsLoaded;
+        if (!assetsLoaded)
+        {
+            std::cerr << "failed to load assets: " << SDL_GetError() << std::endl;
+            return 1;
+        }
 
-        sdl2::Texture wolfTextures = sdl2::CreateTexture(renderer, "data/wolftextures.png");
-        int floorTexture = 6 * TILE_SIZE;
-        int ceilTexture = 7 * TILE_SIZE;
-        wolfTextures.BlendMode(SDL_BLENDMODE_BLEND);
+        // walls, floors and ceilings are paged in on demand, from the baked set
+        // when there is one, otherwise from the atlas which stays hot reloadable
+        VirtualTextures textures;
+        ImageTileSource* atlasSource = nullptr;
 
-        sdl2::Texture entityTexture = sdl2::CreateTexture(renderer, "data/enemy.png");
+        // one palette for everything, built from the atlas and the sprites at
+        // load time, a baked texture set is mapped to it as pages arrive
+        Palette palette;
+        PaletteLookup paletteLookup;
+        if (paletteMode)
+        {
+            BuildPalette(wallImage, enemyImage, palette);
+            paletteLookup.Build(palette);
+            colormap.Build(palette, paletteLookup, FOG_SHADES * LIGHT_SHADES, [](int level, uint32_t color) {
+                return ShadePixel(color, ShadeForLevel(level));
+            });
+            fogIndex = paletteLookup.Nearest(FogPixel());
+            textures.SetPalette(&paletteLookup);
+        }
+
+        auto bakedTextures = std::make_unique<VirtualTextureFile>();
+        if (bakedTextures->Open(VIRTUAL_TEXTURES_PATH))
+        {
+            textures.Start(std::move(bakedTextures));
+        }
+        else
+        {
+            auto atlas = std::make_unique<ImageTileSource>(wallImage, TILE_SIZE);
+            atlasSource = atlas.get();
+            textures.Start(std::move(atlas));
+        }
 
-        sdl2::Font font("data/fonts/Vera.ttf", 20);
+        SpriteSheet sprites;
+        sprites.columns = TransposeImage(enemyImage);
+        sprites.frameWidth = enemyImage.width / ENEMY_FRAME_COUNT;
+        if (paletteMode)
+        {
+            sprites.indices.resize(sprites.columns.storage.size());
+            paletteLookup.Quantize(sprites.columns.storage.data(), sprites.indices.size(), sprites.indices.data());
+        }
+        int floorTexture = 6 * TILE_SIZE;
+        int ceilTexture = 7 * TILE_SIZE;
 
         int rectWidth = PLANE_WIDTH / HALF_PLANE_WIDTH;
         
         // time variables
         int prevTime = clock();
         int offset = 0;
+        auto frameStart = std::chrono::steady_clock::now();
+        int frameCount = 0;
+
 
+        // Enemies
+        JobSystem jobs;
+        EntityStore enemies(ENTITY_CAPACITY);
+        FlowField flow;
+        SpawnEnemies(enemies, level.Walls());
 
-        // Sprites
-        std::vector<std::pair<int, float>> entities(SPRITE_COUNT);
+        GameClient client;
+        std::vector<NetEntity> netEntities;
+        if (online && !client.Connect(serverAddress, NowMs()))
+        {
+            std::cerr << "failed to open a socket for " << AddressToString(serverAddress) << std::endl;
+            return 1;
+        }
+        PlayerInput input;
+        input.angle = player.angle;
+        int64_t nextInputSend = 0;
+
+        // Sprites, storage is reserved once so packing never allocates
+        std::vector<Sprite> renderSprites;
+        renderSprites.reserve(ENTITY_CAPACITY);
+
+        // level and texture edits are picked up while running
+        HotReloader reloader(jobs);
+        reloader.WatchLevel(LEVEL_PATH, level);
+        reloader.WatchImage(WALL_TEXTURES_PATH, wallImage, TILE_SIZE);
+        reloader.Start();
+
+        LightMap lightMap;
+        lightMap.Reset(level.Walls(), LIGHT_AMBIENT);
+        for (const Torch& torch : TORCHES)
+        {
+            lightMap.AddLight(PointLight{torch.x, torch.y, TORCH_INTENSITY, TORCH_RADIUS});
+        }
+        // muzzle flash follows the player, dark until fired
+        LightId flash = lightMap.AddLight(PointLight{player.pos.x, player.pos.y, 0, FLASH_RADIUS});
+        int flashTime = 0;
+
+        // the frame is rendered on the cpu in chunks of columns across the jobs,
+        // then transposed into rows and uploaded once, the 8-bit frame goes
+        // through the palette. Pipelined, that happens on the render thread,
+        // one buffer per frame in flight
+        FrameSlot slots[MAX_PIPELINE_DEPTH];
+        for (FrameSlot& slot : slots)
+        {
+            slot.sprites.reserve(ENTITY_CAPACITY);
+            slot.scratch.entities.reserve(ENTITY_CAPACITY);
+            slot.scratch.spans.reserve(ENTITY_CAPACITY);
+            slot.scratch.columns.resize(PLANE_WIDTH);
+        }
+        auto renderFrame = [&](int index) {
+            FrameSlot& slot = slots[index];
+            // paging in and sampling never overlap, frames render one after another
+            textures.Update();
+            WorldView view{slot.camera, level, slot.lightMap, slot.sprites, adaptiveColumns, fixedPoint};
+            if (paletteMode)
+            {
+                slot.indexedFrame.Clear(fogIndex);
+                DrawWorld<Indexed>(slot.indexedFrame, textures, sprites, view, slot.scratch, &jobs);
+                TransposeToRows(slot.indexedFrame, palette.colors, slot.pixels.data(), PLANE_WIDTH * 4);
+            }
+            else
+            {
+                slot.frame.Clear(FogPixel());
+                DrawWorld<TrueColor>(slot.frame, textures, sprites, view, slot.scratch, &jobs);
+                TransposeToRows(slot.frame, slot.pixels.data(), PLANE_WIDTH * 4);
+            }
+        };
+        FramePipeline pipeline(pipelineDepth);
+
+        MetricsExporter metrics;
+        metrics.Start(metricsPath, METRICS_INTERVAL_MS);
+
+        FrameRingWriter frameRing;
+        if (!frameRingName.empty() && !frameRing.Create(frameRingName, PLANE_WIDTH, PLANE_HEIGHT))
+        {
+            std::cerr << "failed to create the frame ring " << frameRingName << std::endl;
+            return 1;
+        }
+        uint64_t framesOverwritten = 0;
 
         // stick mouse to game window
         SDL_SetRelativeMouseMode(SDL_TRUE);
 
-        float zBuffer[PLANE_WIDTH];
-
         SDL_Event e;
         bool quit = false;
         while (quit == false)
@@ -363,210 +568,166 @@ int main(int argc, char* argv[])
             int delta = DeltaTime(prevTime, offset);
             prevTime = clock();
 
-            renderer.Target(screen);
-            renderer.SetDrawColor(fogRed, fogGreen, fogBlue);
-            renderer.Clear();
+            // edits while a demo runs would make playback diverge
+            if (!recording && !replaying)
+                ApplyReloads(reloader, textures, atlasSource, lightMap, flow, pipeline);
 
-            for (int i = 0; i <= PLANE_WIDTH; i++)
+            while(SDL_PollEvent(&e))
             {
-                float angle = (player.angle - player.fov/2.) + player.fov/float(PLANE_WIDTH) * i;
-
-                Intersection wall = ClosestHitPoint(angle, player.pos);
-                zBuffer[i] = wall.distance;
-
-                // use plane width to calculate slice size 
-                // it corrects wall to be a square, not rectangle
-                int sliceSize = int(PLANE_WIDTH/ wall.distance);
-                int sliceX = i;
-                int sliceY = PLANE_HEIGHT/2 - sliceSize/2;
-
-                sdl2::Rect slice(sliceX, sliceY, 1, sliceSize);
-
-                // set texture
-                float x = wall.fx - floor(wall.fx+.5); // x and y contain (signed) fractional parts of hitx and hity,
-                float y = wall.fy - floor(wall.fy+.5); // they vary between -0.5 and +0.5, and one of them is supposed to be very close to 0
-
-                float tex = x*TILE_SIZE;
-
-                if (std::abs(y) >= std::abs(x)) // we need to determine whether we hit a "vertical" or a "horizontal" wall (w.r.t the map)
-                {
-                    tex = y*TILE_SIZE;
-                }
-
-                if (tex < 0) // do not forget x_texcoord can be negative, fix that
-                    tex += TILE_SIZE;
-                    
-
-                tex += (map[wall.y][wall.x] * TILE_SIZE) - TILE_SIZE; // get proper texture according on what wall on map
-
-                if (fogEnabled)
+                if (e.type == SDL_QUIT)
                 {
-                    SetColorToFog(wolfTextures, wall.distance);
+                    quit = true;
                 }
 
-                sdl2::Rect srcrect(static_cast<int>(tex), 0, 1, wolfTextures.Height());
-                renderer.Copy(wolfTextures, srcrect, slice);
-
-                wolfTextures.SetColorMod(255, 255, 255);
-                wolfTextures.AlphaMod(255);
-                
-                // floor casting
-                int px = slice.x;
-                for (int py = slice.y+slice.h; py <= PLANE_HEIGHT; py++)
+                if (e.type == SDL_KEYDOWN)
                 {
-                    float p = py - (PLANE_HEIGHT / 2)+1;
-                    float rowDist = (float(DISTANCE_TO_PLANE) / (p)) / cos(angle - player.angle);
-
-                    if (fogEnabled)
+                    switch(e.key.keysym.sym)
                     {
-                        SetColorToFog(wolfTextures, rowDist);
-                    }
 
-                    float floorX = (player.pos.x + cos(angle) * rowDist);
-                    float floorY = (player.pos.y + sin(angle) * rowDist);
-
-                    int cellX = static_cast<int>(floorX);
-                    int cellY = static_cast<int>(floorY);
-
-                    //std::cout << floorMap[cellX][cellY] << std::endl;
-                    
-                    int ftx = (int((TILE_SIZE * floorMap[cellY][cellX]) + TILE_SIZE * (floorX - cellX)));
-                    int fty = (int(TILE_SIZE * (floorY - cellY)));
-
-                    int ctx = (int((TILE_SIZE * ceilMap[cellY][cellX])) + TILE_SIZE * (floorX - cellX));
+                        case SDLK_q:
+                            quit = true;
+                            break;
+                        case SDLK_SPACE:
+                            input.buttons |= INPUT_FIRE;
+                            break;
+                    }
+                }
 
-                    
-                    sdl2::Rect srcf(ftx, fty, slice.w, 1);
-                    sdl2::Rect dstf(slice.x, py, slice.w, 1);
+                if (!replaying)
+                    HandleMouseInput(delta, e, input);
+            }
 
-                    int cy = PLANE_HEIGHT - py;
+            if (!replaying)
+                HandleKeyInput(input);
 
-                    sdl2::Rect srcc(ctx, fty, slice.w, 1);
-                    sdl2::Rect dstc(slice.x, cy, slice.w, 1);
+            auto frameEnd = std::chrono::steady_clock::now();
+            double frameMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+            frameStart = frameEnd;
+            frameCount++;
+            RecordFrameTime(frameMs);
 
-                    // wolfTextures.SetColorMod(128, 128, 128);
-                    renderer.Copy(wolfTextures, srcc, dstc);
-                    // wolfTextures.SetColorMod(255, 255, 255);
-                    renderer.Copy(wolfTextures, srcf, dstf);
+            if (online)
+            {
+                // turning stays local, the server sends back where we ended up
+                player.angle = input.angle;
+                if (input.buttons & INPUT_FIRE)
+                    flashTime = FLASH_DURATION;
+                if (NowMs() >= nextInputSend)
+                {
+                    client.SendInput(input);
+                    input.buttons &= ~INPUT_FIRE;
+                    nextInputSend = NowMs() + SERVER_TICK_MS;
                 }
-                wolfTextures.SetColorMod(255, 255, 255);
-                wolfTextures.AlphaMod(255);
             }
-
-            for (int i = 0; i < SPRITE_COUNT; i++)
+            else
             {
-                entities[i].first = i;
-
-                float xDist = player.pos.x - sprites[i].x;
-                float yDist = player.pos.y - sprites[i].y;
+                // fixed ticks, what is left of delta carries over to the next frame
+                int ticks = replaying && uncapped ? 1 : delta / tickMs;
+                for (int t = 0; t < ticks; t++)
+                {
+                    PlayerInput tickInput = input;
+                    if (replaying && !demo.Next(tickInput))
+                    {
+                        quit = true;
+                        break;
+                    }
+                    if (recording)
+                        recorder.Record(tickInput);
 
-                entities[i].second = sqrt((xDist*xDist) + (yDist*yDist));
+                    StepSimulation(tickInput, tickMs, enemies, flow, jobs, flashTime);
+                    input.buttons &= ~INPUT_FIRE;
 
+                    if (replaying)
+                        report.AddTick(demo.Tick(), frameCount, player, frameMs);
+                }
             }
 
-            renderer.Target(screen);
-            std::sort(entities.begin(), entities.end(), [](auto &left, auto &right){
-                return left.second > right.second;
-            });
+            // offline the flash runs down in the simulation ticks
+            if (online)
+                flashTime = std::max(0, flashTime - delta);
+            lightMap.MoveLight(flash, player.pos.x, player.pos.y);
+            lightMap.SetIntensity(flash, flashTime > 0 ? FLASH_INTENSITY * flashTime / FLASH_DURATION : 0);
+            lightMap.Update();
 
-            
-            for (int i = 0; i < SPRITE_COUNT; i++)
+            if (online)
             {
-
-                float spriteDir = atan2(sprites[entities[i].first].y - player.pos.y, sprites[entities[i].first].x - player.pos.x);
-
-                
-                while ((spriteDir - player.angle) > PI) spriteDir -= 2*PI;
-                while ((spriteDir - player.angle) < -PI) spriteDir += 2*PI;
-
-                
-                entities[i].second *= cos(spriteDir - player.angle);
-                {
-                    int spriteHeight = PLANE_WIDTH / entities[i].second;
-
-                    int spriteScreenY = (PLANE_HEIGHT/2 - spriteHeight/2);
-                    float spriteScreenX = (spriteDir - player.angle) * (float(PLANE_WIDTH) / player.fov) + float(PLANE_WIDTH/2);
-
-                    int drawStartX = spriteScreenX - spriteHeight/2;
-                    int drawEndX = drawStartX + spriteHeight;
-
-                    int texWidth = spriteHeight;
-                    float texStepX = entityTexture.Width() / static_cast<float>(texWidth);
-
-                    int texStartX = 0;
-                    int texEndX = TILE_SIZE;
-
-                    int screenStartX = drawStartX;
-                    if ((drawStartX >= 0 && drawStartX <= PLANE_WIDTH) || (drawEndX >= 0 && drawEndX <= PLANE_WIDTH))
-                    {
-                        if (fogEnabled)
-                        {
-                            SetColorToFog(entityTexture, entities[i].second, true);
-                        }
-
-                        if (drawStartX < 0)
-                        {
-                            texStartX = (0 - screenStartX) * texStepX;
-                            screenStartX = 0;
-                        }
-                        int screenEndX = drawEndX;
-                        if (drawEndX > PLANE_WIDTH)
-                        {
-                            texEndX = (drawEndX - PLANE_WIDTH) * texStepX; 
-                            screenEndX = PLANE_WIDTH;
-                        }
-
-                        if (screenStartX < PLANE_WIDTH && screenEndX <= PLANE_WIDTH)
-                            entities[i].second *= cos(spriteDir - player.angle);
-                        
-                        float texX = texStartX;
-                        for (int j = screenStartX; j < screenEndX; j++)
-                        {
-                            if (screenStartX < PLANE_WIDTH && screenEndX <= PLANE_WIDTH && zBuffer[j] > entities[i].second)
-                            {
-                                sdl2::Rect spriteSrc(texX, 0, 1, entityTexture.Height());
-                                sdl2::Rect spriteDst(j, spriteScreenY, 1, spriteHeight);
-                                renderer.Copy(entityTexture, spriteSrc, spriteDst);
-
-                            }
-                            texX += texStepX;
-                        }
-                    }
-                }
-                entityTexture.SetColorMod(255, 255, 255);
-                entityTexture.AlphaMod(255);
+                int64_t now = NowMs();
+                client.Poll(now);
+                client.Interpolate(now, netEntities);
+                PackNetSprites(netEntities, client.ClientId(), renderSprites);
+            }
+            else
+            {
+                PackRenderSprites(enemies, renderSprites, jobs);
             }
 
-            while(SDL_PollEvent(&e))
+            // the frame keeps what it is drawn from, the world may change
+            // while it renders
+            int slot = pipeline.Acquire();
+            slots[slot].camera = player;
+            slots[slot].sprites = renderSprites;
+            slots[slot].lightMap.CopySamples(lightMap);
+            pipeline.Submit(slot, renderFrame);
+
+            // pipelined, this is an older frame and the next one renders meanwhile
+            int presentSlot = pipeline.NextToPresent();
+            if (presentSlot >= 0)
             {
-                if (e.type == SDL_QUIT)
-                {
-                    quit = true;
-                }
+                screen.Update(std::nullopt, slots[presentSlot].pixels.data(), PLANE_WIDTH * 4);
+                CountMetric(Metric::TextureUploads);
 
-                if (e.type == SDL_KEYDOWN)
-                {
-                    switch(e.key.keysym.sym)
-                    {
+                renderer.Copy(screen, std::nullopt, sdl2::Rect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT), 0, std::nullopt);
+                CountMetric(Metric::DrawCalls);
 
-                        case SDLK_q:
-                            quit = true;
-                            break;
-                    }
-                }
+                renderer.Present();
+                CountMetric(Metric::Frames);
 
-                HandleMouseInput(delta, e);
+                if (frameRing.IsOpen())
+                {
+                    int64_t timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+                    frameRing.Write(slots[presentSlot].pixels.data(), PLANE_WIDTH * 4, timestampUs);
+                    uint64_t overwritten = frameRing.Stats().overwritten;
+                    CountMetric(Metric::FramesShared);
+                    CountMetric(Metric::FramesOverwritten, overwritten - framesOverwritten);
+                    framesOverwritten = overwritten;
+                }
+                pipeline.Presented(presentSlot);
             }
 
-            HandleKeyInput(delta);
+            offset = replaying && uncapped ? 0 : delta % tickMs;
+        }
 
-            renderer.Target();
+        pipeline.Flush();
+        client.Disconnect();
 
-            renderer.Copy(screen, std::nullopt, sdl2::Rect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT), 0, std::nullopt);
+        if (pipelineDepth > 1)
+        {
+            FramePipelineStats stats = pipeline.Stats();
+            std::cout << "pipeline depth " << stats.depth << ": " << stats.frames << " frames, render "
+                << stats.renderMs << " ms, main thread waited " << stats.waitMs << " ms per frame" << std::endl;
+        }
 
-            renderer.Present();
+        if (frameRing.IsOpen())
+        {
+            FrameRingStats stats = frameRing.Stats();
+            std::cout << "frame ring " << frameRingName << ": " << stats.published << " frames, "
+                << stats.overwritten << " overwritten before the reader took them" << std::endl;
+        }
 
-            offset = delta % (1000 / tickRate);
+        if (recording)
+        {
+            if (recorder.Save(recordPath, player))
+                std::cout << "recorded " << recorder.TickCount() << " ticks to " << recordPath << std::endl;
+            else
+                std::cerr << "failed to write demo " << recordPath << std::endl;
+        }
+        if (replaying)
+        {
+            std::cout << report.Summary() << std::endl;
+            std::cout << (demo.MatchesEnd(player) ? "playback matches the recording" : "playback diverged from the recording") << std::endl;
+            if (!reportPath.empty() && !report.WriteCsv(reportPath))
+                std::cerr << "failed to write report " << reportPath << std::endl;
         }
     }
     catch (sdl2::SDLException e)
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Scalar types the casting code can be instantiated with: float, double and
+// Fixed. Fixed is 16.16 fixed point with integer only arithmetic, so a walk
+// or a span computed with it gives the same bits on every machine and
+// compiler. Values come in as float or double once per ray or column, the
+// per cell and per pixel work stays in the scalar type.
+
+struct Fixed
+{
+    static const int FRACTION_BITS = 16;
+    static const int32_t ONE = 1 << FRACTION_BITS;
+
+    int32_t raw = 0;
+
+    Fixed() = default;
+    explicit Fixed(int value) : raw(Saturate(int64_t(value) * ONE)) {}
+
+    static Fixed FromRaw(int32_t raw)
+    {
+        Fixed f;
+        f.raw = raw;
+        return f;
+    }
+
+    // rounds toward zero, out of range values stick to the largest ones
+    static Fixed FromDouble(double value)
+    {
+        double scaled = value * ONE;
+        if (scaled >= double(INT32_MAX))
+            return FromRaw(INT32_MAX);
+        if (scaled <= double(INT32_MIN))
+            return FromRaw(INT32_MIN);
+        return FromRaw(int32_t(scaled));
+    }
+
+    static int32_t Saturate(int64_t value)
+    {
+        return int32_t(std::min<int64_t>(std::max<int64_t>(value, INT32_MIN), INT32_MAX));
+    }
+
+    // saturating, so a ray which never crosses a grid line ends instead of wrapping
+    Fixed operator+(Fixed other) const { return FromRaw(Saturate(int64_t(raw) + other.raw)); }
+    Fixed operator-(Fixed other) const { return FromRaw(Saturate(int64_t(raw) - other.raw)); }
+    Fixed operator-() const { return FromRaw(Saturate(-int64_t(raw))); }
+    Fixed operator*(Fixed other) const { return FromRaw(Saturate((int64_t(raw) * other.raw) >> FRACTION_BITS)); }
+    Fixed operator/(Fixed other) const
+    {
+        if (other.raw == 0)
+            return FromRaw(raw >= 0 ? INT32_MAX : INT32_MIN);
+        return FromRaw(Saturate(int64_t(raw) * ONE / other.raw));
+    }
+    // by a whole number, rounded once instead of through a converted divisor
+    Fixed operator/(int other) const
+    {
+        if (other == 0)
+            return FromRaw(raw >= 0 ? INT32_MAX : INT32_MIN);
+        return FromRaw(Saturate(int64_t(raw) / other));
+    }
+    Fixed& operator+=(Fixed other) { return *this = *this + other; }
+
+    bool operator<(Fixed other) const { return raw < other.raw; }
+    bool operator>(Fixed other) const { return raw > other.raw; }
+    bool operator<=(Fixed other) const { return raw <= other.raw; }
+    bool operator>=(Fixed other) const { return raw >= other.raw; }
+    bool operator==(Fixed other) const { return raw == other.raw; }
+    bool operator!=(Fixed other) const { return raw != other.raw; }
+};
+
+template <typename Scalar>
+struct ScalarTraits;
+
+template <>
+struct ScalarTraits<float>
+{
+    static const char* Name() { return "float"; }
+    static float From(double value) { return float(value); }
+    static float Max() { return 1e30f; }
+};
+
+template <>
+struct ScalarTraits<double>
+{
+    static const char* Name() { return "double"; }
+    static double From(double value) { return value; }
+    static double Max() { return 1e30; }
+};
+
+template <>
+struct ScalarTraits<Fixed>
+{
+    static const char* Name() { return "16.16 fixed"; }
+    static Fixed From(double value) { return Fixed::FromDouble(value); }
+    static Fixed Max() { return Fixed::FromRaw(INT32_MAX); }
+};
+
+inline float Abs(float value) { return std::abs(value); }
+inline double Abs(double value) { return std::abs(value); }
+inline Fixed Abs(Fixed value) { return value.raw < 0 ? -value : value; }
+
+// toward zero, what static_cast<int> does
+inline int ToInt(float value) { return static_cast<int>(value); }
+inline int ToInt(double value) { return static_cast<int>(value); }
+inline int ToInt(Fixed value) { return value.raw >= 0 ? value.raw >> Fixed::FRACTION_BITS : -int(-int64_t(value.raw) >> Fixed::FRACTION_BITS); }
+
+inline int FloorInt(float value) { return static_cast<int>(std::floor(value)); }
+inline int FloorInt(double value) { return static_cast<int>(std::floor(value)); }
+inline int FloorInt(Fixed value) { return value.raw >> Fixed::FRACTION_BITS; }
+
+// the part above the floor, in [0, 1)
+inline float Frac(float value) { return value - std::floor(value); }
+inline double Frac(double value) { return value - std::floor(value); }
+inline Fixed Frac(Fixed value) { return Fixed::FromRaw(value.raw & (Fixed::ONE - 1)); }
+
+inline float ToFloat(float value) { return value; }
+inline float ToFloat(double value) { return float(value); }
+inline float ToFloat(Fixed value) { return float(value.raw) / Fixed::ONE; }
+
+// texel of a coordinate in [0, 1] across size texels, clamped to the edges
+inline int TexelCoord(float u, int size) { return std::min(std::max(int(u * size), 0), size - 1); }
+inline int TexelCoord(double u, int size) { return std::min(std::max(int(u * size), 0), size - 1); }
+inline int TexelCoord(Fixed u, int size)
+{
+    return int(std::min<int64_t>(std::max<int64_t>((int64_t(u.raw) * size) >> Fixed::FRACTION_BITS, 0), size - 1));
+}
@@ -0,0 +1,308 @@
+// Casts the columns of a frame with float, double and 16.16 fixed point
+// scalars: every column walks to its first wall with BasicGridTraversal and
+// generates texel coordinates down the wall slice. Prints the time per frame
+// of each, how many texel coordinates agree with the double run and a
+// checksum over all of them. Poses and rays are set up so that they round the
+// same everywhere, the fixed point checksum is then the same on every machine
+// and compiler.
+// Then draws the same poses with DrawWorld, floors, ceilings and top faces
+// stepped in float and in fixed point, and prints the time per frame and how
+// many pixels are the ones float draws.
+//   scalar_bench [frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "framebuffer.h"
+#include "grid_traversal.h"
+#include "level.h"
+#include "light_map.h"
+#include "scalar.h"
+#include "simulation.h"
+#include "virtual_texture.h"
+#include "world_renderer.h"
+
+namespace
+{
+
+const int MAP_SIZE = 64;
+const int COLUMNS = 320;
+const int ROWS = 200;
+const int TEXTURE_SIZE = 64;
+const float MAX_DISTANCE = 24;
+// half the camera plane, about a 66 degree view
+const float PLANE_HALF_WIDTH = .66f;
+
+struct Pose
+{
+    vector2f pos;
+    vector2f dir;
+};
+
+// border walls, a fifth of the inside pillars, from raw generator output
+std::vector<int> MakeGrid(std::mt19937& random)
+{
+    std::vector<int> cells(size_t(MAP_SIZE) * MAP_SIZE);
+    for (int y = 0; y < MAP_SIZE; y++)
+    {
+        for (int x = 0; x < MAP_SIZE; x++)
+        {
+            bool border = x == 0 || y == 0 || x == MAP_SIZE - 1 || y == MAP_SIZE - 1;
+            cells[size_t(y) * MAP_SIZE + x] = border || random() % 5 == 0 ? 1 : 0;
+        }
+    }
+    return cells;
+}
+
+// std distributions differ between standard libraries, these do not
+float Unit(std::mt19937& random)
+{
+    return float(random() >> 8) / float(1 << 24);
+}
+
+// Products of floats are exact in double, so a * b + c * d rounds once
+// whether the compiler fuses it into an fma or not.
+float Length(vector2f v)
+{
+    return float(std::sqrt(double(v.x) * v.x + double(v.y) * v.y));
+}
+
+float MultiplyAdd(float a, float b, float c)
+{
+    return float(double(a) * b + c);
+}
+
+std::vector<Pose> MakePoses(std::mt19937& random, const GridView& grid, int count)
+{
+    std::vector<Pose> poses;
+    while (int(poses.size()) < count)
+    {
+        vector2f pos = {1 + Unit(random) * (MAP_SIZE - 2), 1 + Unit(random) * (MAP_SIZE - 2)};
+        vector2f dir = {Unit(random) * 2 - 1, Unit(random) * 2 - 1};
+        float length = Length(dir);
+        if (grid.Solid(int(pos.x), int(pos.y)) || length < .1f)
+            continue;
+        poses.push_back(Pose{pos, {dir.x / length, dir.y / length}});
+    }
+    return poses;
+}
+
+// pixels above the wall and columns that hit nothing
+const uint16_t NO_TEXEL = 0xFFFF;
+
+// one frame, out[column * ROWS + y] is the texel coordinate of a wall pixel
+// packed as x << 8 | y
+template <typename Scalar>
+void CastFrame(const GridView& grid, const Pose& pose, uint16_t* out)
+{
+    vector2f plane = {-pose.dir.y * PLANE_HALF_WIDTH, pose.dir.x * PLANE_HALF_WIDTH};
+    for (int column = 0; column < COLUMNS; column++, out += ROWS)
+    {
+        // ray through the camera plane, its length is 1 / cosCorrection
+        float cameraX = 2.f * column / COLUMNS - 1;
+        vector2f ray = {MultiplyAdd(plane.x, cameraX, pose.dir.x), MultiplyAdd(plane.y, cameraX, pose.dir.y)};
+        float length = Length(ray);
+
+        BasicGridTraversal<Scalar> traversal(grid, pose.pos, {ray.x / length, ray.y / length}, MAX_DISTANCE);
+        BasicGridHit<Scalar> hit;
+        if (!traversal.Next(hit))
+            continue;
+
+        // wall slice, texel column from where the ray entered
+        Scalar cosCorrection = ScalarTraits<Scalar>::From(1 / length);
+        Scalar distance = hit.distance * cosCorrection;
+        int sliceSize = std::min(ToInt(Scalar(ROWS) / distance), ROWS * 16);
+        int top = (ROWS - sliceSize) / 2;
+        int y0 = std::max(top, 0);
+        int y1 = std::min(top + sliceSize, ROWS);
+        int texX = TexelCoord(Frac(hit.side == X ? hit.hitY : hit.hitX), TEXTURE_SIZE);
+        // stepped in texels rather than in [0, 1], fixed point keeps 6 more bits
+        Scalar texelsPerRow = Scalar(TEXTURE_SIZE) / sliceSize;
+        Scalar texY = texelsPerRow * Scalar(y0 - top);
+        for (int y = y0; y < y1; y++, texY += texelsPerRow)
+        {
+            out[y] = uint16_t(texX << 8 | std::min(ToInt(texY), TEXTURE_SIZE - 1));
+        }
+    }
+}
+
+struct Run
+{
+    double ms;
+    std::vector<uint16_t> texels;
+};
+
+template <typename Scalar>
+Run Bench(const GridView& grid, const std::vector<Pose>& poses)
+{
+    Run run;
+    run.texels.assign(poses.size() * COLUMNS * ROWS, NO_TEXEL);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+        CastFrame<Scalar>(grid, poses[i], run.texels.data() + i * COLUMNS * ROWS);
+    }
+    run.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / poses.size();
+    return run;
+}
+
+uint32_t Checksum(const std::vector<uint16_t>& texels)
+{
+    uint32_t hash = 2166136261u;
+    for (uint16_t texel : texels)
+    {
+        hash = (hash ^ texel) * 16777619u;
+    }
+    return hash;
+}
+
+// pixels with the same texel as the reference, of those either one drew
+double Agreement(const std::vector<uint16_t>& texels, const std::vector<uint16_t>& reference)
+{
+    size_t same = 0;
+    size_t drawn = 0;
+    for (size_t i = 0; i < texels.size(); i++)
+    {
+        if (texels[i] == NO_TEXEL && reference[i] == NO_TEXEL)
+            continue;
+        drawn++;
+        same += texels[i] == reference[i];
+    }
+    return drawn == 0 ? 100 : 100. * same / drawn;
+}
+
+template <typename Scalar>
+void Print(const Run& run, const Run& reference)
+{
+    std::printf("  %-12s %8.3f ms  %6.2f%% texels as double  checksum %08x\n", ScalarTraits<Scalar>::Name(), run.ms,
+        Agreement(run.texels, reference.texels), Checksum(run.texels));
+}
+
+// the grid as a level with textured floors and ceilings, the pillars on every
+// third diagonal are quarter walls so top faces are drawn too
+struct World
+{
+    Level level;
+    LightMap lightMap;
+    ResidentTextures textures;
+    SpriteSheet sheet = {};
+    std::vector<Sprite> sprites;
+};
+
+void MakeWorld(const std::vector<int>& cells, World& world)
+{
+    Level& level = world.level;
+    level.Resize(MAP_SIZE, MAP_SIZE);
+    for (int y = 0; y < MAP_SIZE; y++)
+    {
+        for (int x = 0; x < MAP_SIZE; x++)
+        {
+            size_t i = size_t(y) * MAP_SIZE + x;
+            bool border = x == 0 || y == 0 || x == MAP_SIZE - 1 || y == MAP_SIZE - 1;
+            level.walls[i] = cells[i];
+            level.floors[i] = 1;
+            level.ceils[i] = 2;
+            level.heights[i] = !border && (x + y) % 3 == 0 ? 1 : 0;
+        }
+    }
+    level.SyncOccupancy();
+    world.lightMap.Reset(level.Walls(), MAX_LIGHT);
+
+    // one tile per texture, wall, floor and ceiling
+    Image atlas;
+    atlas.width = TEXTURE_SIZE * 3;
+    atlas.height = TEXTURE_SIZE;
+    atlas.pitch = atlas.width * 4;
+    atlas.storage.resize(size_t(atlas.width) * atlas.height);
+    for (size_t i = 0; i < atlas.storage.size(); i++)
+    {
+        atlas.storage[i] = uint32_t(i * 2654435761u) | 0xFF;
+    }
+    atlas.pixels = atlas.storage.data();
+    ImageTileSource source(atlas, TEXTURE_SIZE);
+    world.textures.Load(source);
+}
+
+struct FrameRun
+{
+    double ms;
+    std::vector<uint32_t> pixels;
+};
+
+FrameRun DrawFrames(const World& world, const std::vector<Pose>& poses, bool fixedPoint)
+{
+    FrameRun run;
+    run.pixels.resize(poses.size() * PLANE_WIDTH * PLANE_HEIGHT);
+    ColumnFramebuffer frame(PLANE_WIDTH, PLANE_HEIGHT);
+    RenderScratch scratch;
+    Player camera = SpawnPlayer();
+    double ms = 0;
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+        camera.pos = poses[i].pos;
+        camera.angle = std::atan2(poses[i].dir.y, poses[i].dir.x);
+        frame.Clear(0);
+        auto start = std::chrono::steady_clock::now();
+        DrawWorld<TrueColor>(frame, world.textures, world.sheet,
+            WorldView{camera, world.level, world.lightMap, world.sprites, false, fixedPoint}, scratch);
+        ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        uint32_t* out = run.pixels.data() + i * PLANE_WIDTH * PLANE_HEIGHT;
+        for (int x = 0; x < PLANE_WIDTH; x++)
+        {
+            std::copy(frame.Column(x), frame.Column(x) + PLANE_HEIGHT, out + x * PLANE_HEIGHT);
+        }
+    }
+    run.ms = ms / poses.size();
+    return run;
+}
+
+void PrintFrames(const char* name, const FrameRun& run, const FrameRun& reference)
+{
+    size_t same = 0;
+    for (size_t i = 0; i < run.pixels.size(); i++)
+    {
+        same += run.pixels[i] == reference.pixels[i];
+    }
+    std::printf("  %-12s %8.3f ms  %6.2f%% pixels as float\n", name, run.ms, 100. * same / run.pixels.size());
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 200;
+
+    std::mt19937 random(1234);
+    std::vector<int> cells = MakeGrid(random);
+    GridView grid = {cells.data(), MAP_SIZE, MAP_SIZE};
+    std::vector<Pose> poses = MakePoses(random, grid, frames);
+
+    // the first pass warms caches for all of them
+    Bench<float>(grid, poses);
+    Run floatRun = Bench<float>(grid, poses);
+    Run doubleRun = Bench<double>(grid, poses);
+    Run fixedRun = Bench<Fixed>(grid, poses);
+
+    std::printf("%d frames of %dx%d on a %dx%d map, per frame\n", frames, COLUMNS, ROWS, MAP_SIZE, MAP_SIZE);
+    Print<float>(floatRun, doubleRun);
+    Print<double>(doubleRun, doubleRun);
+    Print<Fixed>(fixedRun, doubleRun);
+
+    World world;
+    MakeWorld(cells, world);
+    DrawFrames(world, poses, false);
+    FrameRun floatFrames = DrawFrames(world, poses, false);
+    FrameRun fixedFrames = DrawFrames(world, poses, true);
+
+    std::printf("DrawWorld, %dx%d, per frame\n", PLANE_WIDTH, PLANE_HEIGHT);
+    PrintFrames(ScalarTraits<float>::Name(), floatFrames, floatFrames);
+    PrintFrames(ScalarTraits<Fixed>::Name(), fixedFrames, floatFrames);
+    return 0;
+}
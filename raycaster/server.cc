@@ -0,0 +1,71 @@
+// Headless authoritative server.
+//   server [port] [seconds]
+// Runs forever unless seconds is given, prints tick time and traffic once a second.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "game_server.h"
+#include "job_system.h"
+#include "level.h"
+#include "protocol.h"
+
+const char LEVEL_PATH[] = "data/level.txt";
+
+int main(int argc, char* argv[])
+{
+    int port = argc > 1 ? std::atoi(argv[1]) : DEFAULT_SERVER_PORT;
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 0;
+
+    Level level;
+    if (!LoadLevel(LEVEL_PATH, level))
+    {
+        std::fprintf(stderr, "failed to load %s\n", LEVEL_PATH);
+        return 1;
+    }
+
+    JobSystem jobs;
+    GameServer server(jobs, level);
+    if (!server.Start(uint16_t(port)))
+    {
+        std::fprintf(stderr, "failed to bind udp port %d\n", port);
+        return 1;
+    }
+    std::printf("listening on udp %d, %d ms ticks\n", port, SERVER_TICK_MS);
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    auto nextTick = start;
+    auto nextReport = start + std::chrono::seconds(1);
+    while (seconds <= 0 || clock::now() - start < std::chrono::seconds(seconds))
+    {
+        server.Tick();
+
+        if (clock::now() >= nextReport)
+        {
+            double elapsed = std::chrono::duration<double>(clock::now() - nextReport + std::chrono::seconds(1)).count();
+            nextReport = clock::now() + std::chrono::seconds(1);
+
+            ServerStats stats = server.TakeStats();
+            int clients = std::max(stats.clients, 1);
+            int ticks = std::max(stats.ticks, 1);
+            std::printf("tick %u: %d clients, tick avg %.3f ms max %.3f ms, out %.2f KB/s per client, in %.2f KB/s per client, %llu/%llu snapshots delta, "
+                "flow field %.3f ms per tick for %.1f tracking enemies\n",
+                server.CurrentTick(), stats.clients,
+                stats.ticks ? stats.tickMsTotal / stats.ticks : 0., stats.tickMsMax,
+                stats.bytesOut / 1024. / elapsed / clients, stats.bytesIn / 1024. / elapsed / clients,
+                (unsigned long long)stats.deltaSnapshots, (unsigned long long)stats.snapshots,
+                stats.flowMsTotal / ticks, double(stats.agentsTracking) / ticks);
+            std::fflush(stdout);
+        }
+
+        // fixed rate, a tick that ran late is not made up for
+        nextTick += std::chrono::milliseconds(SERVER_TICK_MS);
+        if (nextTick < clock::now())
+            nextTick = clock::now();
+        std::this_thread::sleep_until(nextTick);
+    }
+    return 0;
+}
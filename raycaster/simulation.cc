@@ -0,0 +1,126 @@
+#include "simulation.h"
+
+#include <cmath>
+
+namespace
+{
+
+// enemy spawn points, live enemies are in the entity store
+const int SPAWN_COUNT = 7;
+
+const Sprite SPAWNS[SPAWN_COUNT] = {
+    {1.5, 1.5, 1, 0},
+    {6.5, 1.5, 1, 0},
+    {1.5, 6.5, 1, 0},
+    {10.5, 8.5, 1, 0},
+    {9.5, 9.5, 1, 0},
+    {10.5, 10.5, 1, 0},
+    {12.5, 11.5, 1, 0}
+};
+
+} // namespace
+
+float DegToRad(float angle)
+{
+    return angle * PI / 180.;
+}
+
+Player SpawnPlayer()
+{
+    Player player;
+    player.pos = {2, 3};
+
+    vector2f direction = { 1., -1. };
+    player.angle = std::atan2(direction.y, direction.x);
+
+    player.fov = DegToRad(PLAYER_FOV);
+    return player;
+}
+
+float MouseTurn(int xrel, int deltaMs)
+{
+    float angle = DegToRad(MOUSE_MOTION_MULTIPLIER * MOUSE_MOTION_SPEED) * (deltaMs/1000.);
+
+    if (xrel < 0) // left
+        return -angle;
+    if (xrel > 0) // right
+        return angle;
+    return 0;
+}
+
+void ApplyPlayerInput(Player& player, const PlayerInput& input, const Level& level, int deltaMs)
+{
+    player.angle = input.angle;
+
+    vector2f playerDirection = {
+        static_cast<float>(cos(player.angle)), static_cast<float>(sin(player.angle))
+    };
+
+    float tickSpeed = PLAYER_SPEED/2 * (deltaMs/1000.);
+
+    if (input.buttons & INPUT_FORWARD)
+    {
+        if (!level.Solid(int(player.pos.x + playerDirection.x * tickSpeed), int(player.pos.y)))
+            player.pos.x += playerDirection.x * tickSpeed;
+        if (!level.Solid(int(player.pos.x), int(player.pos.y + playerDirection.y * tickSpeed)))
+            player.pos.y += playerDirection.y * tickSpeed;
+    }
+    if (input.buttons & INPUT_BACK)
+    {
+        if (!level.Solid(int(player.pos.x - playerDirection.x * tickSpeed), int(player.pos.y)))
+            player.pos.x -= playerDirection.x * tickSpeed;
+        if (!level.Solid(int(player.pos.x), int(player.pos.y - playerDirection.y * tickSpeed)))
+            player.pos.y -= playerDirection.y * tickSpeed;
+    }
+    if (input.buttons & INPUT_LEFT)
+    {
+        if (!level.Solid(int(player.pos.x + playerDirection.y * tickSpeed), int(player.pos.y)) &&
+            !level.Solid(int(player.pos.x), int(player.pos.y - playerDirection.x * tickSpeed)))
+        {
+            player.pos.x += playerDirection.y * tickSpeed;
+            player.pos.y -= playerDirection.x * tickSpeed;
+        }
+    }
+    if (input.buttons & INPUT_RIGHT)
+    {
+        if (!level.Solid(int(player.pos.x - playerDirection.y * tickSpeed), int(player.pos.y)) &&
+            !level.Solid(int(player.pos.x), int(player.pos.y + playerDirection.x * tickSpeed)))
+        {
+            player.pos.x -= playerDirection.y * tickSpeed;
+            player.pos.y += playerDirection.x * tickSpeed;
+        }
+    }
+}
+
+void SpawnEnemies(EntityStore& store, GridView grid)
+{
+    const int dirs[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+    for (int i = 0; i < SPAWN_COUNT; i++)
+    {
+        EnemyDesc desc;
+        desc.pos = {SPAWNS[i].x, SPAWNS[i].y};
+        desc.patrolTarget = desc.pos;
+        desc.texture = SPAWNS[i].texture;
+        desc.frameCount = ENEMY_FRAME_COUNT;
+        desc.speed = ENEMY_SPEED;
+        desc.sightRadius = ENEMY_SIGHT_RADIUS;
+        desc.trackRadius = ENEMY_TRACK_RADIUS;
+
+        for (const auto& dir : dirs)
+        {
+            int cells = 0;
+            while (cells < ENEMY_PATROL_LENGTH &&
+                grid.At(int(desc.pos.x) + dir[0] * (cells + 1), int(desc.pos.y) + dir[1] * (cells + 1)) == 0)
+            {
+                cells++;
+            }
+            if (cells > 0)
+            {
+                desc.patrolTarget = {desc.pos.x + dir[0] * cells, desc.pos.y + dir[1] * cells};
+                break;
+            }
+        }
+        store.Spawn(desc);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+#include "entities.h"
+#include "level.h"
+#include "types.h"
+
+// Game rules shared by the client, the headless server and demo playback.
+// Nothing in here touches SDL, input arrives as PlayerInput commands.
+
+const float PI = 3.1415;
+
+const int PLAYER_FOV = 60;
+
+const int PLAYER_SPEED = 10.;
+
+const int MOUSE_MOTION_SPEED = 6.1;
+const int MOUSE_MOTION_MULTIPLIER = 2.5;
+
+// Entities
+const int ENTITY_CAPACITY = 4096;
+const int ENEMY_FRAME_COUNT = 1; // frames are laid out horizontally in enemy.png
+const float ENEMY_SPEED = 1.5;
+const float ENEMY_SIGHT_RADIUS = 6;
+const int ENEMY_PATROL_LENGTH = 4;
+// out of sight enemies follow the flow field to the player up to this path length
+const float ENEMY_TRACK_RADIUS = 12;
+
+struct Player
+{
+    vector2f pos;
+    double angle;
+    int fov;
+};
+
+enum InputButton : uint8_t
+{
+    INPUT_FORWARD = 1 << 0,
+    INPUT_BACK = 1 << 1,
+    INPUT_LEFT = 1 << 2,
+    INPUT_RIGHT = 1 << 3,
+    INPUT_FIRE = 1 << 4,
+};
+
+// one simulation step worth of input, the mouse is already folded into the
+// view angle so commands can be dropped or replayed without drifting
+struct PlayerInput
+{
+    uint8_t buttons = 0;
+    double angle = 0;
+};
+
+float DegToRad(float angle);
+
+Player SpawnPlayer();
+
+// view angle change of a single mouse motion event
+float MouseTurn(int xrel, int deltaMs);
+
+// turns to input.angle, then moves with wall sliding for deltaMs
+void ApplyPlayerInput(Player& player, const PlayerInput& input, const Level& level, int deltaMs);
+
+// every spawn point gets an enemy which patrols to the furthest free cell
+// (up to ENEMY_PATROL_LENGTH) in the first open direction
+void SpawnEnemies(EntityStore& store, GridView grid);
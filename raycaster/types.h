@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct vector2d
+{
+    double x, y;
+};
+
+struct vector2f
+{
+    float x, y;
+};
+
+enum TILE_SIDE
+{
+    X, Y
+};
+
+// packed, render-ready sprite handed to the sprite renderer
+struct Sprite
+{
+    float x, y;
+    int texture;
+    int frame;
+};
+
+// cells per side of an occupancy super block, see occupancy.h
+const int OCCUPANCY_SUPER_CELLS = 64;
+
+// read-only bit per cell of an OccupancyGrid
+struct OccupancyView
+{
+    const uint64_t* blocks = nullptr;
+    int superBlocksX = 0;
+
+    // spreads 3 bits apart for the Morton order of blocks in a super block
+    static int Spread3(int v) { return (v & 1) | ((v & 2) << 1) | ((v & 4) << 2); }
+
+    size_t BlockIndex(int x, int y) const
+    {
+        int bx = x >> 3;
+        int by = y >> 3;
+        size_t super = size_t(by >> 3) * superBlocksX + (bx >> 3);
+        return super * 64 + (Spread3(bx & 7) | (Spread3(by & 7) << 1));
+    }
+
+    bool Solid(int x, int y) const
+    {
+        return (blocks[BlockIndex(x, y)] >> ((y & 7) * 8 + (x & 7))) & 1;
+    }
+};
+
+// read-only view over a row-major tile layer, cells[y * width + x], with
+// the occupancy bits of the layer when its owner keeps them
+struct GridView
+{
+    const int* cells;
+    int width;
+    int height;
+    OccupancyView occupancy = {};
+
+    bool Inside(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < width && y < height;
+    }
+
+    // cells outside of the grid are treated as solid
+    int At(int x, int y) const
+    {
+        return Inside(x, y) ? cells[y * width + x] : 1;
+    }
+
+    // same as At(x, y) != 0 without touching the tile ids when there are bits
+    bool Solid(int x, int y) const
+    {
+        if (!Inside(x, y))
+            return true;
+        return occupancy.blocks ? occupancy.Solid(x, y) : cells[y * width + x] != 0;
+    }
+};
@@ -0,0 +1,627 @@
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "scalar.h"
+
+namespace
+{
+
+const uint32_t NO_PAGE = 0xFFFFFFFF;
+
+int LevelSize(int size, int mip)
+{
+    return std::max(1, size >> mip);
+}
+
+// average of a block of row-major image texels, channel by channel
+uint32_t AverageImage(const Image& image, int x0, int y0, int x1, int y1)
+{
+    uint32_t sum[4] = {0, 0, 0, 0};
+    for (int y = y0; y < y1; y++)
+    {
+        for (int x = x0; x < x1; x++)
+        {
+            uint32_t texel = image.At(x, y);
+            for (int c = 0; c < 4; c++)
+            {
+                sum[c] += (texel >> (c * 8)) & 0xFF;
+            }
+        }
+    }
+
+    uint32_t count = uint32_t((x1 - x0) * (y1 - y0));
+    uint32_t result = 0;
+    for (int c = 0; c < 4; c++)
+    {
+        result |= (sum[c] / count) << (c * 8);
+    }
+    return result;
+}
+
+// pages of every level before mip
+uint32_t MipPageOffset(const VirtualTextureInfo& info, int mip)
+{
+    uint32_t offset = 0;
+    for (int m = 0; m < mip; m++)
+    {
+        offset += uint32_t(VirtualPagesX(info, m) * VirtualPagesY(info, m));
+    }
+    return offset;
+}
+
+// see VirtualTextures::MipFor
+int MipForSize(const VirtualTextureInfo& info, float pixelsAcross)
+{
+    float texelsPerPixel = info.height / std::max(pixelsAcross, 1e-3f);
+    int mip = 0;
+    while (texelsPerPixel >= 2 && mip < info.mipCount - 1)
+    {
+        texelsPerPixel *= .5f;
+        mip++;
+    }
+    return mip;
+}
+
+} // namespace
+
+int VirtualMipCount(int width, int height)
+{
+    int count = 1;
+    while (std::max(width, height) > VT_PAGE_SIZE)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        count++;
+    }
+    return count;
+}
+
+int VirtualPagesX(const VirtualTextureInfo& info, int mip)
+{
+    return (LevelSize(info.width, mip) + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+}
+
+int VirtualPagesY(const VirtualTextureInfo& info, int mip)
+{
+    return (LevelSize(info.height, mip) + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+}
+
+uint32_t LayoutVirtualTextures(std::vector<VirtualTextureInfo>& textures)
+{
+    uint32_t page = 0;
+    for (VirtualTextureInfo& info : textures)
+    {
+        info.mipCount = VirtualMipCount(info.width, info.height);
+        info.firstPage = page;
+        page += MipPageOffset(info, info.mipCount);
+    }
+    return page;
+}
+
+bool LocateVirtualPage(const std::vector<VirtualTextureInfo>& textures, uint32_t page,
+    int& texture, int& mip, int& pageX, int& pageY)
+{
+    auto it = std::upper_bound(textures.begin(), textures.end(), page,
+        [](uint32_t value, const VirtualTextureInfo& info) { return value < info.firstPage; });
+    if (it == textures.begin())
+        return false;
+    --it;
+
+    texture = static_cast<int>(it - textures.begin());
+    uint32_t offset = page - it->firstPage;
+    for (mip = 0; mip < it->mipCount; mip++)
+    {
+        int pagesX = VirtualPagesX(*it, mip);
+        uint32_t pages = uint32_t(pagesX * VirtualPagesY(*it, mip));
+        if (offset < pages)
+        {
+            pageX = int(offset % pagesX);
+            pageY = int(offset / pagesX);
+            return true;
+        }
+        offset -= pages;
+    }
+    return false;
+}
+
+void DownsampleRegion(const Image& image, int x, int y, int width, int height, int mip, std::vector<uint32_t>& out)
+{
+    int levelWidth = LevelSize(width, mip);
+    int levelHeight = LevelSize(height, mip);
+    out.resize(size_t(levelWidth) * levelHeight);
+
+    for (int lx = 0; lx < levelWidth; lx++)
+    {
+        int x0 = x + lx * width / levelWidth;
+        int x1 = std::max(x0 + 1, x + (lx + 1) * width / levelWidth);
+        for (int ly = 0; ly < levelHeight; ly++)
+        {
+            int y0 = y + ly * height / levelHeight;
+            int y1 = std::max(y0 + 1, y + (ly + 1) * height / levelHeight);
+            out[size_t(lx) * levelHeight + ly] = AverageImage(image, x0, y0, x1, y1);
+        }
+    }
+}
+
+void CutPage(const std::vector<uint32_t>& level, int levelWidth, int levelHeight, int pageX, int pageY, uint32_t* out)
+{
+    // levels smaller than a page repeat their last row and column
+    for (int c = 0; c < VT_PAGE_SIZE; c++)
+    {
+        int x = std::min(pageX * VT_PAGE_SIZE + c, levelWidth - 1);
+        const uint32_t* column = level.data() + size_t(x) * levelHeight;
+        for (int r = 0; r < VT_PAGE_SIZE; r++)
+        {
+            out[c * VT_PAGE_SIZE + r] = column[std::min(pageY * VT_PAGE_SIZE + r, levelHeight - 1)];
+        }
+    }
+}
+
+void MakeTail(const std::vector<uint32_t>& level, int levelWidth, int levelHeight, uint32_t* out)
+{
+    for (int tx = 0; tx < VT_TAIL_SIZE; tx++)
+    {
+        int x = std::min(tx * levelWidth / VT_TAIL_SIZE + levelWidth / (2 * VT_TAIL_SIZE), levelWidth - 1);
+        for (int ty = 0; ty < VT_TAIL_SIZE; ty++)
+        {
+            int y = std::min(ty * levelHeight / VT_TAIL_SIZE + levelHeight / (2 * VT_TAIL_SIZE), levelHeight - 1);
+            out[tx * VT_TAIL_SIZE + ty] = level[size_t(x) * levelHeight + y];
+        }
+    }
+}
+
+bool VirtualTextureFile::Open(const std::string& path)
+{
+    file.open(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, VT_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != VT_FILE_VERSION ||
+        header.pageSize != uint32_t(VT_PAGE_SIZE) || header.tailSize != uint32_t(VT_TAIL_SIZE))
+    {
+        return false;
+    }
+
+    std::vector<VtFileTexture> entries(header.textureCount);
+    file.seekg(std::streamoff(header.textureOffset));
+    if (!file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(VtFileTexture)))
+        return false;
+
+    textures.clear();
+    for (const VtFileTexture& entry : entries)
+    {
+        textures.push_back(VirtualTextureInfo{int(entry.width), int(entry.height), int(entry.mipCount), entry.firstPage});
+    }
+    return true;
+}
+
+bool VirtualTextureFile::ReadPage(uint32_t page, uint32_t* out)
+{
+    if (page >= header.pageCount)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file.clear();
+    file.seekg(std::streamoff(header.pageOffset + uint64_t(page) * VT_PAGE_TEXELS * 4));
+    return bool(file.read(reinterpret_cast<char*>(out), VT_PAGE_TEXELS * 4));
+}
+
+bool VirtualTextureFile::ReadTail(int texture, uint32_t* out)
+{
+    if (texture < 0 || texture >= int(textures.size()))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file.clear();
+    file.seekg(std::streamoff(header.tailOffset + uint64_t(texture) * VT_TAIL_TEXELS * 4));
+    return bool(file.read(reinterpret_cast<char*>(out), VT_TAIL_TEXELS * 4));
+}
+
+ImageTileSource::ImageTileSource(const Image& atlas, int tileSize)
+    : tileSize(tileSize), columns(std::max(1, atlas.width / tileSize))
+{
+    int rows = atlas.height / tileSize;
+    textures.assign(size_t(columns) * rows, VirtualTextureInfo{tileSize, tileSize, 0, 0});
+    LayoutVirtualTextures(textures);
+    image = std::make_shared<const Image>(atlas);
+}
+
+void ImageTileSource::SetImage(const Image& atlas)
+{
+    auto next = std::make_shared<const Image>(atlas);
+    std::lock_guard<std::mutex> lock(mutex);
+    image = std::move(next);
+}
+
+std::vector<int> ImageTileSource::TexturesIn(int x, int y, int width, int height) const
+{
+    std::vector<int> covered;
+    int rows = static_cast<int>(textures.size()) / columns;
+    for (int ty = y / tileSize; ty <= (y + height - 1) / tileSize && ty < rows; ty++)
+    {
+        for (int tx = x / tileSize; tx <= (x + width - 1) / tileSize && tx < columns; tx++)
+        {
+            covered.push_back(ty * columns + tx);
+        }
+    }
+    return covered;
+}
+
+bool ImageTileSource::ReadPage(uint32_t page, uint32_t* out)
+{
+    int texture, mip, pageX, pageY;
+    if (!LocateVirtualPage(textures, page, texture, mip, pageX, pageY))
+        return false;
+
+    std::shared_ptr<const Image> current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = image;
+    }
+
+    std::vector<uint32_t> level;
+    DownsampleRegion(*current, texture % columns * tileSize, texture / columns * tileSize, tileSize, tileSize, mip, level);
+    CutPage(level, LevelSize(tileSize, mip), LevelSize(tileSize, mip), pageX, pageY, out);
+    return true;
+}
+
+bool ImageTileSource::ReadTail(int texture, uint32_t* out)
+{
+    if (texture < 0 || texture >= int(textures.size()))
+        return false;
+
+    std::shared_ptr<const Image> current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = image;
+    }
+
+    int mip = textures[texture].mipCount - 1;
+    std::vector<uint32_t> level;
+    DownsampleRegion(*current, texture % columns * tileSize, texture / columns * tileSize, tileSize, tileSize, mip, level);
+    MakeTail(level, LevelSize(tileSize, mip), LevelSize(tileSize, mip), out);
+    return true;
+}
+
+VirtualTextures::VirtualTextures(int cachePages)
+    : cachePages(std::min(cachePages, int(VT_NOT_RESIDENT)))
+{
+    cache.resize(size_t(this->cachePages) * VT_PAGE_TEXELS);
+    slotPages.assign(this->cachePages, NO_PAGE);
+    slotUsed = std::vector<std::atomic<uint32_t>>(this->cachePages);
+}
+
+VirtualTextures::~VirtualTextures()
+{
+    Stop();
+}
+
+bool VirtualTextures::Start(std::unique_ptr<PageSource> pageSource)
+{
+    Stop();
+    source = std::move(pageSource);
+    textures = source->Textures();
+
+    uint32_t pageCount = 0;
+    if (!textures.empty())
+        pageCount = textures.back().firstPage + MipPageOffset(textures.back(), textures.back().mipCount);
+    pageSlots.assign(pageCount, VT_NOT_RESIDENT);
+    pageRequested = std::vector<std::atomic<uint8_t>>(pageCount);
+    slotPages.assign(cachePages, NO_PAGE);
+    residentPages = 0;
+
+    generations.assign(textures.size(), 0);
+    tails.assign(textures.size() * VT_TAIL_TEXELS, 0);
+    if (palette)
+    {
+        indexCache.assign(cache.size(), 0);
+        indexTails.assign(tails.size(), 0);
+    }
+    bool tailsRead = true;
+    for (int i = 0; i < TextureCount(); i++)
+    {
+        tailsRead = source->ReadTail(i, tails.data() + size_t(i) * VT_TAIL_TEXELS) && tailsRead;
+    }
+    if (palette)
+        palette->Quantize(tails.data(), tails.size(), indexTails.data());
+
+    stopping = false;
+    loader = std::thread(&VirtualTextures::LoaderLoop, this);
+    return tailsRead;
+}
+
+void VirtualTextures::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        pending.clear();
+    }
+    wake.notify_all();
+    if (loader.joinable())
+        loader.join();
+}
+
+int VirtualTextures::MipFor(int texture, float pixelsAcross) const
+{
+    return MipForSize(textures[texture], pixelsAcross);
+}
+
+bool VirtualTextures::Locate(int texture, float u, float v, int mip, size_t& offset)
+{
+    const VirtualTextureInfo& info = textures[texture];
+    mip = std::min(std::max(mip, 0), info.mipCount - 1);
+
+    uint32_t levelPage = info.firstPage + MipPageOffset(info, mip);
+    for (int m = mip; m < info.mipCount; m++)
+    {
+        int levelWidth = LevelSize(info.width, m);
+        int levelHeight = LevelSize(info.height, m);
+        int x = TexelCoord(u, levelWidth);
+        int y = TexelCoord(v, levelHeight);
+        int pagesX = VirtualPagesX(info, m);
+        uint32_t page = levelPage + uint32_t((y / VT_PAGE_SIZE) * pagesX + x / VT_PAGE_SIZE);
+
+        uint16_t slot = pageSlots[page];
+        if (slot != VT_NOT_RESIDENT)
+        {
+            // most samples find it marked already, those do not write
+            if (slotUsed[slot].load(std::memory_order_relaxed) != frame)
+                slotUsed[slot].store(frame, std::memory_order_relaxed);
+            if (m != mip)
+                fallbackSamples.fetch_add(1, std::memory_order_relaxed);
+            offset = size_t(slot) * VT_PAGE_TEXELS + (x % VT_PAGE_SIZE) * VT_PAGE_SIZE + y % VT_PAGE_SIZE;
+            return true;
+        }
+
+        // only the level which was asked for is streamed in
+        // whoever sets the flag first asks for it
+        if (m == mip && !pageRequested[page].load(std::memory_order_relaxed) &&
+            !pageRequested[page].exchange(1, std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(requestMutex);
+            requests.push_back(page);
+        }
+        levelPage += uint32_t(pagesX * VirtualPagesY(info, m));
+    }
+
+    fallbackSamples.fetch_add(1, std::memory_order_relaxed);
+    int tx = TexelCoord(u, VT_TAIL_SIZE);
+    int ty = TexelCoord(v, VT_TAIL_SIZE);
+    offset = size_t(texture) * VT_TAIL_TEXELS + tx * VT_TAIL_SIZE + ty;
+    return false;
+}
+
+uint32_t VirtualTextures::Sample(int texture, float u, float v, int mip)
+{
+    size_t offset;
+    return Locate(texture, u, v, mip, offset) ? cache[offset] : tails[offset];
+}
+
+uint8_t VirtualTextures::SampleIndex(int texture, float u, float v, int mip)
+{
+    size_t offset;
+    return Locate(texture, u, v, mip, offset) ? indexCache[offset] : indexTails[offset];
+}
+
+void VirtualTextures::ReadTail(int texture)
+{
+    uint32_t* tail = tails.data() + size_t(texture) * VT_TAIL_TEXELS;
+    source->ReadTail(texture, tail);
+    if (palette)
+        palette->Quantize(tail, VT_TAIL_TEXELS, indexTails.data() + size_t(texture) * VT_TAIL_TEXELS);
+}
+
+void VirtualTextures::Invalidate(int texture)
+{
+    if (!Valid(texture))
+        return;
+
+    generations[texture]++;
+
+    const VirtualTextureInfo& info = textures[texture];
+    uint32_t first = info.firstPage;
+    uint32_t last = first + MipPageOffset(info, info.mipCount);
+    for (int slot = 0; slot < cachePages; slot++)
+    {
+        if (slotPages[slot] != NO_PAGE && slotPages[slot] >= first && slotPages[slot] < last)
+        {
+            slotPages[slot] = NO_PAGE;
+            slotUsed[slot] = 0;
+            residentPages--;
+        }
+    }
+    std::fill(pageSlots.begin() + first, pageSlots.begin() + last, VT_NOT_RESIDENT);
+    std::fill(pageRequested.begin() + first, pageRequested.begin() + last, uint8_t(0));
+
+    ReadTail(texture);
+}
+
+int VirtualTextures::FindVictim()
+{
+    int victim = -1;
+    for (int slot = 0; slot < cachePages; slot++)
+    {
+        if (slotPages[slot] == NO_PAGE)
+            return slot;
+        // pages sampled this frame stay
+        if (slotUsed[slot] < frame && (victim < 0 || slotUsed[slot] < slotUsed[victim]))
+            victim = slot;
+    }
+    return victim;
+}
+
+void VirtualTextures::Install(const LoadedPage& page)
+{
+    int texture, mip, pageX, pageY;
+    LocateVirtualPage(textures, page.page, texture, mip, pageX, pageY);
+
+    // a failed read stays requested, the page keeps falling back
+    if (page.texels.empty())
+        return;
+
+    if (page.generation != generations[texture] || pageSlots[page.page] != VT_NOT_RESIDENT)
+    {
+        pageRequested[page.page] = 0;
+        return;
+    }
+
+    int slot = FindVictim();
+    if (slot < 0)
+    {
+        pageRequested[page.page] = 0;
+        return;
+    }
+
+    if (slotPages[slot] != NO_PAGE)
+    {
+        pageSlots[slotPages[slot]] = VT_NOT_RESIDENT;
+        stats.evicted++;
+    }
+    else
+    {
+        residentPages++;
+    }
+
+    std::memcpy(cache.data() + size_t(slot) * VT_PAGE_TEXELS, page.texels.data(), VT_PAGE_TEXELS * 4);
+    if (palette)
+        std::memcpy(indexCache.data() + size_t(slot) * VT_PAGE_TEXELS, page.indices.data(), VT_PAGE_TEXELS);
+    slotPages[slot] = page.page;
+    slotUsed[slot] = frame;
+    pageSlots[page.page] = uint16_t(slot);
+    pageRequested[page.page] = 0;
+    stats.installed++;
+}
+
+void VirtualTextures::Update()
+{
+    stats.requested = 0;
+    stats.installed = 0;
+    stats.evicted = 0;
+
+    std::vector<LoadedPage> arrived;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t page : requests)
+        {
+            if (stats.requested == VT_MAX_REQUESTS_PER_FRAME)
+            {
+                // asked for again when it is still needed
+                pageRequested[page] = 0;
+                continue;
+            }
+            int texture, mip, pageX, pageY;
+            LocateVirtualPage(textures, page, texture, mip, pageX, pageY);
+            pending.push_back(PendingPage{page, generations[texture]});
+            stats.requested++;
+        }
+        arrived.swap(loaded);
+    }
+    requests.clear();
+    if (stats.requested > 0)
+        wake.notify_one();
+
+    for (const LoadedPage& page : arrived)
+    {
+        Install(page);
+    }
+
+    stats.residentPages = residentPages;
+    stats.cachePages = cachePages;
+    stats.fallbackSamples = fallbackSamples.exchange(0, std::memory_order_relaxed);
+    frame++;
+}
+
+VirtualTextureStats VirtualTextures::Stats() const
+{
+    return stats;
+}
+
+void VirtualTextures::LoaderLoop()
+{
+    for (;;)
+    {
+        PendingPage job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !pending.empty(); });
+            if (stopping)
+                return;
+            job = pending.front();
+            pending.pop_front();
+        }
+
+        LoadedPage page;
+        page.page = job.page;
+        page.generation = job.generation;
+        page.texels.resize(VT_PAGE_TEXELS);
+        if (!source->ReadPage(job.page, page.texels.data()))
+        {
+            page.texels.clear();
+        }
+        else if (palette)
+        {
+            // quantized here so installing stays a copy
+            page.indices.resize(VT_PAGE_TEXELS);
+            palette->Quantize(page.texels.data(), VT_PAGE_TEXELS, page.indices.data());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        loaded.push_back(std::move(page));
+    }
+}
+
+bool ResidentTextures::Load(PageSource& source, const PaletteLookup* palette)
+{
+    textures = source.Textures();
+    uint32_t pageCount = 0;
+    if (!textures.empty())
+        pageCount = textures.back().firstPage + MipPageOffset(textures.back(), textures.back().mipCount);
+
+    pages.assign(size_t(pageCount) * VT_PAGE_TEXELS, 0);
+    bool read = true;
+    for (uint32_t page = 0; page < pageCount; page++)
+    {
+        read = source.ReadPage(page, pages.data() + size_t(page) * VT_PAGE_TEXELS) && read;
+    }
+
+    indices.clear();
+    if (palette)
+    {
+        indices.resize(pages.size());
+        palette->Quantize(pages.data(), pages.size(), indices.data());
+    }
+    return read;
+}
+
+int ResidentTextures::MipFor(int texture, float pixelsAcross) const
+{
+    return MipForSize(textures[texture], pixelsAcross);
+}
+
+size_t ResidentTextures::Locate(int texture, float u, float v, int mip) const
+{
+    const VirtualTextureInfo& info = textures[texture];
+    mip = std::min(std::max(mip, 0), info.mipCount - 1);
+
+    int levelWidth = LevelSize(info.width, mip);
+    int levelHeight = LevelSize(info.height, mip);
+    int x = TexelCoord(u, levelWidth);
+    int y = TexelCoord(v, levelHeight);
+    uint32_t page = info.firstPage + MipPageOffset(info, mip) + uint32_t((y / VT_PAGE_SIZE) * VirtualPagesX(info, mip) + x / VT_PAGE_SIZE);
+    return size_t(page) * VT_PAGE_TEXELS + (x % VT_PAGE_SIZE) * VT_PAGE_SIZE + y % VT_PAGE_SIZE;
+}
+
+uint32_t ResidentTextures::Sample(int texture, float u, float v, int mip) const
+{
+    return pages[Locate(texture, u, v, mip)];
+}
+
+uint8_t ResidentTextures::SampleIndex(int texture, float u, float v, int mip) const
+{
+    return indices[Locate(texture, u, v, mip)];
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asset_pack.h"
+#include "palette.h"
+
+// Virtual textures.
+// Every texture is a mip chain cut into square pages. Only pages the renderer
+// actually touched are kept, in a fixed number of cache slots, and they are
+// streamed in by a loader thread. Until a page arrives the next coarser
+// resident mip is sampled, and every texture keeps a tiny tail image which is
+// always there. Resident memory is the cache plus one tail per texture, no
+// matter how much art the source holds.
+
+const int VT_PAGE_SIZE = 64;
+const int VT_PAGE_TEXELS = VT_PAGE_SIZE * VT_PAGE_SIZE;
+const int VT_TAIL_SIZE = 8;
+const int VT_TAIL_TEXELS = VT_TAIL_SIZE * VT_TAIL_SIZE;
+
+// 16 KiB per page, 4 MiB by default
+const int VT_CACHE_PAGES = 256;
+// pages handed to the loader per frame, the rest is asked for again next frame
+const int VT_MAX_REQUESTS_PER_FRAME = 32;
+
+const uint16_t VT_NOT_RESIDENT = 0xFFFF;
+
+// Mip m is max(1, width >> m) by max(1, height >> m), levels go down until
+// a single page holds the whole level. The pages of every level follow each
+// other row by row starting at firstPage, finest level first.
+struct VirtualTextureInfo
+{
+    int width;
+    int height;
+    int mipCount;
+    uint32_t firstPage;
+};
+
+int VirtualMipCount(int width, int height);
+int VirtualPagesX(const VirtualTextureInfo& info, int mip);
+int VirtualPagesY(const VirtualTextureInfo& info, int mip);
+// fills in mipCount and firstPage, returns the total page count
+uint32_t LayoutVirtualTextures(std::vector<VirtualTextureInfo>& textures);
+// which texture, level and page position a page index belongs to
+bool LocateVirtualPage(const std::vector<VirtualTextureInfo>& textures, uint32_t page,
+    int& texture, int& mip, int& pageX, int& pageY);
+
+// Box filtered mip level of a region of an image, column-major, and the page
+// or the tail cut from it. Used by the baker and the image source.
+void DownsampleRegion(const Image& image, int x, int y, int width, int height, int mip, std::vector<uint32_t>& out);
+void CutPage(const std::vector<uint32_t>& level, int levelWidth, int levelHeight, int pageX, int pageY, uint32_t* out);
+void MakeTail(const std::vector<uint32_t>& level, int levelWidth, int levelHeight, uint32_t* out);
+
+// Where pages come from. Texels are RGBA8888, pages and tails column-major.
+class PageSource
+{
+public:
+    virtual ~PageSource() = default;
+
+    virtual const std::vector<VirtualTextureInfo>& Textures() const = 0;
+    // runs on the loader thread
+    virtual bool ReadPage(uint32_t page, uint32_t* out) = 0;
+    virtual bool ReadTail(int texture, uint32_t* out) = 0;
+};
+
+// Baked file, see vtex_baker:
+//   VtFileHeader, VtFileTexture[textureCount], tails, pages
+const char VT_FILE_MAGIC[4] = {'R', 'C', 'V', 'T'};
+const uint32_t VT_FILE_VERSION = 1;
+
+struct VtFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t pageSize;
+    uint32_t tailSize;
+    uint32_t textureCount;
+    uint32_t pageCount;
+    uint64_t textureOffset;
+    uint64_t tailOffset;
+    uint64_t pageOffset;
+};
+
+struct VtFileTexture
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t firstPage;
+};
+
+class VirtualTextureFile : public PageSource
+{
+public:
+    bool Open(const std::string& path);
+
+    const std::vector<VirtualTextureInfo>& Textures() const override { return textures; }
+    bool ReadPage(uint32_t page, uint32_t* out) override;
+    bool ReadTail(int texture, uint32_t* out) override;
+
+private:
+    VtFileHeader header = {};
+    std::vector<VirtualTextureInfo> textures;
+    std::ifstream file;
+    std::mutex mutex;
+};
+
+// Square tiles of an atlas image in memory, texture n is the n-th tile row by
+// row. The image can be swapped while running, see VirtualTextures::Invalidate.
+class ImageTileSource : public PageSource
+{
+public:
+    ImageTileSource(const Image& image, int tileSize);
+
+    void SetImage(const Image& image);
+    // textures covered by a rect of atlas pixels
+    std::vector<int> TexturesIn(int x, int y, int width, int height) const;
+
+    const std::vector<VirtualTextureInfo>& Textures() const override { return textures; }
+    bool ReadPage(uint32_t page, uint32_t* out) override;
+    bool ReadTail(int texture, uint32_t* out) override;
+
+private:
+    int tileSize;
+    int columns;
+    std::vector<VirtualTextureInfo> textures;
+    std::shared_ptr<const Image> image;
+    std::mutex mutex;
+};
+
+struct VirtualTextureStats
+{
+    int residentPages;
+    int cachePages;
+    int requested;  // pages handed to the loader this frame
+    int installed;  // pages which became resident this frame
+    int evicted;
+    uint64_t fallbackSamples; // samples served by a coarser mip or the tail
+};
+
+class VirtualTextures
+{
+public:
+    explicit VirtualTextures(int cachePages = VT_CACHE_PAGES);
+    ~VirtualTextures();
+
+    VirtualTextures(const VirtualTextures&) = delete;
+    VirtualTextures& operator=(const VirtualTextures&) = delete;
+
+    // keeps a palette index copy of every page and tail next to the colours,
+    // for the 8-bit renderer, set before Start
+    void SetPalette(const PaletteLookup* lookup) { palette = lookup; }
+
+    // reads every tail and starts the loader thread
+    bool Start(std::unique_ptr<PageSource> source);
+    void Stop();
+
+    int TextureCount() const { return static_cast<int>(textures.size()); }
+    bool Valid(int texture) const { return texture >= 0 && texture < TextureCount(); }
+
+    // mip for a texture drawn pixelsAcross pixels wide (or high)
+    int MipFor(int texture, float pixelsAcross) const;
+
+    // u and v in [0, 1). Marks the page used this frame, asks for it when it
+    // is missing and falls back to coarser data meanwhile. Any number of
+    // threads can sample at once, but not while Update or Invalidate runs.
+    uint32_t Sample(int texture, float u, float v, int mip);
+    // same as Sample, the palette index of the texel
+    uint8_t SampleIndex(int texture, float u, float v, int mip);
+
+    // drops every resident page of the texture and rereads its tail, pages
+    // still being loaded from before are thrown away when they arrive
+    void Invalidate(int texture);
+
+    // once per frame: passes new requests to the loader and installs what it
+    // finished, evicting the least recently used pages
+    void Update();
+
+    VirtualTextureStats Stats() const;
+
+private:
+    struct LoadedPage
+    {
+        uint32_t page;
+        uint32_t generation;
+        std::vector<uint32_t> texels;
+        std::vector<uint8_t> indices; // with a palette only
+    };
+
+    struct PendingPage
+    {
+        uint32_t page;
+        uint32_t generation;
+    };
+
+    void LoaderLoop();
+    // offset of the texel in the cache, or in the tails when it returns false
+    bool Locate(int texture, float u, float v, int mip, size_t& offset);
+    void ReadTail(int texture);
+    int FindVictim();
+    void Install(const LoadedPage& loaded);
+
+    std::unique_ptr<PageSource> source;
+    std::vector<VirtualTextureInfo> textures;
+    std::vector<uint32_t> generations; // per texture, bumped by Invalidate
+    std::vector<uint32_t> tails;
+    const PaletteLookup* palette = nullptr;
+    std::vector<uint8_t> indexTails;
+
+    // page table: page -> cache slot, and whether the page is on its way
+    std::vector<uint16_t> pageSlots;
+    std::vector<std::atomic<uint8_t>> pageRequested;
+
+    int cachePages;
+    std::vector<uint32_t> cache;
+    std::vector<uint8_t> indexCache;
+    std::vector<uint32_t> slotPages; // slot -> page, 0xFFFFFFFF when free
+    std::vector<std::atomic<uint32_t>> slotUsed;  // frame the slot was last sampled
+    int residentPages = 0;
+    uint32_t frame = 1;
+    std::atomic<uint64_t> fallbackSamples{0};
+
+    std::vector<uint32_t> requests; // asked for this frame
+    std::mutex requestMutex;        // samplers adding to requests
+
+    // shared with the loader thread
+    std::deque<PendingPage> pending;
+    std::vector<LoadedPage> loaded;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread loader;
+    bool stopping = false;
+
+    VirtualTextureStats stats = {};
+};
+
+// Every page of a source read once and kept. Nothing changes after Load, so
+// any number of threads can sample it at once, for worlds drawn side by side
+// from one set of art. Samples the same texels VirtualTextures does once
+// everything is resident.
+class ResidentTextures
+{
+public:
+    bool Load(PageSource& source, const PaletteLookup* palette = nullptr);
+
+    int TextureCount() const { return static_cast<int>(textures.size()); }
+    bool Valid(int texture) const { return texture >= 0 && texture < TextureCount(); }
+
+    int MipFor(int texture, float pixelsAcross) const;
+    uint32_t Sample(int texture, float u, float v, int mip) const;
+    uint8_t SampleIndex(int texture, float u, float v, int mip) const;
+
+    size_t MemoryBytes() const { return pages.size() * sizeof(uint32_t) + indices.size(); }
+
+private:
+    size_t Locate(int texture, float u, float v, int mip) const;
+
+    std::vector<VirtualTextureInfo> textures;
+    std::vector<uint32_t> pages; // by page index, VT_PAGE_TEXELS each
+    std::vector<uint8_t> indices; // with a palette only
+};
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "SDL2/include/SDL.h"
+#include "SDL2_image/include/SDL_image.h"
+
+#include "asset_loader.h"
+#include "virtual_texture.h"
+
+namespace
+{
+
+struct BakeTexture
+{
+    int image;
+    int x;
+    int y;
+};
+
+} // namespace
+
+// Build step, cuts source images into the paged file VirtualTextureFile reads.
+// An image given as image.png@size is split into size x size tiles, row by
+// row, each becoming a texture of its own.
+//   vtex_baker <out.vt> <image.png[@tile]>...
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: vtex_baker <out.vt> <image.png[@tile]>..." << std::endl;
+        return 1;
+    }
+
+    SDL_Init(0);
+    IMG_Init(IMG_INIT_PNG);
+
+    std::vector<Image> images;
+    std::vector<BakeTexture> sources;
+    std::vector<VirtualTextureInfo> textures;
+    int result = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        std::string path = arg;
+        int tile = 0;
+        size_t at = arg.rfind('@');
+        if (at != std::string::npos)
+        {
+            path = arg.substr(0, at);
+            tile = std::stoi(arg.substr(at + 1));
+        }
+
+        Image image;
+        if (!DecodeImage(path, image))
+        {
+            std::cerr << "failed to decode " << path << ": " << SDL_GetError() << std::endl;
+            result = 1;
+            continue;
+        }
+
+        int tileWidth = tile > 0 ? tile : image.width;
+        int tileHeight = tile > 0 ? tile : image.height;
+        for (int y = 0; y + tileHeight <= image.height; y += tileHeight)
+        {
+            for (int x = 0; x + tileWidth <= image.width; x += tileWidth)
+            {
+                sources.push_back(BakeTexture{static_cast<int>(images.size()), x, y});
+                textures.push_back(VirtualTextureInfo{tileWidth, tileHeight, 0, 0});
+            }
+        }
+        images.push_back(std::move(image));
+    }
+
+    uint32_t pageCount = LayoutVirtualTextures(textures);
+
+    VtFileHeader header = {};
+    std::copy(VT_FILE_MAGIC, VT_FILE_MAGIC + 4, header.magic);
+    header.version = VT_FILE_VERSION;
+    header.pageSize = VT_PAGE_SIZE;
+    header.tailSize = VT_TAIL_SIZE;
+    header.textureCount = static_cast<uint32_t>(textures.size());
+    header.pageCount = pageCount;
+    header.textureOffset = sizeof(VtFileHeader);
+    header.tailOffset = header.textureOffset + textures.size() * sizeof(VtFileTexture);
+    header.pageOffset = header.tailOffset + uint64_t(textures.size()) * VT_TAIL_TEXELS * 4;
+
+    std::ofstream file;
+    if (result == 0)
+    {
+        file.open(argv[1], std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const VirtualTextureInfo& info : textures)
+        {
+            VtFileTexture entry = {uint32_t(info.width), uint32_t(info.height), uint32_t(info.mipCount), info.firstPage};
+            file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        }
+
+        std::vector<uint32_t> level;
+        std::vector<uint32_t> texels(VT_TAIL_TEXELS);
+        for (size_t t = 0; t < textures.size(); t++)
+        {
+            const VirtualTextureInfo& info = textures[t];
+            int mip = info.mipCount - 1;
+            DownsampleRegion(images[sources[t].image], sources[t].x, sources[t].y, info.width, info.height, mip, level);
+            MakeTail(level, std::max(1, info.width >> mip), std::max(1, info.height >> mip), texels.data());
+            file.write(reinterpret_cast<const char*>(texels.data()), VT_TAIL_TEXELS * 4);
+        }
+
+        texels.resize(VT_PAGE_TEXELS);
+        for (size_t t = 0; t < textures.size(); t++)
+        {
+            const VirtualTextureInfo& info = textures[t];
+            for (int mip = 0; mip < info.mipCount; mip++)
+            {
+                DownsampleRegion(images[sources[t].image], sources[t].x, sources[t].y, info.width, info.height, mip, level);
+                for (int py = 0; py < VirtualPagesY(info, mip); py++)
+                {
+                    for (int px = 0; px < VirtualPagesX(info, mip); px++)
+                    {
+                        CutPage(level, std::max(1, info.width >> mip), std::max(1, info.height >> mip), px, py, texels.data());
+                        file.write(reinterpret_cast<const char*>(texels.data()), VT_PAGE_TEXELS * 4);
+                    }
+                }
+            }
+        }
+    }
+
+    if (result == 0 && !file)
+    {
+        std::cerr << "failed to write " << argv[1] << std::endl;
+        result = 1;
+    }
+    else if (result == 0)
+    {
+        std::cout << textures.size() << " textures, " << pageCount << " pages" << std::endl;
+    }
+
+    IMG_Quit();
+    SDL_Quit();
+    return result;
+}
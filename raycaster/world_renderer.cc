@@ -0,0 +1,701 @@
+#include "world_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "floor_ray.h"
+#include "metrics.h"
+
+Colormap colormap;
+uint8_t fogIndex = 0;
+
+Shade ShadeFor(float distance, int light)
+{
+    if (!fogEnabled)
+        return Shade{light * 256 / 255, 0, 0, 0};
+    if (distance > fogMaxDistance)
+        return Shade{0, fogRed, fogGreen, fogBlue};
+
+    float realColorPart = 1. - distance * fogColorStep;
+    float fogColorPart = (1. - realColorPart);
+    return Shade{
+        int(realColorPart * light * 256 / 255),
+        int(fogRed * fogColorPart),
+        int(fogGreen * fogColorPart),
+        int(fogBlue * fogColorPart),
+    };
+}
+
+Shade ShadeForLevel(int level)
+{
+    float distance = float(level / LIGHT_SHADES) * fogMaxDistance / (FOG_SHADES - 1);
+    return ShadeFor(distance, level % LIGHT_SHADES * MAX_LIGHT / (LIGHT_SHADES - 1));
+}
+
+namespace
+{
+
+// one column of a transposed image, see TransposeImage
+inline const uint32_t* ImageColumn(const Image& columns, int x)
+{
+    return reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(columns.pixels) + size_t(x) * columns.pitch);
+}
+
+// a see-through wall waiting to be drawn over what is behind it
+struct SeeThroughHit
+{
+    GridHit hit;
+    float distance;
+    int clipBottom; // of the walls in front of it
+    int light;
+};
+
+struct ColumnOcclusion
+{
+    int count;
+    float distance[MAX_COLUMN_HITS];
+    int clipBottom[MAX_COLUMN_HITS]; // first covered row once the hit is drawn
+
+    // front to back, the ones from pending on are drawn already
+    int seeThroughCount;
+    int pending;
+    SeeThroughHit seeThrough[MAX_SEE_THROUGH_HITS];
+};
+
+float ColumnAngle(const Player& camera, int column)
+{
+    return (camera.angle - camera.fov/2.) + camera.fov/float(PLANE_WIDTH) * column;
+}
+
+vector2f RayDirection(float angle)
+{
+    return {static_cast<float>(cos(angle)), static_cast<float>(sin(angle))};
+}
+
+// whether a hit is kept to be drawn over what is behind it, taken is how many
+// of the column are kept already
+bool SeeThrough(const Level& level, const GridHit& hit, int taken)
+{
+    return taken < MAX_SEE_THROUGH_HITS && level.Kind(hit.tile) != TileKind::Opaque;
+}
+
+// rows of a wall slice, top and bottom can be off screen
+struct WallSlice
+{
+    int size;
+    int top;
+    int bottom;
+};
+
+WallSlice SliceFor(float distance, float h)
+{
+    const int mid = PLANE_HEIGHT / 2;
+    // use plane width to calculate slice size
+    // it corrects wall to be a square, not rectangle
+    WallSlice slice;
+    slice.size = int(PLANE_WIDTH / distance);
+    slice.bottom = mid - slice.size/2 + slice.size;
+    slice.top = slice.bottom - int(slice.size * h);
+    return slice;
+}
+
+float WallU(const GridHit& hit)
+{
+    return hit.side == X ? hit.hitY - std::floor(hit.hitY) : hit.hitX - std::floor(hit.hitX);
+}
+
+// reads ColumnHits the way DrawColumn reads a GridTraversal
+struct HitList
+{
+    const ColumnHits& column;
+    int next = 0;
+
+    bool Next(GridHit& hit)
+    {
+        if (next == column.count)
+            return false;
+        hit = column.hits[next++];
+        return true;
+    }
+};
+
+// returns the cells stepped through
+int CastColumn(const WorldView& view, int column, ColumnHits& out)
+{
+    GridTraversal traversal(view.level.Walls(), view.camera.pos, RayDirection(ColumnAngle(view.camera, column)), MAX_RAY_DISTANCE, &out.path);
+    GridHit hit;
+    out.count = 0;
+    int seeThrough = 0;
+    int walls = 0;
+    while (traversal.Next(hit))
+    {
+        out.hits[out.count++] = hit;
+        if (SeeThrough(view.level, hit, seeThrough))
+        {
+            seeThrough++;
+            continue;
+        }
+        walls++;
+        if (walls == MAX_COLUMN_HITS || view.level.WallHeight(hit.x, hit.y) >= 1)
+            break;
+    }
+    return traversal.Steps();
+}
+
+// the hits of a column between two casts with the same path, false when the
+// ray steps differently and has to be cast after all
+bool ReplayColumn(const WorldView& view, int column, const ColumnHits& source, ColumnHits& out)
+{
+    vector2f rayDir = RayDirection(ColumnAngle(view.camera, column));
+    if (!StepsLike(source.path, rayDir))
+        return false;
+
+    out.path = source.path;
+    out.count = source.count;
+    for (int i = 0; i < source.count; i++)
+    {
+        out.hits[i] = ReplayHit(source.hits[i], view.camera.pos, rayDir);
+    }
+    return true;
+}
+
+// Fills the columns between the casts a and b, replayed when both took the
+// same path, otherwise the middle one is cast and each half looked at again.
+void RefineColumns(const WorldView& view, ColumnHits* columns, int a, int b, int& rays, int& steps)
+{
+    if (b - a < 2)
+        return;
+
+    if (SamePath(columns[a].path, columns[b].path))
+    {
+        for (int i = a + 1; i < b; i++)
+        {
+            if (!ReplayColumn(view, i, columns[a], columns[i]))
+            {
+                steps += CastColumn(view, i, columns[i]);
+                rays++;
+            }
+        }
+        return;
+    }
+
+    int m = (a + b) / 2;
+    steps += CastColumn(view, m, columns[m]);
+    rays++;
+    RefineColumns(view, columns, a, m, rays, steps);
+    RefineColumns(view, columns, m, b, rays, steps);
+}
+
+// Hits of the columns [begin, end), with rays only where the walls change.
+// begin is a multiple of stride. Casting every stride columns comes first,
+// for all columns, since refining the last ones of a range reads the cast
+// column starting the next range.
+void CastStrideColumns(const WorldView& view, ColumnHits* columns, int begin, int end, int stride, int& rays, int& steps)
+{
+    for (int i = begin; i < end; i += stride)
+    {
+        steps += CastColumn(view, i, columns[i]);
+        rays++;
+    }
+    int last = PLANE_WIDTH - 1;
+    if (last >= begin && last < end && last % stride != 0)
+    {
+        steps += CastColumn(view, last, columns[last]);
+        rays++;
+    }
+}
+
+void RefineColumnRange(const WorldView& view, ColumnHits* columns, int begin, int end, int stride, int& rays, int& steps)
+{
+    int last = PLANE_WIDTH - 1;
+    for (int a = begin; a < std::min(end, last); a += stride)
+    {
+        RefineColumns(view, columns, a, std::min(a + stride, last), rays, steps);
+    }
+}
+
+// fn(begin, end) over chunks of the columns, on the jobs when there are any
+void ForColumns(JobSystem* jobs, const std::function<void(int, int)>& fn)
+{
+    if (jobs)
+        jobs->ParallelFor(PLANE_WIDTH, RENDER_CHUNK_COLUMNS, fn);
+    else
+        fn(0, PLANE_WIDTH);
+}
+
+// floor rows [y0, y1) of a column, rows are mirrored for the ceiling when asked,
+// returns the pixels written. Rows are stepped in Scalar, the texture
+// coordinates within a cell are exact in float, so the texels are the ones
+// TexelCoord gives in Scalar.
+template <typename Target, typename Scalar, typename Textures>
+int DrawFloorRows(BasicColumnFramebuffer<typename Target::Pixel>& frame, Textures& textures, const WorldView& view,
+    int column, float angle, int y0, int y1, bool ceiling)
+{
+    typename Target::Pixel* out = frame.Column(column);
+    float cosCorrection = cos(angle - view.camera.angle);
+    FloorRay<Scalar> ray(view.camera.pos, angle, cosCorrection, float(DISTANCE_TO_PLANE));
+    int written = 0;
+    for (int py = y0; py < y1; py++)
+    {
+        FloorPoint<Scalar> point = ray.Row(py - (PLANE_HEIGHT / 2)+1);
+
+        int cellX = ToInt(point.x);
+        int cellY = ToInt(point.y);
+
+        int texture = ceiling ? view.level.Ceil(cellX, cellY) : view.level.Floor(cellX, cellY);
+        // textures past the set and cells off the map keep the clear colour
+        if (!textures.Valid(texture) || point.x < Scalar(0) || point.y < Scalar(0))
+            continue;
+
+        float rowDist = ToFloat(point.distance);
+        int mip = textures.MipFor(texture, PLANE_WIDTH / rowDist);
+        auto texel = Target::Texel(textures, texture, ToFloat(Frac(point.x)), ToFloat(Frac(point.y)), mip);
+        typename Target::Shading shade = Target::For(rowDist, view.lightMap.Sample(ToFloat(point.x), ToFloat(point.y)));
+        out[ceiling ? PLANE_HEIGHT - py : py] = Target::Apply(texel, shade);
+        written++;
+    }
+    return written;
+}
+
+// top of a wall lower than the eye, rows [y0, y1) of the plane at height h
+template <typename Target, typename Scalar, typename Textures>
+void DrawTopFaceRows(BasicColumnFramebuffer<typename Target::Pixel>& frame, Textures& textures, const WorldView& view,
+    int column, float angle, int y0, int y1, float h, int tile)
+{
+    int texture = tile - 1;
+    if (!textures.Valid(texture))
+        return;
+
+    typename Target::Pixel* out = frame.Column(column);
+    float cosCorrection = cos(angle - view.camera.angle);
+    FloorRay<Scalar> ray(view.camera.pos, angle, cosCorrection, float(DISTANCE_TO_PLANE) * (1 - 2 * h));
+    for (int py = y0; py < y1; py++)
+    {
+        FloorPoint<Scalar> point = ray.Row(py - (PLANE_HEIGHT / 2)+1);
+
+        float rowDist = ToFloat(point.distance);
+        int mip = textures.MipFor(texture, PLANE_WIDTH / rowDist);
+        auto texel = Target::Texel(textures, texture, ToFloat(Frac(point.x)), ToFloat(Frac(point.y)), mip);
+        out[py] = Target::Apply(texel, Target::For(rowDist, view.lightMap.Sample(ToFloat(point.x), ToFloat(point.y))));
+    }
+}
+
+// Draws one screen column front to back: walls, the top faces of walls lower
+// than the eye, the floor between them and the ceiling above the highest one.
+// clipBottom only ever moves up, so every pixel of the column is written once,
+// and the walk stops as soon as nothing behind the last hit can show. Masked
+// and translucent walls cover nothing, they are only kept in occlusion for
+// DrawSeeThrough. Hits come from a GridTraversal or a HitList, floors are
+// stepped in Scalar.
+// Returns the distance of the wall which hides everything behind it.
+template <typename Target, typename Scalar, typename Textures, typename Hits>
+float DrawColumn(BasicColumnFramebuffer<typename Target::Pixel>& frame, Textures& textures, const WorldView& view,
+    int column, float angle, Hits& traversal, ColumnOcclusion& occlusion)
+{
+    const int mid = PLANE_HEIGHT / 2;
+    float cosCorrection = cos(angle - view.camera.angle);
+    vector2f rayDir = RayDirection(angle);
+
+    int clipBottom = PLANE_HEIGHT;
+    int ceilEnd = mid;
+    float hiddenDistance = 1e30f;
+    occlusion.count = 0;
+    occlusion.seeThroughCount = 0;
+    int hits = 0;
+    int floorPixels = 0;
+
+    GridHit hit;
+    bool leftMap = false;
+    while (clipBottom > 0)
+    {
+        if (!traversal.Next(hit))
+        {
+            leftMap = true;
+            break;
+        }
+        hits++;
+
+        float distance = hit.distance * cosCorrection;
+        // sample the light just in front of the wall, the wall cell itself is never lit
+        vector2f lightAt = {hit.hitX - rayDir.x * .01f, hit.hitY - rayDir.y * .01f};
+        if (SeeThrough(view.level, hit, occlusion.seeThroughCount))
+        {
+            int light = view.lightMap.Sample(lightAt.x, lightAt.y);
+            occlusion.seeThrough[occlusion.seeThroughCount++] = SeeThroughHit{hit, distance, clipBottom, light};
+            continue;
+        }
+        if (view.level.Kind(hit.tile) != TileKind::Opaque)
+            CountMetric(Metric::SeeThroughCapped);
+
+        float h = view.level.WallHeight(hit.x, hit.y);
+        WallSlice slice = SliceFor(distance, h);
+        int sliceSize = slice.size;
+        int bottom = slice.bottom;
+        int top = slice.top;
+
+        // floor between the previous hit and this one
+        if (bottom < clipBottom)
+            floorPixels += DrawFloorRows<Target, Scalar>(frame, textures, view, column, angle, std::max(bottom, mid), clipBottom, false);
+
+        int y0 = std::max(top, 0);
+        int y1 = std::min(bottom, clipBottom);
+        if (y0 < y1)
+        {
+            float wallU = WallU(hit);
+            int texture = hit.tile - 1; // get proper texture according on what wall on map
+
+            // lower walls show the bottom part of the texture
+            float vPerRow = 1.f / sliceSize;
+            float v = (1 - h) + (y0 - top) * vPerRow;
+
+            int wallLight = view.lightMap.Sample(lightAt.x, lightAt.y);
+            if (textures.Valid(texture))
+            {
+                // pages are column-major so texture reads run down memory too
+                typename Target::Shading shade = Target::For(distance, wallLight);
+                int mip = textures.MipFor(texture, float(sliceSize));
+                typename Target::Pixel* out = frame.Column(column);
+                for (int y = y0; y < y1; y++, v += vPerRow)
+                {
+                    out[y] = Target::Apply(Target::Texel(textures, texture, wallU, v, mip), shade);
+                }
+            }
+
+            ceilEnd = std::min(ceilEnd, y0);
+        }
+
+        int covered = std::min(top, clipBottom);
+        if (h >= 1)
+        {
+            clipBottom = std::max(covered, 0);
+            hiddenDistance = distance;
+        }
+        else
+        {
+            if (h < .5f)
+            {
+                // the top face reaches from the wall top back to where the ray leaves the cell
+                int faceTop = mid + int(DISTANCE_TO_PLANE * (1 - 2 * h) / (hit.exitDistance * cosCorrection));
+                faceTop = std::max(faceTop, 0);
+                if (faceTop < covered)
+                    DrawTopFaceRows<Target, Scalar>(frame, textures, view, column, angle, faceTop, covered, h, hit.tile);
+                covered = std::min(covered, faceTop);
+            }
+            clipBottom = std::max(covered, 0);
+        }
+
+        if (occlusion.count < MAX_COLUMN_HITS)
+        {
+            occlusion.distance[occlusion.count] = distance;
+            occlusion.clipBottom[occlusion.count] = clipBottom;
+            occlusion.count++;
+        }
+
+        if (h >= 1 || occlusion.count == MAX_COLUMN_HITS)
+            break;
+
+        // nothing further away than the exit point reaches above a full wall there
+        float exitDistance = hit.exitDistance * cosCorrection;
+        if (clipBottom <= mid - int(DISTANCE_TO_PLANE / exitDistance))
+        {
+            hiddenDistance = exitDistance;
+            break;
+        }
+    }
+
+    // ray left the map, the floor runs up to the horizon
+    if (leftMap && clipBottom > mid)
+        floorPixels += DrawFloorRows<Target, Scalar>(frame, textures, view, column, angle, mid, clipBottom, false);
+
+    // ceiling is mirrored floor
+    int ceilRows = std::min(ceilEnd, clipBottom);
+    if (ceilRows > 0)
+        floorPixels += DrawFloorRows<Target, Scalar>(frame, textures, view, column, angle, PLANE_HEIGHT - ceilRows + 1, PLANE_HEIGHT + 1, true);
+
+    occlusion.pending = occlusion.seeThroughCount;
+    CountMetric(Metric::CellsHit, hits);
+    CountMetric(Metric::SeeThroughHits, occlusion.seeThroughCount);
+    CountMetric(Metric::FloorPixels, floorPixels);
+    return hiddenDistance;
+}
+
+// Draws the see-through walls of a column still waiting which are further
+// away than distance, back to front over what the column shows so far. The
+// sprite pass calls it before drawing into a column, then once for the rest,
+// so sprites and see-through walls end up in depth order.
+// Returns the pixels written.
+template <typename Target, typename Textures>
+int DrawSeeThrough(BasicColumnFramebuffer<typename Target::Pixel>& frame, Textures& textures, const WorldView& view,
+    int column, ColumnOcclusion& occlusion, float distance)
+{
+    int written = 0;
+    while (occlusion.pending > 0 && occlusion.seeThrough[occlusion.pending - 1].distance > distance)
+    {
+        const SeeThroughHit& layer = occlusion.seeThrough[--occlusion.pending];
+        const GridHit& hit = layer.hit;
+        int texture = hit.tile - 1;
+        if (!textures.Valid(texture))
+            continue;
+
+        // only the face the ray enters, lower ones without their top
+        float h = view.level.WallHeight(hit.x, hit.y);
+        WallSlice slice = SliceFor(layer.distance, h);
+        int y0 = std::max(slice.top, 0);
+        int y1 = std::min(slice.bottom, layer.clipBottom);
+        if (y0 >= y1)
+            continue;
+
+        float wallU = WallU(hit);
+        float vPerRow = 1.f / slice.size;
+        float v = (1 - h) + (y0 - slice.top) * vPerRow;
+        TileKind kind = view.level.Kind(hit.tile);
+        typename Target::Shading shade = Target::For(layer.distance, layer.light);
+        int mip = textures.MipFor(texture, float(slice.size));
+        typename Target::Pixel* out = frame.Column(column);
+        for (int y = y0; y < y1; y++, v += vPerRow)
+        {
+            Target::Composite(out[y], textures, texture, wallU, v, mip, shade, kind, column, y);
+        }
+        written += y1 - y0;
+    }
+    return written;
+}
+
+} // namespace
+
+size_t RenderScratch::MemoryBytes() const
+{
+    return entities.capacity() * sizeof(entities[0]) + spans.capacity() * sizeof(SpriteSpan) +
+        columns.capacity() * sizeof(ColumnHits) + depth.MemoryBytes();
+}
+
+template <typename Target, typename Textures>
+void DrawWorld(BasicColumnFramebuffer<typename Target::Pixel>& frame, Textures& textures, const SpriteSheet& sheet,
+    const WorldView& view, RenderScratch& scratch, JobSystem* jobs)
+{
+    using Pixel = typename Target::Pixel;
+    const std::vector<Sprite>& sprites = view.sprites;
+    std::vector<std::pair<int, float>>& entities = scratch.entities;
+    std::vector<ColumnHits>& columns = scratch.columns;
+    std::vector<SpriteSpan>& spans = scratch.spans;
+
+    // distance to the wall hiding everything behind it, and where every
+    // lower wall in front of it starts covering the column
+    float zBuffer[PLANE_WIDTH];
+    ColumnOcclusion occlusion[PLANE_WIDTH];
+
+    // every chunk of columns counts its own, metrics are per thread
+    if (view.adaptiveColumns)
+    {
+        columns.resize(PLANE_WIDTH);
+        ForColumns(jobs, [&](int begin, int end) {
+            int rays = 0;
+            int steps = 0;
+            CastStrideColumns(view, columns.data(), begin, end, ADAPTIVE_STRIDE, rays, steps);
+            CountMetric(Metric::RaysCast, rays);
+            CountMetric(Metric::DdaSteps, steps);
+        });
+        ForColumns(jobs, [&](int begin, int end) {
+            int rays = 0;
+            int steps = 0;
+            RefineColumnRange(view, columns.data(), begin, end, ADAPTIVE_STRIDE, rays, steps);
+            for (int i = begin; i < end; i++)
+            {
+                HitList hits{columns[i]};
+                float angle = ColumnAngle(view.camera, i);
+                zBuffer[i] = view.fixedPoint
+                    ? DrawColumn<Target, Fixed>(frame, textures, view, i, angle, hits, occlusion[i])
+                    : DrawColumn<Target, float>(frame, textures, view, i, angle, hits, occlusion[i]);
+            }
+            CountMetric(Metric::RaysCast, rays);
+            CountMetric(Metric::DdaSteps, steps);
+        });
+    }
+    else
+    {
+        ForColumns(jobs, [&](int begin, int end) {
+            int steps = 0;
+            for (int i = begin; i < end; i++)
+            {
+                float angle = ColumnAngle(view.camera, i);
+                GridTraversal traversal(view.level.Walls(), view.camera.pos, RayDirection(angle), MAX_RAY_DISTANCE);
+                zBuffer[i] = view.fixedPoint
+                    ? DrawColumn<Target, Fixed>(frame, textures, view, i, angle, traversal, occlusion[i])
+                    : DrawColumn<Target, float>(frame, textures, view, i, angle, traversal, occlusion[i]);
+                steps += traversal.Steps();
+            }
+            CountMetric(Metric::RaysCast, end - begin);
+            CountMetric(Metric::DdaSteps, steps);
+        });
+    }
+    CountMetric(Metric::ColumnsDrawn, PLANE_WIDTH);
+
+    // sprites are tested against the whole span of columns they cover first
+    float nearest[PLANE_WIDTH];
+    for (int i = 0; i < PLANE_WIDTH; i++)
+    {
+        nearest[i] = occlusion[i].count > 0 ? occlusion[i].distance[0] : zBuffer[i];
+    }
+    scratch.depth.Build(nearest, zBuffer, PLANE_WIDTH);
+
+    int spriteCount = static_cast<int>(sprites.size());
+    entities.resize(spriteCount);
+    for (int i = 0; i < spriteCount; i++)
+    {
+        entities[i].first = i;
+
+        float xDist = view.camera.pos.x - sprites[i].x;
+        float yDist = view.camera.pos.y - sprites[i].y;
+
+        entities[i].second = sqrt((xDist*xDist) + (yDist*yDist));
+
+    }
+
+    std::sort(entities.begin(), entities.end(), [](auto &left, auto &right){
+        return left.second > right.second;
+    });
+
+    // where every sprite lands on screen, back to front, the columns are
+    // drawn from these afterwards
+    spans.clear();
+    int visibleSprites = 0;
+    int occludedSprites = 0;
+    for (int i = 0; i < spriteCount; i++)
+    {
+        const Sprite& sprite = sprites[entities[i].first];
+        float spriteDir = atan2(sprite.y - view.camera.pos.y, sprite.x - view.camera.pos.x);
+
+        
+        while ((spriteDir - view.camera.angle) > PI) spriteDir -= 2*PI;
+        while ((spriteDir - view.camera.angle) < -PI) spriteDir += 2*PI;
+
+        
+        entities[i].second *= cos(spriteDir - view.camera.angle);
+        {
+            int spriteHeight = PLANE_WIDTH / entities[i].second;
+
+            int spriteScreenY = (PLANE_HEIGHT/2 - spriteHeight/2);
+            float spriteScreenX = (spriteDir - view.camera.angle) * (float(PLANE_WIDTH) / view.camera.fov) + float(PLANE_WIDTH/2);
+
+            int drawStartX = spriteScreenX - spriteHeight/2;
+            int drawEndX = drawStartX + spriteHeight;
+
+            int texWidth = spriteHeight;
+            float texStepX = sheet.frameWidth / static_cast<float>(texWidth);
+
+            int texStartX = 0;
+            int texEndX = TILE_SIZE;
+
+            int screenStartX = drawStartX;
+            if ((drawStartX >= 0 && drawStartX <= PLANE_WIDTH) || (drawEndX >= 0 && drawEndX <= PLANE_WIDTH))
+            {
+                float shadeDistance = entities[i].second;
+
+                if (drawStartX < 0)
+                {
+                    texStartX = (0 - screenStartX) * texStepX;
+                    screenStartX = 0;
+                }
+                int screenEndX = drawEndX;
+                if (drawEndX > PLANE_WIDTH)
+                {
+                    texEndX = (drawEndX - PLANE_WIDTH) * texStepX; 
+                    screenEndX = PLANE_WIDTH;
+                }
+
+                bool onScreen = screenStartX < PLANE_WIDTH && screenEndX <= PLANE_WIDTH;
+                if (onScreen)
+                    entities[i].second *= cos(spriteDir - view.camera.angle);
+
+                // hidden behind walls all along, or in front of every hit so
+                // no column needs testing
+                DepthTest depth = scratch.depth.Test(screenStartX, screenEndX, entities[i].second);
+                if (depth == DepthTest::Hidden)
+                {
+                    occludedSprites++;
+                    continue;
+                }
+                visibleSprites++;
+                if (!onScreen)
+                    continue;
+
+                SpriteSpan span;
+                span.startX = screenStartX;
+                span.endX = screenEndX;
+                span.screenY = spriteScreenY;
+                span.height = spriteHeight;
+                span.distance = entities[i].second;
+                span.shadeDistance = shadeDistance;
+                span.light = view.lightMap.Sample(sprite.x, sprite.y);
+                span.texX = texStartX + sprite.frame * sheet.frameWidth;
+                span.texStepX = texStepX;
+                span.depth = depth;
+                spans.push_back(span);
+            }
+        }
+    }
+    CountMetric(Metric::SpritesVisible, visibleSprites);
+    CountMetric(Metric::SpritesOccluded, occludedSprites);
+    CountMetric(Metric::SpritesCulled, spriteCount - visibleSprites - occludedSprites);
+
+    // a chunk draws every sprite over its own columns, so each column still
+    // gets sprites and see-through walls in depth order
+    ForColumns(jobs, [&](int begin, int end) {
+        int seeThroughPixels = 0;
+        for (const SpriteSpan& span : spans)
+        {
+            if (span.endX <= begin || span.startX >= end)
+                continue;
+
+            typename Target::Shading shade = Target::For(span.shadeDistance, span.light);
+            // stepped from the first column so every chunk gets the same texels
+            float texX = span.texX;
+            int stop = std::min(span.endX, end);
+            for (int j = span.startX; j < stop; j++, texX += span.texStepX)
+            {
+                bool inFront = span.depth == DepthTest::Visible || zBuffer[j] > span.distance;
+                if (j < begin || !inFront)
+                    continue;
+
+                seeThroughPixels += DrawSeeThrough<Target>(frame, textures, view, j, occlusion[j], span.distance);
+
+                // lower walls in front cover the sprite from the bottom
+                int clip = PLANE_HEIGHT;
+                for (int k = 0; span.depth == DepthTest::Partial && k < occlusion[j].count && occlusion[j].distance[k] < span.distance; k++)
+                {
+                    clip = occlusion[j].clipBottom[k];
+                }
+                int y0 = std::max(span.screenY, 0);
+                int y1 = std::min({span.screenY + span.height, clip, PLANE_HEIGHT});
+                if (y0 < y1 && int(texX) < sheet.columns.height)
+                {
+                    const uint32_t* texColumn = ImageColumn(sheet.columns, int(texX));
+                    Pixel* out = frame.Column(j);
+                    for (int y = y0; y < y1; y++)
+                    {
+                        int row = (y - span.screenY) * sheet.columns.width / span.height;
+                        uint32_t texel = texColumn[row];
+                        // transparent texels are skipped, there is no blending
+                        if ((texel & 0xFF) >= 128)
+                            out[y] = Target::Apply(Target::SpriteTexel(sheet, int(texX), row, texel), shade);
+                    }
+                }
+            }
+        }
+        for (int i = begin; i < end; i++)
+        {
+            seeThroughPixels += DrawSeeThrough<Target>(frame, textures, view, i, occlusion[i], 0);
+        }
+        CountMetric(Metric::SeeThroughPixels, seeThroughPixels);
+    });
+}
+
+template void DrawWorld<TrueColor, VirtualTextures>(ColumnFramebuffer&, VirtualTextures&, const SpriteSheet&,
+    const WorldView&, RenderScratch&, JobSystem*);
+template void DrawWorld<Indexed, VirtualTextures>(IndexedFramebuffer&, VirtualTextures&, const SpriteSheet&,
+    const WorldView&, RenderScratch&, JobSystem*);
+template void DrawWorld<TrueColor, const ResidentTextures>(ColumnFramebuffer&, const ResidentTextures&, const SpriteSheet&,
+    const WorldView&, RenderScratch&, JobSystem*);
+template void DrawWorld<Indexed, const ResidentTextures>(IndexedFramebuffer&, const ResidentTextures&, const SpriteSheet&,
+    const WorldView&, RenderScratch&, JobSystem*);
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "asset_pack.h"
+#include "depth_hierarchy.h"
+#include "framebuffer.h"
+#include "grid_traversal.h"
+#include "job_system.h"
+#include "level.h"
+#include "light_map.h"
+#include "palette.h"
+#include "simulation.h"
+#include "types.h"
+#include "virtual_texture.h"
+
+// Software renderer.
+// Draws one world seen from one camera into a column-major framebuffer:
+// walls, floors and ceilings column by column, then the sprites back to
+// front with the masked and translucent walls of each column blended in
+// between them in depth order. Nothing in here is global per world, so
+// several worlds can be drawn at once from different threads as long as
+// each has its own frame and RenderScratch and the textures allow it
+// (ResidentTextures, not VirtualTextures).
+
+const int PLANE_WIDTH = 200;
+const int PLANE_HEIGHT = 112;
+
+const int TILE_SIZE = 64;
+
+const int DISTANCE_TO_PLANE = PLANE_WIDTH / 2;
+
+const int MAX_RAY_DISTANCE = 24;
+
+// adaptive casting: rays every ADAPTIVE_STRIDE columns, the columns between
+// two rays with the same path are replayed instead of cast
+const int ADAPTIVE_STRIDE = 8;
+
+// columns one job draws when DrawWorld is given jobs, a multiple of
+// ADAPTIVE_STRIDE so every range starts at a cast column
+const int RENDER_CHUNK_COLUMNS = ADAPTIVE_STRIDE * 4;
+
+// fog variables
+const bool fogEnabled = true;
+const int fogMaxDistance = 12;
+const float fogColorStep = 1. / fogMaxDistance;
+const int fogRed = 255;
+const int fogGreen = 255;
+const int fogBlue = 255;
+
+// fog and light of one span, every channel becomes texel * mul / 256 + fog
+struct Shade
+{
+    int mul;
+    int r, g, b;
+};
+
+// light is the light map value at the shaded point, it only darkens the
+// texture part of the colour, fog stays as bright as it is
+Shade ShadeFor(float distance, int light = MAX_LIGHT);
+
+// texel and result are RGBA8888
+inline uint32_t ShadePixel(uint32_t texel, const Shade& shade)
+{
+    uint32_t r = ((texel >> 24) * shade.mul >> 8) + shade.r;
+    uint32_t g = (((texel >> 16) & 0xFF) * shade.mul >> 8) + shade.g;
+    uint32_t b = (((texel >> 8) & 0xFF) * shade.mul >> 8) + shade.b;
+    return (r << 24) | (g << 16) | (b << 8) | 0xFF;
+}
+
+// over blended onto under by alpha, all RGBA8888
+inline uint32_t BlendPixel(uint32_t under, uint32_t over, uint32_t alpha)
+{
+    uint32_t r = ((over >> 24) * alpha + (under >> 24) * (255 - alpha)) / 255;
+    uint32_t g = (((over >> 16) & 0xFF) * alpha + ((under >> 16) & 0xFF) * (255 - alpha)) / 255;
+    uint32_t b = (((over >> 8) & 0xFF) * alpha + ((under >> 8) & 0xFF) * (255 - alpha)) / 255;
+    return (r << 24) | (g << 16) | (b << 8) | 0xFF;
+}
+
+// 4x4 ordered dither, an alpha above the threshold covers the pixel
+inline uint32_t DitherThreshold(int x, int y)
+{
+    static const uint8_t BAYER[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+    return BAYER[y & 3][x & 3] * 16 + 8;
+}
+
+inline uint32_t FogPixel()
+{
+    return (uint32_t(fogRed) << 24) | (uint32_t(fogGreen) << 16) | (uint32_t(fogBlue) << 8) | 0xFF;
+}
+
+// 8-bit mode, fog and light are quantized into FOG_SHADES * LIGHT_SHADES
+// colormap rows, the palette keeps a few entries for the way to the fog colour
+const int FOG_SHADES = 16;
+const int LIGHT_SHADES = 16;
+const int PALETTE_FOG_RAMP = 16;
+
+// built once at load, shared by everything drawing 8-bit frames
+extern Colormap colormap;
+extern uint8_t fogIndex;
+
+inline int ShadeLevel(float distance, int light)
+{
+    int fog = std::min(int(distance * (FOG_SHADES - 1) / fogMaxDistance + .5f), FOG_SHADES - 1);
+    return fog * LIGHT_SHADES + (light * (LIGHT_SHADES - 1) + 127) / MAX_LIGHT;
+}
+
+// the shade a colormap row stands for
+Shade ShadeForLevel(int level);
+
+// enemy frames transposed so a sprite column is a texture column, indices
+// has the same layout and is only filled for the 8-bit mode
+struct SpriteSheet
+{
+    Image columns;
+    std::vector<uint8_t> indices;
+    int frameWidth;
+};
+
+// What the draw functions write. TrueColor shades RGBA8888 texels channel by
+// channel, Indexed looks palette indices up in a colormap row.
+struct TrueColor
+{
+    using Pixel = uint32_t;
+    using Shading = Shade;
+
+    static Shade For(float distance, int light) { return ShadeFor(distance, light); }
+    template <typename Textures>
+    static uint32_t Texel(Textures& textures, int texture, float u, float v, int mip)
+    {
+        return textures.Sample(texture, u, v, mip);
+    }
+    static uint32_t SpriteTexel(const SpriteSheet&, int, int, uint32_t texel) { return texel; }
+    static uint32_t Apply(uint32_t texel, const Shade& shade) { return ShadePixel(texel, shade); }
+    // see-through walls over what is drawn already
+    template <typename Textures>
+    static void Composite(uint32_t& out, Textures& textures, int texture, float u, float v, int mip, const Shade& shade,
+        TileKind kind, int, int)
+    {
+        uint32_t texel = textures.Sample(texture, u, v, mip);
+        uint32_t alpha = texel & 0xFF;
+        if (kind == TileKind::Masked)
+        {
+            if (alpha >= 128)
+                out = ShadePixel(texel, shade);
+        }
+        else if (alpha > 0)
+        {
+            out = BlendPixel(out, ShadePixel(texel, shade), alpha);
+        }
+    }
+};
+
+struct Indexed
+{
+    using Pixel = uint8_t;
+    using Shading = const uint8_t*;
+
+    static const uint8_t* For(float distance, int light) { return colormap.Row(ShadeLevel(distance, light)); }
+    template <typename Textures>
+    static uint8_t Texel(Textures& textures, int texture, float u, float v, int mip)
+    {
+        return textures.SampleIndex(texture, u, v, mip);
+    }
+    static uint8_t SpriteTexel(const SpriteSheet& sheet, int column, int row, uint32_t)
+    {
+        return sheet.indices[size_t(column) * sheet.columns.width + row];
+    }
+    static uint8_t Apply(uint8_t texel, const uint8_t* shade) { return shade[texel]; }
+    // there is no blending with a palette, translucent walls are dithered by alpha
+    template <typename Textures>
+    static void Composite(uint8_t& out, Textures& textures, int texture, float u, float v, int mip, const uint8_t* shade,
+        TileKind kind, int x, int y)
+    {
+        uint32_t alpha = textures.Sample(texture, u, v, mip) & 0xFF;
+        uint32_t threshold = kind == TileKind::Masked ? 127 : DitherThreshold(x, y);
+        if (alpha > threshold)
+            out = shade[textures.SampleIndex(texture, u, v, mip)];
+    }
+};
+
+// walls a column draws, masked and translucent ones are counted apart
+const int MAX_COLUMN_HITS = 8;
+// See-through walls a column keeps to draw over what is behind them. Past
+// that a see-through wall is drawn solid and hides the rest, which bounds
+// what one column can cost.
+const int MAX_SEE_THROUGH_HITS = 4;
+
+// every hit DrawColumn can use, up to the first full height opaque wall
+struct ColumnHits
+{
+    RayPath path;
+    int count;
+    GridHit hits[MAX_COLUMN_HITS + MAX_SEE_THROUGH_HITS];
+};
+
+// one camera in one world, everything a frame is drawn from besides assets
+struct WorldView
+{
+    const Player& camera;
+    const Level& level;
+    const LightMap& lightMap;
+    const std::vector<Sprite>& sprites;
+    bool adaptiveColumns; // see CastColumns
+    bool fixedPoint; // floors and top faces stepped in 16.16 fixed point, see FloorRay
+};
+
+// a sprite placed on screen, columns [startX, endX)
+struct SpriteSpan
+{
+    int startX, endX;
+    int screenY;
+    int height;
+    float distance; // corrected, what the columns are tested against
+    float shadeDistance;
+    int light;
+    float texX; // sheet column at startX
+    float texStepX;
+    DepthTest depth;
+};
+
+// storage DrawWorld keeps between frames, one per thread drawing
+struct RenderScratch
+{
+    std::vector<std::pair<int, float>> entities;
+    std::vector<SpriteSpan> spans;
+    std::vector<ColumnHits> columns;
+    DepthHierarchy depth;
+
+    size_t MemoryBytes() const;
+};
+
+// instantiated for TrueColor and Indexed, with VirtualTextures and ResidentTextures.
+// With jobs the columns are cast and drawn in chunks across them, the frame
+// comes out the same either way.
+template <typename Target, typename Textures>
+void DrawWorld(BasicColumnFramebuffer<typename Target::Pixel>& frame, Textures& textures, const SpriteSheet& sheet,
+    const WorldView& view, RenderScratch& scratch, JobSystem* jobs = nullptr);
@@ -0,0 +1,64 @@
+#include "world_session.h"
+
+#include <algorithm>
+
+size_t SharedAssets::MemoryBytes() const
+{
+    size_t layers = level.walls.capacity() + level.floors.capacity() + level.ceils.capacity() + level.heights.capacity();
+    return layers * sizeof(int) + level.occupancy.MemoryBytes() + textures.MemoryBytes() +
+        sprites.columns.storage.capacity() * sizeof(uint32_t) + sprites.indices.capacity();
+}
+
+WorldSession::WorldSession(const SharedAssets& assets)
+    : assets(assets), player(SpawnPlayer()), enemies(ENTITY_CAPACITY), frame(PLANE_WIDTH, PLANE_HEIGHT)
+{
+    SpawnEnemies(enemies, assets.level.Walls());
+
+    lightMap.Reset(assets.level.Walls(), LIGHT_AMBIENT);
+    for (const Torch& torch : TORCHES)
+    {
+        lightMap.AddLight(PointLight{torch.x, torch.y, TORCH_INTENSITY, TORCH_RADIUS});
+    }
+    flash = lightMap.AddLight(PointLight{player.pos.x, player.pos.y, 0, FLASH_RADIUS});
+    lightMap.Update();
+
+    // sized for the worst case up front, a session does not allocate per frame
+    sprites.reserve(enemies.Capacity());
+    scratch.entities.reserve(enemies.Capacity());
+    scratch.columns.resize(PLANE_WIDTH);
+}
+
+void WorldSession::Step(const PlayerInput& input, int tickMs, JobSystem& jobs)
+{
+    ApplyPlayerInput(player, input, assets.level, tickMs);
+
+    flashTime = std::max(0, flashTime - tickMs);
+    if (input.buttons & INPUT_FIRE)
+        flashTime = FLASH_DURATION;
+
+    flow.SetTarget(player.pos);
+    flow.Update(assets.level.Walls());
+
+    SimulationContext simulation = {assets.level.Walls(), player.pos, tickMs, &flow};
+    UpdateEntities(enemies, simulation, jobs);
+}
+
+void WorldSession::Render(JobSystem& jobs)
+{
+    lightMap.MoveLight(flash, player.pos.x, player.pos.y);
+    lightMap.SetIntensity(flash, flashTime > 0 ? FLASH_INTENSITY * flashTime / FLASH_DURATION : 0);
+    lightMap.Update();
+
+    PackRenderSprites(enemies, sprites, jobs);
+
+    WorldView view{player, assets.level, lightMap, sprites, false, false};
+    frame.Clear(FogPixel());
+    DrawWorld<TrueColor>(frame, assets.textures, assets.sprites, view, scratch);
+}
+
+size_t WorldSession::MemoryBytes() const
+{
+    size_t frameBytes = size_t(frame.ColumnPitch()) * frame.Width() * sizeof(uint32_t);
+    return sizeof(*this) + enemies.MemoryBytes() + flow.MemoryBytes() + lightMap.MemoryBytes() + sprites.capacity() * sizeof(Sprite) +
+        frameBytes + scratch.MemoryBytes();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "entities.h"
+#include "flow_field.h"
+#include "framebuffer.h"
+#include "job_system.h"
+#include "level.h"
+#include "light_map.h"
+#include "simulation.h"
+#include "virtual_texture.h"
+#include "world_renderer.h"
+
+// Hosting.
+// One process runs many independent worlds. The level and the art are loaded
+// once into SharedAssets and only read after that, a WorldSession owns what a
+// single game changes: its player, enemies, lights, sprites and frame.
+
+// lighting variables
+const int LIGHT_AMBIENT = 110;
+
+struct Torch
+{
+    float x, y;
+};
+
+const Torch TORCHES[] = {
+    {1.5, 1.5},
+    {7.5, 5.5},
+    {10.5, 10.5},
+};
+const int TORCH_INTENSITY = 255;
+const float TORCH_RADIUS = 4;
+
+const int FLASH_INTENSITY = 255;
+const float FLASH_RADIUS = 6;
+const int FLASH_DURATION = 120; // ms
+
+// read-only once loaded, any number of sessions draw from it at once
+struct SharedAssets
+{
+    Level level;
+    ResidentTextures textures;
+    SpriteSheet sprites;
+
+    size_t MemoryBytes() const;
+};
+
+class WorldSession
+{
+public:
+    explicit WorldSession(const SharedAssets& assets);
+
+    WorldSession(const WorldSession&) = delete;
+    WorldSession& operator=(const WorldSession&) = delete;
+
+    // one fixed tick of this world, the same rules the client steps locally
+    void Step(const PlayerInput& input, int tickMs, JobSystem& jobs);
+    // lights, sprites and the frame for the current state
+    void Render(JobSystem& jobs);
+
+    const Player& CurrentPlayer() const { return player; }
+    const ColumnFramebuffer& Frame() const { return frame; }
+
+    // everything the session owns, the shared assets are not counted
+    size_t MemoryBytes() const;
+
+private:
+    const SharedAssets& assets;
+    Player player;
+    EntityStore enemies;
+    FlowField flow;
+    LightMap lightMap;
+    LightId flash;
+    int flashTime = 0;
+    std::vector<Sprite> sprites;
+    ColumnFramebuffer frame;
+    RenderScratch scratch;
+};